@@ -0,0 +1,37 @@
+﻿#include "allocation_counter.h"
+#include <stdlib.h>  // malloc()
+#include <atomic>
+#include <new>
+
+static std::atomic<INT64> g_numAllocations(0);
+
+#ifdef COUNT_ALLOCATIONS
+
+// The other forms of "operator new" and "operator delete" call these.
+void *operator new(size_t size) {
+  ++g_numAllocations;
+  void *p = malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+bool AllocationCounter::IsEnabled() {
+  return true;
+}
+
+#else  // COUNT_ALLOCATIONS
+
+bool AllocationCounter::IsEnabled() {
+  return false;
+}
+
+#endif  // COUNT_ALLOCATIONS
+
+INT64 AllocationCounter::GetCount() {
+  return g_numAllocations.load(std::memory_order_relaxed);
+}
\ No newline at end of file
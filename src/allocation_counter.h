@@ -0,0 +1,18 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_ALLOCATION_COUNTER_H_
+#define KINECT_PATIENTS_OBSERVER_ALLOCATION_COUNTER_H_
+
+/// <summary>
+/// Counts heap allocations of every thread through the global
+/// "operator new", which is replaced only when COUNT_ALLOCATIONS
+/// is defined, e.g. in Debug builds.
+/// </summary>
+class AllocationCounter {
+public:
+  static bool IsEnabled();
+  /// <summary>
+  /// Number of allocations so far, always 0 unless enabled.
+  /// </summary>
+  static INT64 GetCount();
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_ALLOCATION_COUNTER_H_
\ No newline at end of file
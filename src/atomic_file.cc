@@ -0,0 +1,14 @@
+﻿#include "atomic_file.h"
+
+bool WriteFileAtomically(const char *fileName,
+                         const std::function<void(FILE *)> &write) {
+  char temporaryFileName[MAX_PATH];
+  sprintf_s(temporaryFileName, "%s.tmp", fileName);
+  FILE *pFile;
+  if (fopen_s(&pFile, temporaryFileName, "w") != 0)
+    return false;
+  write(pFile);
+  fclose(pFile);
+  return MoveFileExA(temporaryFileName, fileName,
+                     MOVEFILE_REPLACE_EXISTING) != FALSE;
+}
\ No newline at end of file
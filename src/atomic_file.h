@@ -0,0 +1,18 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_ATOMIC_FILE_H_
+#define KINECT_PATIENTS_OBSERVER_ATOMIC_FILE_H_
+
+#include <stdio.h>
+#include <functional>
+
+/// <summary>
+/// Write a file through a temporary one, "<file name>.tmp", which
+/// replaces the file once complete, so that readers such as scrapers
+/// never see a partial file.
+/// </summary>
+/// <param name="fileName">path to the file</param>
+/// <param name="write">function writing the contents</param>
+/// <returns>whether the file was replaced</returns>
+bool WriteFileAtomically(const char *fileName,
+                         const std::function<void(FILE *)> &write);
+
+#endif  // KINECT_PATIENTS_OBSERVER_ATOMIC_FILE_H_
\ No newline at end of file
@@ -0,0 +1,186 @@
+﻿#include "batch_analyzer.h"
+#include <string.h>  // strlen(), strcspn()
+#include <algorithm>
+#include <memory>
+#include "depth_archive.h"
+#include "depth_sequence.h"
+#include "thread_pool.h"
+
+// "dir\bed_start.dpa" -> "bed_start".
+static std::string GetStem(const std::string &path) {
+  size_t begin = path.find_last_of("\\/");
+  begin = (begin == std::string::npos) ? 0 : begin + 1;
+  size_t end = path.find_last_of('.');
+  if (end == std::string::npos || end < begin)
+    end = path.size();
+  return path.substr(begin, end - begin);
+}
+
+BatchAnalyzer::BatchAnalyzer(ThreadPool *pThreadPool,
+                             const char *outputDirectory)
+    : m_pThreadPool(pThreadPool),
+      m_outputDirectory(outputDirectory),
+      m_elapsedTime(0.0) {
+}
+
+void BatchAnalyzer::AddRecording(const char *name,
+                                 const std::vector<std::string> &fileNames) {
+  // Beds of the same name in different directories get a suffix,
+  // e.g. "bed_start_2", not to overwrite each other's timeline.
+  std::string uniqueName = name;
+  for (int number = 2; ; ++number) {
+    bool isTaken = std::any_of(
+        m_recordings.begin(), m_recordings.end(),
+        [&uniqueName](const Recording &recording) {
+          return _stricmp(recording.name.c_str(), uniqueName.c_str()) == 0;
+        });
+    if (!isTaken)
+      break;
+    uniqueName = std::string(name) + "_" + std::to_string(number);
+  }
+  m_recordings.push_back({uniqueName, fileNames});
+}
+
+void BatchAnalyzer::AddDirectory(const char *directory) {
+  DepthArchiveCatalog catalog;
+  catalog.Scan(directory);
+  for (const std::vector<std::string> &fileNames :
+       catalog.GetFileNamesByBed())
+    AddRecording(GetStem(fileNames[0]).c_str(), fileNames);
+}
+
+bool BatchAnalyzer::AddList(const char *fileName) {
+  FILE *pFile;
+  if (fopen_s(&pFile, fileName, "r") != 0)
+    return false;
+
+  char line[MAX_PATH];
+  while (fgets(line, sizeof(line), pFile)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] == '\0' || line[0] == '#')
+      continue;
+
+    static const char cExtension[] = ".dpa";
+    size_t length = strlen(line);
+    bool isSegment = sizeof(cExtension) - 1 <= length &&
+        _stricmp(&line[length - (sizeof(cExtension) - 1)], cExtension) == 0;
+    if (isSegment)
+      AddRecording(GetStem(line).c_str(), std::vector<std::string>(1, line));
+    else
+      AddDirectory(line);
+  }
+
+  fclose(pFile);
+  return true;
+}
+
+void BatchAnalyzer::Run() {
+  // Start long recordings first not to wait for one at the end.
+  std::stable_sort(m_recordings.begin(), m_recordings.end(),
+                   [](const Recording &a, const Recording &b) {
+                     return a.fileNames.size() > b.fileNames.size();
+                   });
+
+  // Recordings are independent, so they share the cores
+  // and the frames of each are analyzed serially.
+  m_summaries.assign(m_recordings.size(), Summary());
+  Observer::Clock::time_point start = Observer::Clock::now();
+  m_pThreadPool->ParallelFor(
+      static_cast<int>(m_recordings.size()),
+      [&](int i) { Analyze(m_recordings[i], &m_summaries[i]); });
+  m_elapsedTime = std::chrono::duration<double, std::milli>(
+      Observer::Clock::now() - start).count();
+
+  FILE *pFile;
+  std::string fileName = m_outputDirectory + "\\summary.csv";
+  if (fopen_s(&pFile, fileName.c_str(), "w") == 0) {
+    WriteSummary(pFile);
+    fclose(pFile);
+  }
+}
+
+void BatchAnalyzer::WriteSummary(FILE *pFile) const {
+  fprintf(pFile, "recording,frames,ms/frame");
+  for (const char *pStateName : Observer::cStateNames)
+    fprintf(pFile, ",%s", pStateName);
+  fprintf(pFile, ",bed exits,provisional,confirmed,retracted,missed\n");
+
+  int numFrames = 0;
+  int numBedExits = 0;
+  for (const Summary &summary : m_summaries) {
+    if (!summary.isAnalyzed) {
+      fprintf(pFile, "%s,failed\n", summary.name.c_str());
+      continue;
+    }
+    fprintf(pFile, "%s,%d,%.2f", summary.name.c_str(), summary.numFrames,
+            summary.analysisTime / max(1, summary.numFrames));
+    for (int numFramesInState : summary.numFramesInStates)
+      fprintf(pFile, ",%d", numFramesInState);
+    const Observer::BedExitStatistics &bedExit = summary.bedExitStatistics;
+    fprintf(pFile, ",%d,%d,%d,%d,%d\n", summary.numBedExits,
+            bedExit.numProvisional, bedExit.numConfirmed,
+            bedExit.numRetracted, bedExit.numMissed);
+    numFrames += summary.numFrames;
+    numBedExits += summary.numBedExits;
+  }
+
+  fprintf(pFile, "total,%d,,,,,,,,%d,,,,\n", numFrames, numBedExits);
+  fprintf(pFile, "frames/s,%.1f\n", GetFramesPerSecond());
+}
+
+double BatchAnalyzer::GetFramesPerSecond() const {
+  int numFrames = 0;
+  for (const Summary &summary : m_summaries)
+    numFrames += summary.numFrames;
+  return (0.0 < m_elapsedTime) ? numFrames / (m_elapsedTime / 1000.0) : 0.0;
+}
+
+void BatchAnalyzer::Analyze(const Recording &recording,
+                            Summary *pSummary) const {
+  Summary &summary = *pSummary;
+  summary.name = recording.name;
+
+  ArchiveSequence sequence(recording.name.c_str(), recording.fileNames);
+  std::unique_ptr<Observer> pObserver(sequence.IsOpen() ?
+      Observer::Create(sequence.GetWidth(), sequence.GetHeight()) : NULL);
+  if (!pObserver || !sequence.Rewind())
+    return;
+  pObserver->SetKernelMode(Observer::eKernelFused);
+
+  // Write a line whenever the state changes.
+  FILE *pTimeline;
+  std::string fileName = m_outputDirectory + "\\" + recording.name + ".csv";
+  if (fopen_s(&pTimeline, fileName.c_str(), "w") != 0)
+    return;
+  fprintf(pTimeline, "frame,timestamp,state,probability\n");
+
+  std::vector<UINT16> frame(sequence.GetWidth() * sequence.GetHeight());
+  Observer::PatientState lastState = Observer::eNone;
+  Observer::Clock::time_point start = Observer::Clock::now();
+  while (sequence.ReadFrame(frame.data())) {
+    sequence.PrepareObserver(pObserver.get());
+    pObserver->Observe(frame.data());
+
+    Observer::PatientState state = pObserver->GetState();
+    ++summary.numFramesInStates[state];
+    bool wasOnBed = Observer::eSitting <= lastState;
+    bool isOffBed = state == Observer::eStanding ||
+                    state == Observer::eSittingOnEdge;
+    if (wasOnBed && isOffBed)
+      ++summary.numBedExits;
+
+    if (summary.numFrames == 0 || state != lastState) {
+      fprintf(pTimeline, "%d,%lld,%s,%.3f\n", summary.numFrames,
+              sequence.GetTimestamp(), Observer::cStateNames[state],
+              pObserver->GetProbabilityPatientOnBed());
+    }
+    lastState = state;
+    ++summary.numFrames;
+  }
+  summary.analysisTime = std::chrono::duration<double, std::milli>(
+      Observer::Clock::now() - start).count();
+  summary.bedExitStatistics = pObserver->GetBedExitStatistics();
+  summary.isAnalyzed = true;
+
+  fclose(pTimeline);
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_BATCH_ANALYZER_H_
+#define KINECT_PATIENTS_OBSERVER_BATCH_ANALYZER_H_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "observer.h"
+
+class ThreadPool;
+
+/// <summary>
+/// Re-analyzes recorded nights offline with the current constants,
+/// running an independent Observer per recording on every core.
+/// Writes a state timeline per recording and a summary.
+/// </summary>
+class BatchAnalyzer {
+public:
+  /// <summary>
+  /// Results of a recording.
+  /// </summary>
+  struct Summary {
+    std::string name;
+    int numFrames;
+    double analysisTime;  // [ms]
+    int numFramesInStates[Observer::eLyingOnSide + 1];
+    int numBedExits;  // Changes from on the bed to off the bed.
+    Observer::BedExitStatistics bedExitStatistics;
+    bool isAnalyzed;
+  };
+
+  /// <param name="pThreadPool">pool to run recordings on</param>
+  /// <param name="outputDirectory">existing directory to write
+  /// timelines and the summary</param>
+  BatchAnalyzer(ThreadPool *pThreadPool, const char *outputDirectory);
+
+  /// <summary>
+  /// Add the segments of a bed as a recording.
+  /// </summary>
+  /// <param name="name">name of the recording and its timeline,
+  /// with a suffix if another recording has it</param>
+  /// <param name="fileNames">paths to segments in time order</param>
+  void AddRecording(const char *name,
+                    const std::vector<std::string> &fileNames);
+  /// <summary>
+  /// Add every bed in a directory of segments as a recording.
+  /// </summary>
+  /// <param name="directory">directory of segments</param>
+  void AddDirectory(const char *directory);
+  /// <summary>
+  /// Add recordings listed in a file, a directory of segments
+  /// or a segment per line.
+  /// </summary>
+  /// <param name="fileName">path to the list</param>
+  /// <returns>whether the list was read</returns>
+  bool AddList(const char *fileName);
+
+  /// <summary>
+  /// Analyze all recordings added and write the results.
+  /// </summary>
+  void Run();
+  /// <summary>
+  /// Write the summary of every recording and of all of them.
+  /// </summary>
+  /// <param name="pFile">file to write</param>
+  void WriteSummary(FILE *pFile) const;
+
+  const std::vector<Summary> &GetSummaries() const { return m_summaries; }
+  /// <summary>
+  /// Frames analyzed per second of wall-clock time by all cores.
+  /// </summary>
+  double GetFramesPerSecond() const;
+
+private:
+  struct Recording {
+    std::string name;
+    std::vector<std::string> fileNames;
+  };
+
+  void Analyze(const Recording &recording, Summary *pSummary) const;
+
+  ThreadPool *m_pThreadPool;
+  std::string m_outputDirectory;
+  std::vector<Recording> m_recordings;
+  std::vector<Summary> m_summaries;
+  double m_elapsedTime;  // [ms]
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_BATCH_ANALYZER_H_
\ No newline at end of file
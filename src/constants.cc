@@ -0,0 +1,208 @@
+﻿#include "constants.h"
+#include <string.h>  // strcmp(), strrchr()
+
+// Names in a constants file and where their values go.
+struct DoubleEntry {
+  const char *name;
+  double Constants::*pValue;
+};
+struct IntEntry {
+  const char *name;
+  int Constants::*pValue;
+};
+
+static const DoubleEntry cDoubleEntries[] = {
+    {"cBorderProbabilityStanding", &Constants::borderProbabilityStanding},
+    {"cBorderProbabilitySittingOnEdge",
+     &Constants::borderProbabilitySittingOnEdge},
+    {"cFrameBudget", &Constants::frameBudget},
+};
+static const IntEntry cIntEntries[] = {
+    {"cDepthNoiseBorder", &Constants::depthNoiseBorder},
+    {"cDepthOnBedNoiseBorder", &Constants::depthOnBedNoiseBorder},
+    {"cDepthNoiseBorderToSearchForPatientArea",
+     &Constants::depthNoiseBorderToSearchForPatientArea},
+    {"cNumSkipToSearchForPatientArea",
+     &Constants::numSkipToSearchForPatientArea},
+    {"cNormalsDegreeTolerance", &Constants::normalsDegreeTolerance},
+    {"cNeighborPixelsDistanceTolerance",
+     &Constants::neighborPixelsDistanceTolerance},
+    {"cWidthToGetTempBedNormal", &Constants::widthToGetTempBedNormal},
+    {"cHeadWidth", &Constants::headWidth},
+    {"cShoulderHeightBorderTurningAndLying",
+     &Constants::shoulderHeightBorderTurningAndLying},
+    {"cHeadHeightBorderSittingAndLying",
+     &Constants::headHeightBorderSittingAndLying},
+    {"cDistanceHeadAndShoulder", &Constants::distanceHeadAndShoulder},
+    {"cDistanceHeadAndHip", &Constants::distanceHeadAndHip},
+};
+
+Constants::Constants()
+    : borderProbabilityStanding(0.55),
+      borderProbabilitySittingOnEdge(0.93),
+      depthNoiseBorder(300),
+      depthOnBedNoiseBorder(100),
+      depthNoiseBorderToSearchForPatientArea(20),
+      numSkipToSearchForPatientArea(5),
+      normalsDegreeTolerance(50),
+      neighborPixelsDistanceTolerance(25),
+      widthToGetTempBedNormal(150),
+      headWidth(140),
+      shoulderHeightBorderTurningAndLying(200),
+      headHeightBorderSittingAndLying(550),
+      distanceHeadAndShoulder(250),
+      distanceHeadAndHip(750),
+      frameBudget(1000.0 / 30) {
+}
+
+bool Constants::Load(const char *fileName, Constants *pConstants) {
+  // At first, initialize constants with defaults.
+  *pConstants = Constants();
+
+  // Open the configuration file.
+  FILE *pFile;
+  errno_t error = fopen_s(&pFile, fileName, "r");
+  if (error != 0)
+    return false;
+
+  // Read constants.
+  // http://stackoverflow.com/questions/17214026/
+  while (!feof(pFile)) {
+    char name[128];
+    double value;
+    if (fscanf_s(pFile, "%s%lf%*[\r\n ]", name, 128, &value) != 2)
+      break;
+
+    // Unknown names are ignored.
+    pConstants->Set(name, value);
+  }
+
+  fclose(pFile);
+
+  pConstants->Correct();
+  return true;
+}
+
+bool Constants::Set(const char *name, double value) {
+  // Interpret what the value is.
+  for (const DoubleEntry &entry : cDoubleEntries) {
+    if (strcmp(name, entry.name) == 0) {
+      this->*entry.pValue = value;
+      return true;
+    }
+  }
+  for (const IntEntry &entry : cIntEntries) {
+    if (strcmp(name, entry.name) == 0) {
+      this->*entry.pValue = static_cast<int>(value);
+      return true;
+    }
+  }
+  return false;
+}
+
+void Constants::Correct() {
+  Constants &c = *this;
+  c.borderProbabilitySittingOnEdge =
+      max(0.0, min(1.0, c.borderProbabilitySittingOnEdge));
+  c.borderProbabilityStanding =
+      max(0.0, min(c.borderProbabilitySittingOnEdge,
+                   c.borderProbabilityStanding));
+  for (const IntEntry &entry : cIntEntries)
+    c.*entry.pValue = max(0, c.*entry.pValue);
+  c.headWidth = max(1, c.headWidth);
+  c.widthToGetTempBedNormal = max(1, c.widthToGetTempBedNormal);
+  c.normalsDegreeTolerance = min(180, c.normalsDegreeTolerance);
+  c.distanceHeadAndHip = max(c.distanceHeadAndShoulder,
+                             c.distanceHeadAndHip);
+  c.frameBudget = max(1.0, c.frameBudget);
+}
+
+bool Constants::IsEqual(const Constants &other) const {
+  for (const DoubleEntry &entry : cDoubleEntries) {
+    if (this->*entry.pValue != other.*entry.pValue)
+      return false;
+  }
+  for (const IntEntry &entry : cIntEntries) {
+    if (this->*entry.pValue != other.*entry.pValue)
+      return false;
+  }
+  return true;
+}
+
+static bool GetLastWriteTime(const char *fileName, FILETIME *pTime) {
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (!GetFileAttributesExA(fileName, GetFileExInfoStandard, &data))
+    return false;
+  *pTime = data.ftLastWriteTime;
+  return true;
+}
+
+ConstantsWatcher::ConstantsWatcher(const char *fileName)
+    : m_generation(0),
+      m_lastWriteTime(),
+      m_hStopEvent(CreateEvent(NULL, TRUE, FALSE, NULL)) {
+  strcpy_s(m_fileName, fileName);
+
+  Constants constants;
+  GetLastWriteTime(m_fileName, &m_lastWriteTime);
+  Constants::Load(m_fileName, &constants);
+  Publish(constants);
+
+  m_thread = std::thread(&ConstantsWatcher::Watch, this);
+}
+
+ConstantsWatcher::~ConstantsWatcher() {
+  SetEvent(m_hStopEvent);
+  m_thread.join();
+  CloseHandle(m_hStopEvent);
+}
+
+void ConstantsWatcher::Publish(const Constants &constants) {
+  // Only the watcher thread publishes snapshots after construction.
+  std::atomic_store(&m_pCurrent, std::shared_ptr<const Constants>(
+                                     new Constants(constants)));
+  m_generation.fetch_add(1, std::memory_order_release);
+}
+
+void ConstantsWatcher::Watch() {
+  // Watch the directory of the file, since the file itself may be
+  // replaced by an editor.
+  char directory[MAX_PATH];
+  strcpy_s(directory, m_fileName);
+  char *pSeparator = strrchr(directory, '\\');
+  if (!pSeparator)
+    pSeparator = strrchr(directory, '/');
+  if (pSeparator)
+    *pSeparator = '\0';
+  else
+    strcpy_s(directory, ".");
+
+  HANDLE hChange = FindFirstChangeNotificationA(
+      directory, FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE);
+  if (hChange == INVALID_HANDLE_VALUE)
+    return;
+
+  HANDLE handles[2] = {m_hStopEvent, hChange};
+  while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) ==
+         WAIT_OBJECT_0 + 1) {
+    // Editors write a file in several steps, so wait a little.
+    // Writes of other files in the directory, e.g. metrics, and saves
+    // without changes don't publish a snapshot.
+    static const DWORD cSettleTimeMsec = 100;
+    Sleep(cSettleTimeMsec);
+    FILETIME lastWriteTime;
+    bool isWritten = GetLastWriteTime(m_fileName, &lastWriteTime) &&
+                     CompareFileTime(&lastWriteTime, &m_lastWriteTime) != 0;
+    Constants constants;
+    if (isWritten && Constants::Load(m_fileName, &constants)) {
+      m_lastWriteTime = lastWriteTime;
+      if (!constants.IsEqual(*GetCurrent()))
+        Publish(constants);
+    }
+
+    if (!FindNextChangeNotification(hChange))
+      break;
+  }
+
+  FindCloseChangeNotification(hChange);
+}
\ No newline at end of file
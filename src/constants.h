@@ -0,0 +1,108 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_CONSTANTS_H_
+#define KINECT_PATIENTS_OBSERVER_CONSTANTS_H_
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Thresholds of Observer, which can be tuned per room with
+/// "name value" lines in a file, e.g. "cHeadWidth 150".
+/// A snapshot is never modified once it is published.
+/// </summary>
+struct Constants {
+  Constants();
+
+  /// <summary>
+  /// Load constants from a file over the defaults and correct them.
+  /// </summary>
+  /// <param name="fileName">path to the file</param>
+  /// <param name="pConstants">loaded constants</param>
+  /// <returns>whether the file was read</returns>
+  static bool Load(const char *fileName, Constants *pConstants);
+  /// <summary>
+  /// Set a constant by its name in files, e.g. "cHeadWidth".
+  /// Call "Correct()" after setting constants.
+  /// </summary>
+  /// <param name="name">name of the constant</param>
+  /// <param name="value">value to set</param>
+  /// <returns>whether the name is known</returns>
+  bool Set(const char *name, double value);
+  /// <summary>
+  /// Correct constants into their valid ranges.
+  /// </summary>
+  void Correct();
+  /// <summary>
+  /// Whether every constant settable by its name is the same.
+  /// </summary>
+  bool IsEqual(const Constants &other) const;
+
+  // To judge a patient's state.
+  double borderProbabilityStanding;
+  double borderProbabilitySittingOnEdge;
+  // To get differences of depths.
+  int depthNoiseBorder;       // [mm]
+  int depthOnBedNoiseBorder;  // [mm]
+  // To search for a patient area.
+  int depthNoiseBorderToSearchForPatientArea;  // [mm]
+  int numSkipToSearchForPatientArea;
+  // To define a bed area.
+  int normalsDegreeTolerance;           // [degree]
+  int neighborPixelsDistanceTolerance;  // [mm]
+  int widthToGetTempBedNormal;          // [mm]
+  // To find a head.
+  int headWidth;  // [mm]
+  // To judge a patient's state.
+  int shoulderHeightBorderTurningAndLying;  // [mm]
+  int headHeightBorderSittingAndLying;      // [mm]
+  int distanceHeadAndShoulder;              // [mm]
+  int distanceHeadAndHip;                   // [mm]
+  // To keep up with frames.
+  double frameBudget;  // [ms]
+};
+
+/// <summary>
+/// Watches a constants file and publishes a new snapshot
+/// whenever the file is written with different constants.
+/// Readers share snapshots, and an old snapshot is freed
+/// once no reader holds it any more. Taking a snapshot may lock,
+/// so readers poll the generation and take it only when it changed.
+/// </summary>
+class ConstantsWatcher {
+public:
+  /// <summary>
+  /// Load the file and start watching it.
+  /// </summary>
+  /// <param name="fileName">path to the file</param>
+  explicit ConstantsWatcher(const char *fileName);
+  ~ConstantsWatcher();
+
+  /// <summary>
+  /// Get the latest snapshot, valid while it is held.
+  /// </summary>
+  std::shared_ptr<const Constants> GetCurrent() const {
+    return std::atomic_load(&m_pCurrent);
+  }
+  /// <summary>
+  /// Get the number of snapshots published, without locks.
+  /// The snapshot of a generation is published before it.
+  /// </summary>
+  UINT32 GetGeneration() const {
+    return m_generation.load(std::memory_order_acquire);
+  }
+
+private:
+  void Publish(const Constants &constants);
+  void Watch();
+
+  char m_fileName[MAX_PATH];
+  std::shared_ptr<const Constants> m_pCurrent;
+  std::atomic<UINT32> m_generation;
+  // Of the file loaded last, to ignore changes of other files.
+  FILETIME m_lastWriteTime;
+  HANDLE m_hStopEvent;
+  std::thread m_thread;
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_CONSTANTS_H_
\ No newline at end of file
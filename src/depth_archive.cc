@@ -0,0 +1,527 @@
+﻿#include "depth_archive.h"
+#include <algorithm>
+#include <string.h>  // memcpy()
+#include "observer.h"
+
+// To recognize a segment, "DPA1" and "DPAI".
+static const UINT32 cSegmentSignature = 0x31415044;
+static const UINT32 cFooterSignature = 0x49415044;
+// Backgrounds of version 1 are all intra coded.
+static const UINT32 cVersion = 2;
+// A second at 30 fps, which bounds frames to decode after a seek.
+static const int cFramesPerKeyFrame = 30;
+static const INT64 cSegmentDuration = 60LL * 10000000;  // [100 ns]
+
+DepthArchiveWriter::DepthArchiveWriter(const char *directory,
+                                       const char *bedName,
+                                       int width, int height)
+    : m_width(width),
+      m_height(height),
+      m_queuedSegmentStartTime(0),
+      m_numFramesSinceKeyFrame(0),
+      m_hasQueued(false),
+      m_slots(cNumSlots),
+      m_firstQueued(0),
+      m_numQueued(0),
+      m_isStopping(false),
+      m_encoder(width, height, cFramesPerKeyFrame),
+      m_backgroundEncoder(width, height, 1),
+      m_hasBackground(false),
+      m_background(width * height),
+      m_pFile(NULL),
+      m_segmentStartTime(0),
+      m_lastTimestamp(0),
+      m_position(0) {
+  strcpy_s(m_directory, directory);
+  strncpy_s(m_bedName, bedName, _TRUNCATE);
+  for (Slot &slot : m_slots) {
+    slot.frame.resize(width * height);
+    slot.background.resize(width * height);
+  }
+  m_thread = std::thread(&DepthArchiveWriter::Work, this);
+}
+
+DepthArchiveWriter::~DepthArchiveWriter() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isStopping = true;
+  }
+  m_frameQueued.notify_one();
+  m_thread.join();
+}
+
+bool DepthArchiveWriter::Write(INT64 timestamp, const UINT16 *pFrame,
+                               const Observer *pObserver) {
+  int slotIndex;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_numQueued == cNumSlots) {
+      // Keep a dropped key frame for the next frame.
+      if (m_numFramesSinceKeyFrame != 0)
+        m_numFramesSinceKeyFrame =
+            (m_numFramesSinceKeyFrame + 1) % cFramesPerKeyFrame;
+      return false;
+    }
+    slotIndex = (m_firstQueued + m_numQueued) % cNumSlots;
+  }
+
+  // The thread doesn't touch the slot until it is queued.
+  // Start a new segment every minute with a key frame.
+  Slot &slot = m_slots[slotIndex];
+  slot.timestamp = timestamp;
+  slot.startsSegment = !m_hasQueued ||
+      cSegmentDuration <= timestamp - m_queuedSegmentStartTime;
+  if (slot.startsSegment) {
+    m_queuedSegmentStartTime = timestamp;
+    m_numFramesSinceKeyFrame = 0;
+    m_hasQueued = true;
+  }
+  slot.isKeyFrame = m_numFramesSinceKeyFrame == 0;
+  m_numFramesSinceKeyFrame =
+      (m_numFramesSinceKeyFrame + 1) % cFramesPerKeyFrame;
+  memcpy(slot.frame.data(), pFrame, slot.frame.size() * sizeof(UINT16));
+
+  slot.state = ArchiveKeyFrameState();
+  if (slot.isKeyFrame && pObserver) {
+    std::vector<int> bedCorners = pObserver->GetBedCorners();
+    slot.state.numBedCorners = min(4, static_cast<int>(bedCorners.size()));
+    for (int i = 0; i < slot.state.numBedCorners; ++i)
+      slot.state.bedCorners[i] = bedCorners[i];
+    slot.state.hasBackground = 1;
+    slot.state.quiltHeight = pObserver->GetQuiltHeight();
+    memcpy(slot.background.data(), pObserver->GetBackground(),
+           slot.background.size() * sizeof(UINT16));
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_numQueued;
+  }
+  m_frameQueued.notify_one();
+  return true;
+}
+
+void DepthArchiveWriter::Work() {
+  for (;;) {
+    int slotIndex;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_frameQueued.wait(lock, [this]() {
+        return m_isStopping || 0 < m_numQueued;
+      });
+      // Write the frames waiting before stopping.
+      if (m_numQueued == 0)
+        break;
+      slotIndex = m_firstQueued;
+    }
+    WriteSlot(m_slots[slotIndex]);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_firstQueued = (m_firstQueued + 1) % cNumSlots;
+    --m_numQueued;
+  }
+  CloseSegment();
+}
+
+void DepthArchiveWriter::WriteSlot(const Slot &slot) {
+  if (slot.startsSegment) {
+    CloseSegment();
+    OpenSegment(slot.timestamp);
+  }
+  // Frames are dropped until the next segment after a failure.
+  if (!m_pFile)
+    return;
+  if (slot.isKeyFrame)
+    m_encoder.StartChunk();
+
+  ArchiveRecordHeader header = {};
+  header.timestamp = slot.timestamp;
+  m_record.resize(sizeof(header));
+
+  const UINT16 *pReference = NULL;
+  if (m_encoder.IsNextKeyFrame()) {
+    header.type = ArchiveRecordHeader::eKeyFrameRecord;
+    const BYTE *pState = reinterpret_cast<const BYTE *>(&slot.state);
+    m_record.insert(m_record.end(), pState, pState + sizeof(slot.state));
+    if (slot.state.hasBackground) {
+      // Predict the background from the one of the last key frame.
+      pReference = slot.background.data();
+      m_backgroundEncoder.Encode(
+          pReference, m_hasBackground ? m_background.data() : NULL,
+          &m_record);
+      m_background = slot.background;
+    }
+    m_hasBackground = pReference != NULL;
+    m_index.push_back({slot.timestamp, m_position});
+  } else {
+    header.type = ArchiveRecordHeader::eFrameRecord;
+  }
+  m_encoder.Encode(slot.frame.data(), pReference, &m_record);
+  header.size = static_cast<UINT32>(m_record.size() - sizeof(header));
+  memcpy(m_record.data(), &header, sizeof(header));
+
+  if (fwrite(m_record.data(), m_record.size(), 1, m_pFile) != 1) {
+    CloseSegment();
+    return;
+  }
+  m_position += m_record.size();
+  m_lastTimestamp = slot.timestamp;
+}
+
+bool DepthArchiveWriter::OpenSegment(INT64 startTime) {
+  char fileName[MAX_PATH];
+  sprintf_s(fileName, "%s\\%s_%lld.dpa", m_directory, m_bedName, startTime);
+  if (fopen_s(&m_pFile, fileName, "wb") != 0) {
+    m_pFile = NULL;
+    return false;
+  }
+
+  ArchiveSegmentHeader header = {};
+  header.signature = cSegmentSignature;
+  header.version = cVersion;
+  header.width = m_width;
+  header.height = m_height;
+  header.startTime = startTime;
+  strcpy_s(header.bedName, m_bedName);
+  fwrite(&header, sizeof(header), 1, m_pFile);
+
+  m_segmentStartTime = startTime;
+  m_lastTimestamp = startTime;
+  m_position = sizeof(header);
+  m_index.clear();
+  m_hasBackground = false;
+  return true;
+}
+
+void DepthArchiveWriter::CloseSegment() {
+  if (!m_pFile)
+    return;
+
+  // Append the index for seeking.
+  ArchiveSegmentFooter footer = {};
+  footer.indexOffset = m_position;
+  footer.endTime = m_lastTimestamp;
+  footer.numIndexEntries = static_cast<UINT32>(m_index.size());
+  footer.signature = cFooterSignature;
+  if (!m_index.empty())
+    fwrite(m_index.data(), sizeof(m_index[0]), m_index.size(), m_pFile);
+  fwrite(&footer, sizeof(footer), 1, m_pFile);
+
+  fclose(m_pFile);
+  m_pFile = NULL;
+}
+
+DepthArchiveReader::DepthArchiveReader()
+    : m_hFile(INVALID_HANDLE_VALUE),
+      m_hMapping(NULL),
+      m_pData(NULL),
+      m_size(0),
+      m_recordsEnd(0),
+      m_position(0),
+      m_header(),
+      m_endTime(0),
+      m_hasState(false),
+      m_state(),
+      m_hasBackground(false) {
+}
+
+DepthArchiveReader::~DepthArchiveReader() {
+  Close();
+}
+
+bool DepthArchiveReader::Open(const char *fileName) {
+  Close();
+
+  // Share with the writer to replay a segment being recorded.
+  m_hFile = CreateFileA(fileName, GENERIC_READ,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  LARGE_INTEGER size = {};
+  bool isOpened = m_hFile != INVALID_HANDLE_VALUE &&
+                  GetFileSizeEx(m_hFile, &size) &&
+                  sizeof(m_header) <= static_cast<UINT64>(size.QuadPart);
+  if (isOpened) {
+    m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY,
+                                    0, 0, NULL);
+    isOpened = m_hMapping != NULL;
+  }
+  if (isOpened) {
+    m_pData = static_cast<const BYTE *>(
+        MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+    isOpened = m_pData != NULL;
+  }
+  if (isOpened) {
+    m_size = size.QuadPart;
+    memcpy(&m_header, m_pData, sizeof(m_header));
+    m_header.bedName[sizeof(m_header.bedName) - 1] = '\0';
+    isOpened = m_header.signature == cSegmentSignature &&
+               1 <= m_header.version && m_header.version <= cVersion &&
+               0 < m_header.width && 0 < m_header.height;
+  }
+  if (!isOpened) {
+    Close();
+    return false;
+  }
+
+  if (!ReadIndex())
+    BuildIndex();
+  m_position = sizeof(m_header);
+
+  int width = m_header.width;
+  int height = m_header.height;
+  m_pDecoder.reset(new DepthDecoder(width, height));
+  m_pBackgroundDecoder.reset(new DepthDecoder(width, height));
+  m_background.resize(width * height);
+  m_nextBackground.resize(width * height);
+  m_hasState = false;
+  m_hasBackground = false;
+  return true;
+}
+
+void DepthArchiveReader::Close() {
+  if (m_pData)
+    UnmapViewOfFile(m_pData);
+  if (m_hMapping)
+    CloseHandle(m_hMapping);
+  if (m_hFile != INVALID_HANDLE_VALUE)
+    CloseHandle(m_hFile);
+  m_pData = NULL;
+  m_hMapping = NULL;
+  m_hFile = INVALID_HANDLE_VALUE;
+  m_size = 0;
+  m_recordsEnd = 0;
+  m_index.clear();
+}
+
+bool DepthArchiveReader::Seek(INT64 timestamp) {
+  if (m_index.empty())
+    return false;
+
+  // The last key frame at or before the time, or the first one.
+  std::vector<ArchiveIndexEntry>::const_iterator it = std::upper_bound(
+      m_index.begin(), m_index.end(), timestamp,
+      [](INT64 time, const ArchiveIndexEntry &entry) {
+        return time < entry.timestamp;
+      });
+  if (it != m_index.begin())
+    --it;
+
+  // Decode backgrounds from the last intra coded one before it.
+  std::vector<ArchiveIndexEntry>::const_iterator first = it;
+  while (first != m_index.begin()) {
+    ArchiveRecordHeader header;
+    const BYTE *pRecord = GetRecord((first - 1)->offset, &header);
+    ArchiveKeyFrameState state = {};
+    DepthFrameHeader backgroundHeader = {};
+    if (pRecord && sizeof(state) <= header.size)
+      memcpy(&state, pRecord, sizeof(state));
+    bool isPredicted =
+        state.hasBackground &&
+        DepthDecoder::ReadHeader(pRecord + sizeof(state),
+                                 header.size - sizeof(state),
+                                 &backgroundHeader) &&
+        backgroundHeader.type == DepthFrameHeader::eReferenceKeyFrame;
+    --first;
+    if (!isPredicted)
+      break;
+  }
+  m_hasBackground = false;
+  for (; first != it; ++first) {
+    ArchiveRecordHeader header;
+    const BYTE *pRecord = GetRecord(first->offset, &header);
+    UINT64 size = header.size;
+    if (!pRecord || !ReadKeyFrameState(&pRecord, &size))
+      m_hasBackground = false;
+  }
+
+  m_position = it->offset;
+  m_hasState = false;
+  return true;
+}
+
+bool DepthArchiveReader::ReadFrame(INT64 *pTimestamp, UINT16 *pFrame) {
+  ArchiveRecordHeader header;
+  const BYTE *pRecord = GetRecord(m_position, &header);
+  if (!pRecord)
+    return false;
+  UINT64 size = header.size;
+
+  const UINT16 *pReference = NULL;
+  if (header.type == ArchiveRecordHeader::eKeyFrameRecord) {
+    m_hasState = false;
+    if (!ReadKeyFrameState(&pRecord, &size))
+      return false;
+    if (m_state.hasBackground) {
+      pReference = m_background.data();
+      m_hasState = true;
+    }
+  }
+  if (!m_pDecoder->Decode(pRecord, static_cast<size_t>(size), pReference,
+                          pFrame))
+    return false;
+
+  *pTimestamp = header.timestamp;
+  m_position += sizeof(header) + header.size;
+  return true;
+}
+
+bool DepthArchiveReader::WarmStart(Observer *pObserver) const {
+  int size = m_header.width * m_header.height;
+  if (!m_hasState || pObserver->GetDepthBufferWidth() != m_header.width ||
+      pObserver->GetDepthBufferHeight() != m_header.height)
+    return false;
+
+  // Ignore a broken bed.
+  std::vector<int> bedCorners;
+  int numBedCorners = min(4, max(0, m_state.numBedCorners));
+  for (int i = 0; i < numBedCorners; ++i) {
+    if (m_state.bedCorners[i] < 0 || size <= m_state.bedCorners[i]) {
+      bedCorners.clear();
+      break;
+    }
+    bedCorners.push_back(m_state.bedCorners[i]);
+  }
+
+  pObserver->WarmStart(m_background.data(), bedCorners, m_state.quiltHeight);
+  return true;
+}
+
+const BYTE *DepthArchiveReader::GetRecord(
+    UINT64 position, ArchiveRecordHeader *pHeader) const {
+  if (!m_pData || m_recordsEnd < position + sizeof(*pHeader))
+    return NULL;
+  memcpy(pHeader, &m_pData[position], sizeof(*pHeader));
+  if (m_recordsEnd - position - sizeof(*pHeader) < pHeader->size)
+    return NULL;
+  return &m_pData[position + sizeof(*pHeader)];
+}
+
+bool DepthArchiveReader::ReadKeyFrameState(const BYTE **ppRecord,
+                                           UINT64 *pSize) {
+  if (*pSize < sizeof(m_state))
+    return false;
+  memcpy(&m_state, *ppRecord, sizeof(m_state));
+  *ppRecord += sizeof(m_state);
+  *pSize -= sizeof(m_state);
+  if (!m_state.hasBackground) {
+    m_hasBackground = false;
+    return true;
+  }
+
+  // The background may be predicted from the one of the last key frame.
+  DepthFrameHeader backgroundHeader;
+  const UINT16 *pPrevious = m_hasBackground ? m_background.data() : NULL;
+  m_hasBackground = false;
+  if (!DepthDecoder::ReadHeader(*ppRecord, static_cast<size_t>(*pSize),
+                                &backgroundHeader) ||
+      !m_pBackgroundDecoder->Decode(*ppRecord, static_cast<size_t>(*pSize),
+                                    pPrevious, m_nextBackground.data()))
+    return false;
+  m_background.swap(m_nextBackground);
+  m_hasBackground = true;
+  size_t backgroundSize = sizeof(backgroundHeader) +
+                          backgroundHeader.payloadBytes;
+  *ppRecord += backgroundSize;
+  *pSize -= backgroundSize;
+  return true;
+}
+
+bool DepthArchiveReader::ReadIndex() {
+  if (m_size < sizeof(m_header) + sizeof(ArchiveSegmentFooter))
+    return false;
+  ArchiveSegmentFooter footer;
+  memcpy(&footer, &m_pData[m_size - sizeof(footer)], sizeof(footer));
+  UINT64 indexSize = footer.numIndexEntries * sizeof(ArchiveIndexEntry);
+  bool isValid = footer.signature == cFooterSignature &&
+                 sizeof(m_header) <= footer.indexOffset &&
+                 footer.indexOffset <= m_size &&
+                 footer.indexOffset + indexSize + sizeof(footer) == m_size;
+  if (!isValid)
+    return false;
+
+  // Copy the index since its offset may not be aligned.
+  m_index.resize(footer.numIndexEntries);
+  if (!m_index.empty())
+    memcpy(m_index.data(), &m_pData[footer.indexOffset], indexSize);
+  m_recordsEnd = footer.indexOffset;
+  m_endTime = footer.endTime;
+  return true;
+}
+
+void DepthArchiveReader::BuildIndex() {
+  // Walk records up to the last complete one.
+  m_index.clear();
+  m_endTime = m_header.startTime;
+  UINT64 position = sizeof(m_header);
+  while (position + sizeof(ArchiveRecordHeader) <= m_size) {
+    ArchiveRecordHeader header;
+    memcpy(&header, &m_pData[position], sizeof(header));
+    UINT64 next = position + sizeof(header) + header.size;
+    if (m_size < next)
+      break;
+    if (header.type == ArchiveRecordHeader::eKeyFrameRecord)
+      m_index.push_back({header.timestamp, position});
+    m_endTime = header.timestamp;
+    position = next;
+  }
+  m_recordsEnd = position;
+}
+
+void DepthArchiveCatalog::Scan(const char *directory) {
+  m_segments.clear();
+
+  char pattern[MAX_PATH];
+  sprintf_s(pattern, "%s\\*.dpa", directory);
+  WIN32_FIND_DATAA findData;
+  HANDLE hFind = FindFirstFileA(pattern, &findData);
+  if (hFind == INVALID_HANDLE_VALUE)
+    return;
+  do {
+    Segment segment;
+    segment.fileName = std::string(directory) + "\\" + findData.cFileName;
+    DepthArchiveReader reader;
+    if (!reader.Open(segment.fileName.c_str()))
+      continue;
+    segment.bedName = reader.GetBedName();
+    segment.startTime = reader.GetStartTime();
+    segment.endTime = reader.GetEndTime();
+    m_segments.push_back(segment);
+  } while (FindNextFileA(hFind, &findData));
+  FindClose(hFind);
+
+  std::sort(m_segments.begin(), m_segments.end(),
+            [](const Segment &a, const Segment &b) {
+              return a.bedName != b.bedName ? a.bedName < b.bedName :
+                  a.startTime < b.startTime;
+            });
+}
+
+const DepthArchiveCatalog::Segment *DepthArchiveCatalog::Find(
+    const char *bedName, INT64 timestamp) const {
+  for (const Segment &segment : m_segments) {
+    if (segment.bedName == bedName && timestamp <= segment.endTime)
+      return &segment;
+  }
+  return NULL;
+}
+
+const DepthArchiveCatalog::Segment *DepthArchiveCatalog::FindNext(
+    const Segment *pSegment) const {
+  size_t next = pSegment - m_segments.data() + 1;
+  if (next < m_segments.size() &&
+      m_segments[next].bedName == pSegment->bedName)
+    return &m_segments[next];
+  return NULL;
+}
+
+std::vector<std::vector<std::string>>
+DepthArchiveCatalog::GetFileNamesByBed() const {
+  // Segments are sorted by bed and time.
+  std::vector<std::vector<std::string>> fileNamesByBed;
+  for (size_t i = 0; i < m_segments.size(); ++i) {
+    if (i == 0 || m_segments[i].bedName != m_segments[i - 1].bedName)
+      fileNamesByBed.push_back(std::vector<std::string>());
+    fileNamesByBed.back().push_back(m_segments[i].fileName);
+  }
+  return fileNamesByBed;
+}
\ No newline at end of file
@@ -0,0 +1,273 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_DEPTH_ARCHIVE_H_
+#define KINECT_PATIENTS_OBSERVER_DEPTH_ARCHIVE_H_
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "depth_codec.h"
+
+class Observer;
+
+// Recordings of a bed are split into segment files of a minute,
+// "<bed name>_<start time>.dpa".
+// A segment is a header, records of frames and an index of key frames.
+// A key frame record holds the background and the bed of Observer,
+// so that replay can start from any key frame.
+// Backgrounds change slowly, so the background of a key frame is
+// predicted from the one of the previous key frame in the segment.
+// Timestamps are in 100 ns since 1601 like FILETIME.
+
+struct ArchiveSegmentHeader {
+  UINT32 signature;
+  UINT32 version;
+  UINT32 width;   // [px]
+  UINT32 height;  // [px]
+  INT64 startTime;
+  char bedName[32];
+};
+
+struct ArchiveRecordHeader {
+  enum RecordType {
+    eFrameRecord,
+    eKeyFrameRecord,  // ArchiveKeyFrameState and the background first.
+  };
+
+  INT64 timestamp;
+  UINT32 type;  // RecordType.
+  UINT32 size;  // Following the header.
+};
+
+struct ArchiveKeyFrameState {
+  INT32 bedCorners[4];
+  INT32 numBedCorners;
+  INT32 hasBackground;
+  double quiltHeight;
+};
+
+struct ArchiveIndexEntry {
+  INT64 timestamp;
+  UINT64 offset;  // Of the key frame record.
+};
+
+// At the end of a closed segment, after the index.
+struct ArchiveSegmentFooter {
+  UINT64 indexOffset;
+  INT64 endTime;
+  UINT32 numIndexEntries;
+  UINT32 signature;
+};
+
+/// <summary>
+/// Records depth frames of a bed into segment files.
+/// Frames are copied into slots, and a thread of the writer encodes
+/// and writes them, so that a slow disk doesn't delay the frame loop.
+/// </summary>
+class DepthArchiveWriter {
+public:
+  // Frames waiting for the disk, half a second at 30 fps.
+  // Frames are dropped while every slot is waiting.
+  static const int cNumSlots = 15;
+
+  /// <summary>
+  /// Prepare to record.
+  /// </summary>
+  /// <param name="directory">directory to put segments</param>
+  /// <param name="bedName">name of the bed</param>
+  /// <param name="width">width of frames</param>
+  /// <param name="height">height of frames</param>
+  DepthArchiveWriter(const char *directory, const char *bedName,
+                     int width, int height);
+  /// <summary>
+  /// Write the frames waiting, and close the segment.
+  /// </summary>
+  ~DepthArchiveWriter();
+
+  /// <summary>
+  /// Queue a frame to append.
+  /// </summary>
+  /// <param name="timestamp">time when the frame was taken</param>
+  /// <param name="pFrame">raw depth frame</param>
+  /// <param name="pObserver">observer of the frame to save its state
+  /// in key frames, or NULL</param>
+  /// <returns>whether the frame was queued</returns>
+  bool Write(INT64 timestamp, const UINT16 *pFrame,
+             const Observer *pObserver);
+
+private:
+  struct Slot {
+    INT64 timestamp;
+    bool startsSegment;
+    bool isKeyFrame;
+    ArchiveKeyFrameState state;  // Of a key frame.
+    std::vector<UINT16> frame;
+    std::vector<UINT16> background;
+  };
+
+  void Work();
+  void WriteSlot(const Slot &slot);
+  bool OpenSegment(INT64 startTime);
+  void CloseSegment();
+
+  char m_directory[MAX_PATH];
+  char m_bedName[32];
+  int m_width;   // [px]
+  int m_height;  // [px]
+  // Of the frame loop, deciding segments and key frames.
+  INT64 m_queuedSegmentStartTime;
+  int m_numFramesSinceKeyFrame;
+  bool m_hasQueued;
+  // Slots in [m_firstQueued, m_firstQueued + m_numQueued) are waiting,
+  // in a ring.
+  std::vector<Slot> m_slots;
+  int m_firstQueued;
+  int m_numQueued;
+  bool m_isStopping;
+  std::mutex m_mutex;
+  std::condition_variable m_frameQueued;
+  std::thread m_thread;
+  // Of the thread.
+  DepthEncoder m_encoder;
+  DepthEncoder m_backgroundEncoder;
+  // Of the last key frame in the segment, to predict the next one.
+  bool m_hasBackground;
+  std::vector<UINT16> m_background;
+  // Current segment.
+  FILE *m_pFile;
+  INT64 m_segmentStartTime;
+  INT64 m_lastTimestamp;
+  UINT64 m_position;
+  std::vector<ArchiveIndexEntry> m_index;
+  std::vector<BYTE> m_record;
+};
+
+/// <summary>
+/// Replays a segment mapped into memory,
+/// so seeking costs only the pages touched.
+/// </summary>
+class DepthArchiveReader {
+public:
+  DepthArchiveReader();
+  ~DepthArchiveReader();
+
+  /// <summary>
+  /// Open a segment.
+  /// A segment still being written is indexed by scanning its records.
+  /// </summary>
+  /// <param name="fileName">path to the segment</param>
+  /// <returns>whether the segment was opened</returns>
+  bool Open(const char *fileName);
+  void Close();
+
+  /// <summary>
+  /// Move to the last key frame at or before the time.
+  /// Backgrounds of the key frames before it are decoded to predict
+  /// its background.
+  /// </summary>
+  /// <param name="timestamp">time to seek</param>
+  /// <returns>whether there is a key frame</returns>
+  bool Seek(INT64 timestamp);
+  /// <summary>
+  /// Read and decode the next frame.
+  /// </summary>
+  /// <param name="pTimestamp">time of the frame</param>
+  /// <param name="pFrame">decoded frame</param>
+  /// <returns>whether a frame was read</returns>
+  bool ReadFrame(INT64 *pTimestamp, UINT16 *pFrame);
+  /// <summary>
+  /// Restore the state of the observer saved in the last key frame read.
+  /// </summary>
+  /// <param name="pObserver">observer for frames of the segment</param>
+  /// <returns>whether the state was restored</returns>
+  bool WarmStart(Observer *pObserver) const;
+
+  // Accessors.
+  int GetWidth() const { return m_header.width; }
+  int GetHeight() const { return m_header.height; }
+  const char *GetBedName() const { return m_header.bedName; }
+  INT64 GetStartTime() const { return m_header.startTime; }
+  INT64 GetEndTime() const { return m_endTime; }
+
+private:
+  bool ReadIndex();
+  void BuildIndex();
+  /// <summary>
+  /// Get a complete record.
+  /// </summary>
+  /// <param name="position">offset of the record</param>
+  /// <param name="pHeader">header of the record</param>
+  /// <returns>data following the header, or NULL</returns>
+  const BYTE *GetRecord(UINT64 position, ArchiveRecordHeader *pHeader) const;
+  /// <summary>
+  /// Read the state and the background of a key frame record.
+  /// </summary>
+  /// <param name="ppRecord">record after its header, moved to the
+  /// frame</param>
+  /// <param name="pSize">size of the record, reduced by what was
+  /// read</param>
+  /// <returns>whether the record was read</returns>
+  bool ReadKeyFrameState(const BYTE **ppRecord, UINT64 *pSize);
+
+  HANDLE m_hFile;
+  HANDLE m_hMapping;
+  const BYTE *m_pData;
+  UINT64 m_size;
+  UINT64 m_recordsEnd;
+  UINT64 m_position;
+  ArchiveSegmentHeader m_header;
+  INT64 m_endTime;
+  std::vector<ArchiveIndexEntry> m_index;
+  // Decoding.
+  std::unique_ptr<DepthDecoder> m_pDecoder;
+  std::unique_ptr<DepthDecoder> m_pBackgroundDecoder;
+  // State of the last key frame.
+  bool m_hasState;
+  ArchiveKeyFrameState m_state;
+  // Of the last key frame with a background.
+  bool m_hasBackground;
+  std::vector<UINT16> m_background;
+  std::vector<UINT16> m_nextBackground;
+};
+
+/// <summary>
+/// Segments of recordings in a directory, e.g. of a night.
+/// </summary>
+class DepthArchiveCatalog {
+public:
+  struct Segment {
+    std::string fileName;
+    std::string bedName;
+    INT64 startTime;
+    INT64 endTime;
+  };
+
+  /// <summary>
+  /// List segments in a directory sorted by bed and time.
+  /// </summary>
+  /// <param name="directory">directory of segments</param>
+  void Scan(const char *directory);
+  /// <summary>
+  /// Find the segment of a bed containing the time, or the next one.
+  /// </summary>
+  /// <param name="bedName">name of the bed</param>
+  /// <param name="timestamp">time to find</param>
+  /// <returns>found segment, or NULL</returns>
+  const Segment *Find(const char *bedName, INT64 timestamp) const;
+  /// <summary>
+  /// Get the segment recorded after the given one for the same bed.
+  /// </summary>
+  const Segment *FindNext(const Segment *pSegment) const;
+  /// <summary>
+  /// Get paths to segments of every bed in time order.
+  /// </summary>
+  std::vector<std::vector<std::string>> GetFileNamesByBed() const;
+
+  const std::vector<Segment> &GetSegments() const { return m_segments; }
+
+private:
+  std::vector<Segment> m_segments;
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_DEPTH_ARCHIVE_H_
\ No newline at end of file
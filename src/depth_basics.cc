@@ -1,335 +1,769 @@
-﻿#include "depth_basics.h"
-#include <strsafe.h>
-#include "resource.h"
-#include "image_renderer.h"
-#include "observer.h"
-#include "kinect_option.h"
-
-const int DepthBasics::cWindowWidth = 383;
-const int DepthBasics::cWindowHeight = 318;
-
-/// <summary>
-/// Entry point for the application.
-/// </summary>
-/// <param name="hInstance">handle to the application instance</param>
-/// <param name="hPrevInstance">always 0</param>
-/// <param name="lpCmdLine">command line arguments</param>
-/// <param name="nCmdShow">whether to display minimized, maximized,
-/// or normally</param>
-/// <returns>status</returns>
-int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
-                      _In_opt_ HINSTANCE hPrevInstance,
-                      _In_ LPWSTR lpCmdLine,
-                      _In_ int nShowCmd) {
-  UNREFERENCED_PARAMETER(hPrevInstance);
-  UNREFERENCED_PARAMETER(lpCmdLine);
-
-  DepthBasics application;
-  application.Run(hInstance, nShowCmd);
-}
-
-DepthBasics::DepthBasics()
-    : m_hWnd(NULL),
-      m_nLastCounter(0),
-      m_nFramesSinceUpdate(0),
-      m_fFreq(0),
-      m_nNextStatusTime(0LL),
-      m_pKinectSensor(NULL),
-      m_pDepthFrameReader(NULL),
-      m_pD2DFactory(NULL),
-      m_pDrawDepth(NULL),
-      m_pDepthRGBX(NULL),
-      m_pObserver(NULL) {
-  LARGE_INTEGER qpf = {0};
-  if (QueryPerformanceFrequency(&qpf))
-    m_fFreq = double(qpf.QuadPart);
-
-  // Create heap storage for depth pixel data in RGBX format.
-  m_pDepthRGBX = new RGBQUAD[KinectOption::cDepthBufferSize];
-
-  // Create an instance of Observer.
-  m_pObserver = new Observer();
-}
-
-DepthBasics::~DepthBasics() {
-  // Clean up Direct2D renderer.
-  if (m_pDrawDepth) {
-    delete m_pDrawDepth;
-    m_pDrawDepth = NULL;
-  }
-
-  if (m_pDepthRGBX) {
-    delete[] m_pDepthRGBX;
-    m_pDepthRGBX = NULL;
-  }
-
-  if (m_pObserver) {
-    delete m_pObserver;
-    m_pObserver = NULL;
-  }
-
-  // Clean up Direct2D.
-  SafeRelease(m_pD2DFactory);
-
-  // Done with depth frame reader.
-  SafeRelease(m_pDepthFrameReader);
-
-  // Close the Kinect Sensor.
-  if (m_pKinectSensor)
-    m_pKinectSensor->Close();
-
-  SafeRelease(m_pKinectSensor);
-}
-
-LRESULT CALLBACK DepthBasics::MessageRouter(HWND hWnd, UINT uMsg,
-                                            WPARAM wParam, LPARAM lParam) {
-  DepthBasics *pThis = NULL;
-
-  if (WM_INITDIALOG == uMsg) {
-    pThis = reinterpret_cast<DepthBasics *>(lParam);
-    SetWindowLongPtr(hWnd, GWLP_USERDATA,
-                     reinterpret_cast<LONG_PTR>(pThis));
-  } else {
-    pThis = reinterpret_cast<DepthBasics *>(
-        ::GetWindowLongPtr(hWnd, GWLP_USERDATA));
-  }
-
-  if (pThis)
-    return pThis->DlgProc(hWnd, uMsg, wParam, lParam);
-
-  return 0;
-}
-
-LRESULT CALLBACK DepthBasics::DlgProc(HWND hWnd, UINT message,
-                                      WPARAM wParam, LPARAM lParam) {
-  UNREFERENCED_PARAMETER(wParam);
-  UNREFERENCED_PARAMETER(lParam);
-
-  HRESULT hr;
-
-  switch (message) {
-  case WM_INITDIALOG:
-    // Bind application window handle.
-    m_hWnd = hWnd;
-
-    // Initialize Direct2D.
-    D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, &m_pD2DFactory);
-
-    // Create and initialize a new Direct2D image renderer.
-    // (take a look at image_renderer.h)
-    // We'll use this to draw the data
-    // we receive from the Kinect to the screen.
-    m_pDrawDepth = new ImageRenderer(m_pObserver);
-    hr = m_pDrawDepth->Initialize(
-        GetDlgItem(m_hWnd, IDC_VIDEOVIEW),
-        m_pD2DFactory,
-        KinectOption::cDepthBufferWidth,
-        KinectOption::cDepthBufferHeight,
-        KinectOption::cDepthBufferWidth * sizeof(RGBQUAD));
-    if (FAILED(hr)) {
-      SetStatusMessage(L"Failed to initialize the Direct2D draw device.",
-                       10000, true);
-    }
-
-    // Get and initialize the default Kinect sensor.
-    InitializeDefaultSensor();
-
-    break;
-
-  case WM_CLOSE:
-    // If the titlebar X is clicked, destroy app.
-    DestroyWindow(hWnd);
-    break;
-
-  case WM_DESTROY:
-    // Quit the main message pump.
-    PostQuitMessage(0);
-    break;
-
-  case WM_RBUTTONDOWN:
-    // Initialize the observer.
-    m_pObserver->InitializeOnlyBackgroundNext();
-    break;
-
-  case WM_RBUTTONDBLCLK:
-    // Initialize the observer.
-    m_pObserver->InitializeAllNext();
-    break;
-
-  case WM_LBUTTONDOWN:
-  case WM_LBUTTONDBLCLK:
-    // NOTE: You can get clicked coordinates with uncommenting below.
-    //// Get clicked position.
-    //int x = LOWORD(lParam);
-    //int y = HIWORD(lParam);
-
-    //// Convert DLU into px.
-    //// https://support.microsoft.com/ja-jp/kb/145994
-    //tagRECT rc = {0};
-    //rc.right = cWindowWidth * 1L;
-    //rc.bottom = cWindowHeight * 1L;
-    //MapDialogRect(hWnd, &rc);
-    //x = x * KinectOption::cDepthBufferWidth / rc.right;
-    //y = y * KinectOption::cDepthBufferHeight / rc.bottom;
-
-    //// To prevent from accessing out of memory.
-    //x = min(KinectOption::cDepthBufferWidth - 1, max(0, x));
-    //y = min(KinectOption::cDepthBufferHeight - 1, max(0, y));
-
-    break;
-  }
-
-  return false;
-}
-
-int DepthBasics::Run(HINSTANCE hInstance, int nCmdShow) {
-  MSG msg = {0};
-  WNDCLASS wc;
-
-  // Dialog custom window class.
-  ZeroMemory(&wc, sizeof(wc));
-  wc.style = CS_HREDRAW | CS_VREDRAW | CS_DBLCLKS;
-  wc.cbWndExtra = DLGWINDOWEXTRA;
-  wc.hCursor = LoadCursorW(NULL, IDC_ARROW);
-  wc.hIcon = LoadIconW(hInstance, MAKEINTRESOURCE(IDI_APP));
-  wc.lpfnWndProc = DefDlgProcW;
-  wc.lpszClassName = L"DepthBasicsAppDlgWndClass";
-
-  if (!RegisterClassW(&wc))
-    return 0;
-
-  // Create main application window.
-  HWND hWndApp = CreateDialogParamW(
-      NULL,
-      MAKEINTRESOURCE(IDD_APP),
-      NULL,
-      (DLGPROC)DepthBasics::MessageRouter,
-      reinterpret_cast<LPARAM>(this));
-
-  // Show window.
-  ShowWindow(hWndApp, nCmdShow);
-
-  // Main message loop.
-  while (WM_QUIT != msg.message) {
-    Update();
-
-    while (PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE)) {
-      // If a dialog message will be taken care of by the dialog proc.
-      if (hWndApp && IsDialogMessageW(hWndApp, &msg))
-        continue;
-
-      TranslateMessage(&msg);
-      DispatchMessageW(&msg);
-    }
-  }
-
-  return static_cast<int>(msg.wParam);
-}
-
-void DepthBasics::Update() {
-  if (!m_pDepthFrameReader)
-    return;
-
-  IDepthFrame *pDepthFrame = NULL;
-  HRESULT hr = m_pDepthFrameReader->AcquireLatestFrame(&pDepthFrame);
-
-  if (SUCCEEDED(hr)) {
-    UINT nBufferSize = 0;
-    UINT16 *pBuffer = NULL;
-    hr = pDepthFrame->AccessUnderlyingBuffer(&nBufferSize, &pBuffer);
-
-    // Observe a patient and display its report.
-    if (SUCCEEDED(hr)) {
-      m_pObserver->Observe(pBuffer);
-      ProcessDepth(pBuffer);
-    }
-  }
-
-  SafeRelease(pDepthFrame);
-}
-
-
-HRESULT DepthBasics::InitializeDefaultSensor() {
-  HRESULT hr = GetDefaultKinectSensor(&m_pKinectSensor);
-  if (FAILED(hr))
-    return hr;
-
-  if (m_pKinectSensor) {
-    // Initialize the Kinect and get the depth reader.
-    IDepthFrameSource *pDepthFrameSource = NULL;
-    hr = m_pKinectSensor->Open();
-    if (SUCCEEDED(hr))
-      hr = m_pKinectSensor->get_DepthFrameSource(&pDepthFrameSource);
-    if (SUCCEEDED(hr))
-      hr = pDepthFrameSource->OpenReader(&m_pDepthFrameReader);
-    SafeRelease(pDepthFrameSource);
-  }
-
-  if (!m_pKinectSensor || FAILED(hr)) {
-    SetStatusMessage(L"No ready Kinect found!", 10000, true);
-    return E_FAIL;
-  }
-
-  return hr;
-}
-
-void DepthBasics::ProcessDepth(const UINT16 *pBuffer) {
-  // Display information.
-  if (m_hWnd) {
-    double fps = 0.0;
-    LARGE_INTEGER qpcNow = {0};
-    if (m_fFreq && QueryPerformanceCounter(&qpcNow) && m_nLastCounter) {
-      ++m_nFramesSinceUpdate;
-      fps = m_fFreq * m_nFramesSinceUpdate /
-          static_cast<double>(qpcNow.QuadPart - m_nLastCounter);
-    }
-
-    WCHAR szStatusMessage[64];
-    StringCchPrintf(szStatusMessage, _countof(szStatusMessage),
-                    L" FPS = %0.2f", fps);
-
-    if (SetStatusMessage(szStatusMessage, 1000, false)) {
-      m_nLastCounter = qpcNow.QuadPart;
-      m_nFramesSinceUpdate = 0;
-    }
-  }
-
-  // Make sure we've received valid data.
-  if (m_pDepthRGBX && pBuffer) {
-    for (int i = 0; i < KinectOption::cDepthBufferSize; ++i) {
-      RGBQUAD *pRGBX = &m_pDepthRGBX[i];
-      USHORT depth = pBuffer[i];
-
-      // Define a color of the current pixel.
-      if (m_pObserver->IsThereSomething(i)) {
-        BYTE intensity = static_cast<BYTE>(128 + (depth / 3) % 128);
-        pRGBX->rgbRed = pRGBX->rgbGreen = intensity;
-        pRGBX->rgbBlue = intensity * 2 / 3;  // Color the pixel yellow.
-      } else {
-        BYTE intensity = static_cast<BYTE>(
-            KinectOption::IsAvailableDepth(depth) ?
-            64 + (depth % 192) : 0);
-        pRGBX->rgbRed = pRGBX->rgbGreen = pRGBX->rgbBlue = intensity;
-      }
-    }
-
-    // Draw the data with Direct2D.
-    m_pDrawDepth->Draw(reinterpret_cast<BYTE *>(m_pDepthRGBX),
-                       KinectOption::cDepthBufferSize * sizeof(RGBQUAD));
-  }
-}
-
-bool DepthBasics::SetStatusMessage(_In_z_ WCHAR *szMessage,
-                                   DWORD nShowTimeMsec, bool bForce) {
-  INT64 now = GetTickCount64();
-  bool bNeedToRefresh = bForce || m_nNextStatusTime <= now;
-  if (m_hWnd && bNeedToRefresh) {
-    // Program status.
-    SetDlgItemText(m_hWnd, IDC_STATUS, szMessage);
-
-    m_nNextStatusTime = now + nShowTimeMsec;
-
-    return true;
-  }
-  return false;
+﻿#include "depth_basics.h"
+#include <strsafe.h>
+#include "resource.h"
+#include "batch_analyzer.h"
+#include "constants.h"
+#include "depth_archive.h"
+#include "depth_colorizer.h"
+#include "depth_sequence.h"
+#include "equivalence_harness.h"
+#include "frame_bus.h"
+#include "frame_trace.h"
+#include "image_renderer.h"
+#include "observer.h"
+#include "observer_metrics.h"
+#include "parameter_sweep.h"
+#include "quality_controller.h"
+#include "self_test.h"
+#include "sensor_profile.h"
+#include "state_history.h"
+#include "stream_scheduler.h"
+#include "thread_pool.h"
+#include "trace_events.h"
+
+const int DepthBasics::cWindowWidth = 383;
+const int DepthBasics::cWindowHeight = 318;
+const int DepthBasics::cDisplayInterval = 1000 / 15;
+const int DepthBasics::cMetricsInterval = 5000;
+const char DepthBasics::cTraceDumpEventName[] = "PatientObserverDumpTrace";
+const char DepthBasics::cDiagnosticsDirectory[] = "diagnostics";
+
+/// <summary>
+/// Compare optimized configurations of Observer with the reference,
+/// run the self-tests of the parts around it
+/// and write the report to "equivalence.txt".
+/// </summary>
+/// <param name="arguments">directory of recordings to replay besides
+/// synthetic frames, or empty</param>
+/// <returns>0 if optimized results match the reference
+/// and the self-tests pass</returns>
+static int RunEquivalenceHarness(LPCWSTR arguments) {
+  while (*arguments == L' ')
+    ++arguments;
+  char directory[MAX_PATH] = "";
+  WideCharToMultiByte(CP_ACP, 0, arguments, -1, directory, MAX_PATH,
+                      NULL, NULL);
+
+  FILE *pReport;
+  if (fopen_s(&pReport, "equivalence.txt", "w") != 0)
+    return 2;
+  int numThreads = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+  ThreadPool threadPool(max(0, numThreads));
+  EquivalenceHarness harness(&threadPool);
+  bool isEquivalent = harness.RunCorpus(directory[0] ? directory : NULL,
+                                        pReport);
+  bool isCorrect = SelfTest::Run(pReport);
+  fclose(pReport);
+  return (isEquivalent && isCorrect) ? 0 : 1;
+}
+
+/// <summary>
+/// Re-analyze recordings with the current constants on every core.
+/// </summary>
+/// <param name="arguments">list of recordings, a directory of segments
+/// or a segment per line, and optionally the output directory</param>
+/// <returns>0 if the list was read</returns>
+static int RunBatchAnalyzer(LPCWSTR arguments) {
+  char argumentsA[2 * MAX_PATH] = "";
+  WideCharToMultiByte(CP_ACP, 0, arguments, -1, argumentsA,
+                      sizeof(argumentsA), NULL, NULL);
+  char listFileName[MAX_PATH] = "";
+  char outputDirectory[MAX_PATH] = "analysis";
+  if (sscanf_s(argumentsA, "%259s %259s", listFileName, MAX_PATH,
+               outputDirectory, MAX_PATH) < 1)
+    return 2;
+  CreateDirectoryA(outputDirectory, NULL);
+
+  ThreadPool threadPool(
+      max(0, static_cast<int>(std::thread::hardware_concurrency()) - 1));
+  BatchAnalyzer analyzer(&threadPool, outputDirectory);
+  if (!analyzer.AddList(listFileName))
+    return 2;
+  analyzer.Run();
+  return 0;
+}
+
+/// <summary>
+/// Compare settings of constants over recordings decoded once
+/// and write the results to "sweep.csv" in the output directory.
+/// </summary>
+/// <param name="arguments">grid of constants, the directory of segments
+/// and optionally the output directory</param>
+/// <returns>0 if the grid was read and fit "cMaxSettings"</returns>
+static int RunParameterSweep(LPCWSTR arguments) {
+  char argumentsA[3 * MAX_PATH] = "";
+  WideCharToMultiByte(CP_ACP, 0, arguments, -1, argumentsA,
+                      sizeof(argumentsA), NULL, NULL);
+  char gridFileName[MAX_PATH] = "";
+  char directory[MAX_PATH] = "";
+  char outputDirectory[MAX_PATH] = "analysis";
+  if (sscanf_s(argumentsA, "%259s %259s %259s", gridFileName, MAX_PATH,
+               directory, MAX_PATH, outputDirectory, MAX_PATH) < 2)
+    return 2;
+  CreateDirectoryA(outputDirectory, NULL);
+
+  // Constants not in the grid are the ones in use.
+  Constants base;
+  Constants::Load("constants.ini", &base);
+  ThreadPool threadPool(
+      max(0, static_cast<int>(std::thread::hardware_concurrency()) - 1));
+  ParameterSweep sweep(&threadPool);
+  if (!sweep.AddGrid(gridFileName, base))
+    return 2;
+
+  DepthArchiveCatalog catalog;
+  catalog.Scan(directory);
+  for (const std::vector<std::string> &fileNames :
+       catalog.GetFileNamesByBed()) {
+    ArchiveSequence sequence(fileNames[0].c_str(), fileNames);
+    sweep.Run(&sequence);
+  }
+
+  char resultsFileName[MAX_PATH];
+  sprintf_s(resultsFileName, "%s\\sweep.csv", outputDirectory);
+  FILE *pResults;
+  if (fopen_s(&pResults, resultsFileName, "w") != 0)
+    return 2;
+  sweep.WriteResults(pResults);
+  fclose(pResults);
+  return 0;
+}
+
+/// <summary>
+/// Replay recordings of beds as streams at 30 fps through the scheduler
+/// on every core, and write the statistics of the streams to
+/// "streams.csv" in the output directory.
+/// </summary>
+/// <param name="arguments">the directory of segments, optionally the
+/// number of streams, taking the beds again if there are more streams,
+/// and the output directory</param>
+/// <returns>0 if every stream was replayed</returns>
+static int RunStreamScheduler(LPCWSTR arguments) {
+  static const double cFrameRate = 30.0;  // [fps]
+  char argumentsA[2 * MAX_PATH + 16] = "";
+  WideCharToMultiByte(CP_ACP, 0, arguments, -1, argumentsA,
+                      sizeof(argumentsA), NULL, NULL);
+  char directory[MAX_PATH] = "";
+  int numStreams = 0;
+  char outputDirectory[MAX_PATH] = "analysis";
+  if (sscanf_s(argumentsA, "%259s %d %259s", directory, MAX_PATH,
+               &numStreams, outputDirectory, MAX_PATH) < 1)
+    return 2;
+  CreateDirectoryA(outputDirectory, NULL);
+
+  DepthArchiveCatalog catalog;
+  catalog.Scan(directory);
+  const std::vector<std::vector<std::string>> &beds =
+      catalog.GetFileNamesByBed();
+  if (beds.empty())
+    return 2;
+  if (numStreams <= 0)
+    numStreams = static_cast<int>(beds.size());
+
+  // Observers outlive the scheduler.
+  std::vector<std::unique_ptr<ArchiveSequence>> sequences;
+  std::vector<std::unique_ptr<Observer>> observers;
+  std::vector<DepthSequence *> streamSequences;
+  for (int i = 0; i < numStreams; ++i) {
+    const std::vector<std::string> &fileNames = beds[i % beds.size()];
+    char name[MAX_PATH];
+    sprintf_s(name, "%s #%d", fileNames[0].c_str(), i + 1);
+    ArchiveSequence *pSequence = new ArchiveSequence(name, fileNames);
+    sequences.emplace_back(pSequence);
+    if (!pSequence->IsOpen())
+      return 2;
+    observers.emplace_back(Observer::Create(pSequence->GetWidth(),
+                                            pSequence->GetHeight()));
+    if (!observers.back())
+      return 2;
+    streamSequences.push_back(pSequence);
+  }
+  StreamScheduler scheduler(
+      max(1, static_cast<int>(std::thread::hardware_concurrency())));
+  for (int i = 0; i < numStreams; ++i) {
+    scheduler.AddStream(sequences[i]->GetName(), observers[i].get(),
+                        StreamScheduler::cDefaultDeadline);
+  }
+  if (!scheduler.Replay(streamSequences, cFrameRate))
+    return 2;
+
+  char reportFileName[MAX_PATH];
+  sprintf_s(reportFileName, "%s\\streams.csv", outputDirectory);
+  FILE *pReport;
+  if (fopen_s(&pReport, reportFileName, "w") != 0)
+    return 2;
+  scheduler.WriteReport(pReport);
+  fclose(pReport);
+  return 0;
+}
+
+/// <summary>
+/// Entry point for the application.
+/// </summary>
+/// <param name="hInstance">handle to the application instance</param>
+/// <param name="hPrevInstance">always 0</param>
+/// <param name="lpCmdLine">command line arguments</param>
+/// <param name="nCmdShow">whether to display minimized, maximized,
+/// or normally</param>
+/// <returns>status</returns>
+int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
+                      _In_opt_ HINSTANCE hPrevInstance,
+                      _In_ LPWSTR lpCmdLine,
+                      _In_ int nShowCmd) {
+  UNREFERENCED_PARAMETER(hPrevInstance);
+
+  // Check optimizations offline, e.g. "/equivalence recordings".
+  static const WCHAR cEquivalenceSwitch[] = L"/equivalence";
+  size_t switchLength = wcslen(cEquivalenceSwitch);
+  if (wcsncmp(lpCmdLine, cEquivalenceSwitch, switchLength) == 0)
+    return RunEquivalenceHarness(lpCmdLine + switchLength);
+  // Re-analyze recordings, e.g. "/batch nights.txt analysis".
+  static const WCHAR cBatchSwitch[] = L"/batch";
+  switchLength = wcslen(cBatchSwitch);
+  if (wcsncmp(lpCmdLine, cBatchSwitch, switchLength) == 0)
+    return RunBatchAnalyzer(lpCmdLine + switchLength);
+  // Compare constants, e.g. "/sweep grid.txt recordings analysis".
+  static const WCHAR cSweepSwitch[] = L"/sweep";
+  switchLength = wcslen(cSweepSwitch);
+  if (wcsncmp(lpCmdLine, cSweepSwitch, switchLength) == 0)
+    return RunParameterSweep(lpCmdLine + switchLength);
+  // Load workers with beds, e.g. "/streams recordings 12 analysis".
+  static const WCHAR cStreamsSwitch[] = L"/streams";
+  switchLength = wcslen(cStreamsSwitch);
+  if (wcsncmp(lpCmdLine, cStreamsSwitch, switchLength) == 0)
+    return RunStreamScheduler(lpCmdLine + switchLength);
+
+  DepthBasics application;
+  application.Run(hInstance, nShowCmd);
+}
+
+DepthBasics::DepthBasics()
+    : m_hWnd(NULL),
+      m_nLastCounter(0),
+      m_nFramesSinceUpdate(0),
+      m_fFreq(0),
+      m_nNextStatusTime(0LL),
+      m_nNextDisplayTime(0LL),
+      m_nNextMetricsTime(0LL),
+      m_pKinectSensor(NULL),
+      m_pDepthFrameReader(NULL),
+      m_depthBufferWidth(KinectV2Profile::cDepthBufferWidth),
+      m_depthBufferHeight(KinectV2Profile::cDepthBufferHeight),
+      m_pD2DFactory(NULL),
+      m_pDrawDepth(NULL),
+      m_pDepthRGBX(NULL),
+      m_pDepthColorizer(NULL),
+      m_pObserver(NULL),
+      m_pThreadPool(NULL),
+      m_pConstantsWatcher(NULL),
+      m_pQualityController(NULL),
+      m_pMetrics(NULL),
+      m_nLastRelativeTime(0),
+      m_pTraceRing(NULL),
+      m_hTraceDumpEvent(NULL),
+      m_pArchiveWriter(NULL),
+      m_pFrameBusWriter(NULL),
+      m_pStateHistory(NULL) {
+  LARGE_INTEGER qpf = {0};
+  if (QueryPerformanceFrequency(&qpf))
+    m_fFreq = double(qpf.QuadPart);
+
+  // Share the other cores with the observer.
+  int numThreads = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+  m_pThreadPool = new ThreadPool(max(0, numThreads));
+
+  // Tune thresholds without restarting.
+  m_pConstantsWatcher = new ConstantsWatcher("constants.ini");
+
+  // Color depth through tables made once.
+  m_pDepthColorizer = new DepthColorizer();
+
+  // Degrade rather than let frames back up.
+  m_pQualityController = new QualityController();
+
+  // Count what the status bar can't show.
+  m_pMetrics = new ObserverMetrics();
+  CreateDirectoryA(cDiagnosticsDirectory, NULL);
+
+  // Trace frames to dump when another process signals,
+  // e.g. after a late alarm.
+  m_pTraceRing = new FrameTraceRing();
+  m_hTraceDumpEvent = CreateEventA(NULL, FALSE, FALSE, cTraceDumpEventName);
+  // Rings keep the latest events of stages for the dump too.
+  if (TraceEvents::IsEnabled())
+    TraceEvents::Start();
+}
+
+DepthBasics::~DepthBasics() {
+  // Clean up Direct2D renderer.
+  if (m_pDrawDepth) {
+    delete m_pDrawDepth;
+    m_pDrawDepth = NULL;
+  }
+
+  if (m_pDepthRGBX) {
+    delete[] m_pDepthRGBX;
+    m_pDepthRGBX = NULL;
+  }
+
+  if (m_pDepthColorizer) {
+    delete m_pDepthColorizer;
+    m_pDepthColorizer = NULL;
+  }
+
+  if (m_pArchiveWriter) {
+    delete m_pArchiveWriter;
+    m_pArchiveWriter = NULL;
+  }
+
+  if (m_pFrameBusWriter) {
+    delete m_pFrameBusWriter;
+    m_pFrameBusWriter = NULL;
+  }
+
+  if (m_pStateHistory) {
+    delete m_pStateHistory;
+    m_pStateHistory = NULL;
+  }
+
+  if (m_pObserver) {
+    delete m_pObserver;
+    m_pObserver = NULL;
+  }
+
+  if (m_pThreadPool) {
+    delete m_pThreadPool;
+    m_pThreadPool = NULL;
+  }
+
+  if (m_pConstantsWatcher) {
+    delete m_pConstantsWatcher;
+    m_pConstantsWatcher = NULL;
+  }
+
+  if (m_pQualityController) {
+    delete m_pQualityController;
+    m_pQualityController = NULL;
+  }
+
+  if (m_pMetrics) {
+    delete m_pMetrics;
+    m_pMetrics = NULL;
+  }
+
+  if (m_pTraceRing) {
+    delete m_pTraceRing;
+    m_pTraceRing = NULL;
+  }
+
+  if (m_hTraceDumpEvent) {
+    CloseHandle(m_hTraceDumpEvent);
+    m_hTraceDumpEvent = NULL;
+  }
+
+  // Clean up Direct2D.
+  SafeRelease(m_pD2DFactory);
+
+  // Done with depth frame reader.
+  SafeRelease(m_pDepthFrameReader);
+
+  // Close the Kinect Sensor.
+  if (m_pKinectSensor)
+    m_pKinectSensor->Close();
+
+  SafeRelease(m_pKinectSensor);
+}
+
+LRESULT CALLBACK DepthBasics::MessageRouter(HWND hWnd, UINT uMsg,
+                                            WPARAM wParam, LPARAM lParam) {
+  DepthBasics *pThis = NULL;
+
+  if (WM_INITDIALOG == uMsg) {
+    pThis = reinterpret_cast<DepthBasics *>(lParam);
+    SetWindowLongPtr(hWnd, GWLP_USERDATA,
+                     reinterpret_cast<LONG_PTR>(pThis));
+  } else {
+    pThis = reinterpret_cast<DepthBasics *>(
+        ::GetWindowLongPtr(hWnd, GWLP_USERDATA));
+  }
+
+  if (pThis)
+    return pThis->DlgProc(hWnd, uMsg, wParam, lParam);
+
+  return 0;
+}
+
+LRESULT CALLBACK DepthBasics::DlgProc(HWND hWnd, UINT message,
+                                      WPARAM wParam, LPARAM lParam) {
+  UNREFERENCED_PARAMETER(wParam);
+  UNREFERENCED_PARAMETER(lParam);
+
+  HRESULT hr;
+
+  switch (message) {
+  case WM_INITDIALOG:
+    // Bind application window handle.
+    m_hWnd = hWnd;
+
+    // Initialize Direct2D.
+    D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, &m_pD2DFactory);
+
+    // Get and initialize the default Kinect sensor
+    // and the observer for its depth frame.
+    InitializeDefaultSensor();
+    CreateObserver();
+
+    // Create and initialize a new Direct2D image renderer.
+    // (take a look at image_renderer.h)
+    // We'll use this to draw the data
+    // we receive from the Kinect to the screen.
+    m_pDrawDepth = new ImageRenderer(m_pObserver);
+    hr = m_pDrawDepth->Initialize(
+        GetDlgItem(m_hWnd, IDC_VIDEOVIEW),
+        m_pD2DFactory,
+        m_depthBufferWidth,
+        m_depthBufferHeight,
+        m_depthBufferWidth * sizeof(RGBQUAD));
+    if (FAILED(hr)) {
+      SetStatusMessage(L"Failed to initialize the Direct2D draw device.",
+                       10000, true);
+    }
+
+    break;
+
+  case WM_CLOSE:
+    // If the titlebar X is clicked, destroy app.
+    DestroyWindow(hWnd);
+    break;
+
+  case WM_DESTROY:
+    // Quit the main message pump.
+    PostQuitMessage(0);
+    break;
+
+  case WM_RBUTTONDOWN:
+    // Initialize the observer.
+    m_pObserver->InitializeOnlyBackgroundNext();
+    break;
+
+  case WM_RBUTTONDBLCLK:
+    // Initialize the observer.
+    m_pObserver->InitializeAllNext();
+    break;
+
+  case WM_LBUTTONDOWN:
+  case WM_LBUTTONDBLCLK:
+    // NOTE: You can get clicked coordinates with uncommenting below.
+    //// Get clicked position.
+    //int x = LOWORD(lParam);
+    //int y = HIWORD(lParam);
+
+    //// Convert DLU into px.
+    //// https://support.microsoft.com/ja-jp/kb/145994
+    //tagRECT rc = {0};
+    //rc.right = cWindowWidth * 1L;
+    //rc.bottom = cWindowHeight * 1L;
+    //MapDialogRect(hWnd, &rc);
+    //x = x * m_depthBufferWidth / rc.right;
+    //y = y * m_depthBufferHeight / rc.bottom;
+
+    //// To prevent from accessing out of memory.
+    //x = min(m_depthBufferWidth - 1, max(0, x));
+    //y = min(m_depthBufferHeight - 1, max(0, y));
+
+    break;
+  }
+
+  return false;
+}
+
+int DepthBasics::Run(HINSTANCE hInstance, int nCmdShow) {
+  MSG msg = {0};
+  WNDCLASS wc;
+
+  // Dialog custom window class.
+  ZeroMemory(&wc, sizeof(wc));
+  wc.style = CS_HREDRAW | CS_VREDRAW | CS_DBLCLKS;
+  wc.cbWndExtra = DLGWINDOWEXTRA;
+  wc.hCursor = LoadCursorW(NULL, IDC_ARROW);
+  wc.hIcon = LoadIconW(hInstance, MAKEINTRESOURCE(IDI_APP));
+  wc.lpfnWndProc = DefDlgProcW;
+  wc.lpszClassName = L"DepthBasicsAppDlgWndClass";
+
+  if (!RegisterClassW(&wc))
+    return 0;
+
+  // Create main application window.
+  HWND hWndApp = CreateDialogParamW(
+      NULL,
+      MAKEINTRESOURCE(IDD_APP),
+      NULL,
+      (DLGPROC)DepthBasics::MessageRouter,
+      reinterpret_cast<LPARAM>(this));
+
+  // Show window.
+  ShowWindow(hWndApp, nCmdShow);
+
+  // Main message loop.
+  while (WM_QUIT != msg.message) {
+    Update();
+
+    while (PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE)) {
+      // If a dialog message will be taken care of by the dialog proc.
+      if (hWndApp && IsDialogMessageW(hWndApp, &msg))
+        continue;
+
+      TranslateMessage(&msg);
+      DispatchMessageW(&msg);
+    }
+  }
+
+  return static_cast<int>(msg.wParam);
+}
+
+void DepthBasics::Update() {
+  if (!m_pDepthFrameReader)
+    return;
+
+  IDepthFrame *pDepthFrame = NULL;
+  HRESULT hr = m_pDepthFrameReader->AcquireLatestFrame(&pDepthFrame);
+  if (SUCCEEDED(hr))
+    m_pObserver->SetArrivalTime(Observer::Clock::now());
+
+  // Count frames the sensor sent but this loop never got.
+  TIMESPAN relativeTime = 0;
+  if (SUCCEEDED(hr) &&
+      SUCCEEDED(pDepthFrame->get_RelativeTime(&relativeTime))) {
+    static const TIMESPAN cFrameInterval = 10000000 / 30;  // [100 ns]
+    if (m_nLastRelativeTime) {
+      TIMESPAN numFramesPassed =
+          (relativeTime - m_nLastRelativeTime + cFrameInterval / 2) /
+          cFrameInterval;
+      if (1 < numFramesPassed) {
+        m_pMetrics->AddFrames(ObserverMetrics::eFrameDropped,
+                              static_cast<int>(numFramesPassed - 1));
+      }
+    }
+    m_nLastRelativeTime = relativeTime;
+    m_pObserver->SetFrameTime(relativeTime);
+  }
+
+  if (SUCCEEDED(hr)) {
+    UINT nBufferSize = 0;
+    UINT16 *pBuffer = NULL;
+    hr = pDepthFrame->AccessUnderlyingBuffer(&nBufferSize, &pBuffer);
+
+    // Observe a patient and display its report.
+    bool isExpectedSize = (nBufferSize ==
+        static_cast<UINT>(m_depthBufferWidth * m_depthBufferHeight));
+    if (SUCCEEDED(hr) && isExpectedSize) {
+      FILETIME now;
+      GetSystemTimeAsFileTime(&now);
+      INT64 timestamp = (static_cast<INT64>(now.dwHighDateTime) << 32) |
+                        now.dwLowDateTime;
+      // Hand the frame to the other processes first.
+      if (m_pFrameBusWriter)
+        m_pFrameBusWriter->Write(timestamp, pBuffer);
+
+      // Keep up with frames within the budget.
+      bool skipsFrame = m_pQualityController->ShouldSkipFrame();
+      Observer::Clock::time_point start = Observer::Clock::now();
+      if (skipsFrame)
+        m_pObserver->SkipFrame(pBuffer);
+      else
+        m_pObserver->Observe(pBuffer);
+      double frameCost = std::chrono::duration<double, std::milli>(
+          Observer::Clock::now() - start).count();
+      m_pQualityController->Update(frameCost, skipsFrame,
+                                   m_pObserver->GetConstants().frameBudget);
+      m_pObserver->SetQualityLevel(m_pQualityController->GetLevel());
+
+      // Only copied here, and encoded on the thread of the writer.
+      if (m_pArchiveWriter)
+        m_pArchiveWriter->Write(timestamp, pBuffer, m_pObserver);
+      if (m_pStateHistory) {
+        m_pStateHistory->Add(timestamp, m_pObserver->GetState(),
+                             m_pObserver->GetBedExitStatus());
+      }
+      ProcessDepth(pBuffer);
+    }
+  }
+
+  SafeRelease(pDepthFrame);
+
+  // Expose metrics for a scraper every few seconds.
+  INT64 now = GetTickCount64();
+  if (m_nNextMetricsTime <= now) {
+    m_nNextMetricsTime = now + cMetricsInterval;
+    char fileName[MAX_PATH];
+    sprintf_s(fileName, "%s\\metrics.prom", cDiagnosticsDirectory);
+    m_pMetrics->WriteFile(fileName);
+  }
+
+  // Dump traces on demand.
+  if (m_hTraceDumpEvent &&
+      WaitForSingleObject(m_hTraceDumpEvent, 0) == WAIT_OBJECT_0) {
+    char fileName[MAX_PATH];
+    sprintf_s(fileName, "%s\\trace.csv", cDiagnosticsDirectory);
+    m_pTraceRing->WriteFile(fileName);
+    if (TraceEvents::IsEnabled()) {
+      sprintf_s(fileName, "%s\\pipeline_trace.json", cDiagnosticsDirectory);
+      TraceEvents::WriteFile(fileName);
+    }
+  }
+}
+
+
+HRESULT DepthBasics::InitializeDefaultSensor() {
+  HRESULT hr = GetDefaultKinectSensor(&m_pKinectSensor);
+  if (FAILED(hr))
+    return hr;
+
+  if (m_pKinectSensor) {
+    // Initialize the Kinect and get the depth reader.
+    IDepthFrameSource *pDepthFrameSource = NULL;
+    hr = m_pKinectSensor->Open();
+    if (SUCCEEDED(hr))
+      hr = m_pKinectSensor->get_DepthFrameSource(&pDepthFrameSource);
+    if (SUCCEEDED(hr))
+      hr = pDepthFrameSource->OpenReader(&m_pDepthFrameReader);
+
+    // Get the size of depth frames to choose a sensor profile.
+    IFrameDescription *pFrameDescription = NULL;
+    if (SUCCEEDED(hr))
+      hr = pDepthFrameSource->get_FrameDescription(&pFrameDescription);
+    int width = 0;
+    int height = 0;
+    if (SUCCEEDED(hr))
+      hr = pFrameDescription->get_Width(&width);
+    if (SUCCEEDED(hr))
+      hr = pFrameDescription->get_Height(&height);
+    if (SUCCEEDED(hr)) {
+      m_depthBufferWidth = width;
+      m_depthBufferHeight = height;
+    }
+    SafeRelease(pFrameDescription);
+    SafeRelease(pDepthFrameSource);
+  }
+
+  if (!m_pKinectSensor || FAILED(hr)) {
+    SetStatusMessage(L"No ready Kinect found!", 10000, true);
+    return E_FAIL;
+  }
+
+  return hr;
+}
+
+void DepthBasics::CreateObserver() {
+  m_pObserver = Observer::Create(m_depthBufferWidth, m_depthBufferHeight);
+  if (!m_pObserver) {
+    SetStatusMessage(L"Unsupported depth sensor!", 10000, true);
+    m_depthBufferWidth = KinectV2Profile::cDepthBufferWidth;
+    m_depthBufferHeight = KinectV2Profile::cDepthBufferHeight;
+    m_pObserver = Observer::Create(m_depthBufferWidth, m_depthBufferHeight);
+  }
+  m_pObserver->SetKernelMode(Observer::eKernelFused);
+  m_pObserver->SetThreadPool(m_pThreadPool);
+  m_pObserver->SetConstantsWatcher(m_pConstantsWatcher);
+  m_pObserver->SetMetrics(m_pMetrics);
+  m_pObserver->SetTraceRing(m_pTraceRing);
+
+  // Create heap storage for depth pixel data in RGBX format.
+  m_pDepthRGBX = new RGBQUAD[m_depthBufferWidth * m_depthBufferHeight];
+
+  // Record frames named after this computer, which watches a bed,
+  // only if the directory for recordings exists.
+  static const char cRecordingDirectory[] = "recordings";
+  DWORD attributes = GetFileAttributesA(cRecordingDirectory);
+  bool isDirectory = attributes != INVALID_FILE_ATTRIBUTES &&
+                     (attributes & FILE_ATTRIBUTE_DIRECTORY);
+  char bedName[MAX_COMPUTERNAME_LENGTH + 1] = "bed";
+  DWORD bedNameLength = _countof(bedName);
+  GetComputerNameA(bedName, &bedNameLength);
+  if (isDirectory) {
+    m_pArchiveWriter = new DepthArchiveWriter(
+        cRecordingDirectory, bedName, m_depthBufferWidth, m_depthBufferHeight);
+  }
+
+  // Keep weeks of states for the staff in the same way.
+  static const char cHistoryDirectory[] = "history";
+  attributes = GetFileAttributesA(cHistoryDirectory);
+  isDirectory = attributes != INVALID_FILE_ATTRIBUTES &&
+                (attributes & FILE_ATTRIBUTE_DIRECTORY);
+  if (isDirectory)
+    m_pStateHistory = new StateHistory(cHistoryDirectory, bedName);
+
+  // Publish frames for a recorder or a viewer in another process,
+  // unless another instance does already.
+  static const char cFrameBusName[] = "PatientObserverDepthFrames";
+  static const int cNumFrameBusSlots = 8;
+  m_pFrameBusWriter = new FrameBusWriter();
+  if (!m_pFrameBusWriter->Create(cFrameBusName, m_depthBufferWidth,
+                                 m_depthBufferHeight, cNumFrameBusSlots)) {
+    delete m_pFrameBusWriter;
+    m_pFrameBusWriter = NULL;
+  }
+}
+
+void DepthBasics::ProcessDepth(const UINT16 *pBuffer) {
+  // Display information.
+  if (m_hWnd) {
+    double fps = 0.0;
+    LARGE_INTEGER qpcNow = {0};
+    if (m_fFreq && QueryPerformanceCounter(&qpcNow) && m_nLastCounter) {
+      ++m_nFramesSinceUpdate;
+      fps = m_fFreq * m_nFramesSinceUpdate /
+          static_cast<double>(qpcNow.QuadPart - m_nLastCounter);
+    }
+
+    const Observer::BedExitStatistics &bedExit =
+        m_pObserver->GetBedExitStatistics();
+    WCHAR szStatusMessage[160];
+    StringCchPrintf(szStatusMessage, _countof(szStatusMessage),
+                    L" FPS = %0.2f, %0.2f MB/frame, alarm %0.2f ms (max %0.2f),"
+                    L" quality %d (%0.1f ms)",
+                    fps, m_pObserver->GetBytesTouched() / 1e6,
+                    bedExit.lastTimeToAlarm, bedExit.maxTimeToAlarm,
+                    m_pQualityController->GetLevel(),
+                    m_pQualityController->GetAverageCost());
+
+    if (SetStatusMessage(szStatusMessage, 1000, false)) {
+      m_nLastCounter = qpcNow.QuadPart;
+      m_nFramesSinceUpdate = 0;
+    }
+  }
+
+  // Display frames at their own rate,
+  // and not at all while nobody can see them.
+  INT64 now = GetTickCount64();
+  bool isVisible = m_hWnd && IsWindowVisible(m_hWnd) && !IsIconic(m_hWnd);
+  if (!isVisible || now < m_nNextDisplayTime)
+    return;
+  m_nNextDisplayTime = now + cDisplayInterval;
+
+  // Make sure we've received valid data.
+  if (m_pDepthRGBX && pBuffer) {
+    int depthBufferSize = m_depthBufferWidth * m_depthBufferHeight;
+    m_pDepthColorizer->Colorize(pBuffer, m_pObserver->GetDifference(),
+                                depthBufferSize, m_pDepthRGBX);
+
+    // Draw the data with Direct2D.
+    m_pDrawDepth->Draw(reinterpret_cast<BYTE *>(m_pDepthRGBX),
+                       depthBufferSize * sizeof(RGBQUAD));
+  }
+}
+
+bool DepthBasics::SetStatusMessage(_In_z_ WCHAR *szMessage,
+                                   DWORD nShowTimeMsec, bool bForce) {
+  INT64 now = GetTickCount64();
+  bool bNeedToRefresh = bForce || m_nNextStatusTime <= now;
+  if (m_hWnd && bNeedToRefresh) {
+    // Program status.
+    SetDlgItemText(m_hWnd, IDC_STATUS, szMessage);
+
+    m_nNextStatusTime = now + nShowTimeMsec;
+
+    return true;
+  }
+  return false;
 }
\ No newline at end of file
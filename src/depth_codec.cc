@@ -0,0 +1,344 @@
+﻿#include "depth_codec.h"
+#include <emmintrin.h>  // SSE2
+#include <string.h>     // memcpy(), memset()
+
+// To recognize an encoded frame, "DPC1".
+static const UINT32 cSignature = 0x31435044;
+// A Rice code whose unary part would be longer is written as it is.
+static const int cMaxQuotient = 32;
+static const int cMaxRiceParameter = 24;
+
+/// <summary>
+/// Parameter of Rice codes adapted to the mean of recent values.
+/// http://www.hpl.hp.com/research/info_theory/loco/HPL-98-193R1.pdf
+/// </summary>
+class RiceContext {
+public:
+  RiceContext() : m_sum(4), m_count(1), m_parameter(2) {}
+
+  int GetParameter() const { return m_parameter; }
+  void Update(UINT32 value) {
+    // Halve the history to follow changes of statistics.
+    static const UINT32 cResetCount = 64;
+    m_sum += value;
+    if (++m_count == cResetCount) {
+      m_sum >>= 1;
+      m_count >>= 1;
+    }
+
+    // The smallest k where the mean is at most 2^k.
+    int k = 0;
+    while ((m_count << k) < m_sum && k < cMaxRiceParameter)
+      ++k;
+    m_parameter = k;
+  }
+
+private:
+  UINT32 m_sum;
+  UINT32 m_count;
+  int m_parameter;
+};
+
+class BitWriter {
+public:
+  explicit BitWriter(std::vector<BYTE> *pOutput)
+      : m_pOutput(pOutput), m_buffer(0), m_numBits(0) {}
+
+  void Write(UINT32 value, int numBits) {
+    m_buffer |= static_cast<UINT64>(value) << m_numBits;
+    m_numBits += numBits;
+    while (8 <= m_numBits) {
+      m_pOutput->push_back(static_cast<BYTE>(m_buffer));
+      m_buffer >>= 8;
+      m_numBits -= 8;
+    }
+  }
+  void WriteRice(UINT32 value, RiceContext *pContext) {
+    int k = pContext->GetParameter();
+    UINT32 quotient = value >> k;
+    if (quotient < cMaxQuotient) {
+      // Ones of the quotient terminated by a zero.
+      Write((1U << quotient) - 1, quotient + 1);
+      Write(value & ((1U << k) - 1), k);
+    } else {
+      Write(0xFFFFFFFF, cMaxQuotient);
+      Write(value, 32);
+    }
+    pContext->Update(value);
+  }
+  void Flush() {
+    if (0 < m_numBits)
+      Write(0, 8 - m_numBits);
+  }
+
+private:
+  std::vector<BYTE> *m_pOutput;
+  UINT64 m_buffer;
+  int m_numBits;
+};
+
+class BitReader {
+public:
+  BitReader(const BYTE *pData, size_t size)
+      : m_pData(pData),
+        m_size(size),
+        m_position(0),
+        m_buffer(0),
+        m_numBits(0),
+        m_isOverrun(false) {}
+
+  UINT32 Read(int numBits) {
+    if (m_numBits < numBits)
+      Refill();
+    if (m_numBits < numBits) {
+      // Read zeros beyond the end.
+      m_isOverrun = true;
+      m_numBits = numBits;
+    }
+    UINT32 value = static_cast<UINT32>(m_buffer & ((1ULL << numBits) - 1));
+    m_buffer >>= numBits;
+    m_numBits -= numBits;
+    return value;
+  }
+  UINT32 ReadRice(RiceContext *pContext) {
+    // A code except the escaped value fits in the buffer after refilling,
+    // so count the unary part directly on it.
+    static const int cMaxCodeBits = cMaxQuotient + 1 + cMaxRiceParameter;
+    if (m_numBits < cMaxCodeBits)
+      Refill();
+    int k = pContext->GetParameter();
+    int quotient = 0;
+    while (quotient < cMaxQuotient && ((m_buffer >> quotient) & 1))
+      ++quotient;
+
+    UINT32 value;
+    if (quotient < cMaxQuotient) {
+      int numBits = quotient + 1 + k;
+      value = (quotient << k) |
+          static_cast<UINT32>((m_buffer >> (quotient + 1)) & ((1U << k) - 1));
+      Skip(numBits);
+    } else {
+      Skip(cMaxQuotient);
+      value = Read(32);
+    }
+    pContext->Update(value);
+    return value;
+  }
+  bool IsOverrun() const { return m_isOverrun; }
+
+private:
+  void Skip(int numBits) {
+    if (m_numBits < numBits) {
+      m_isOverrun = true;
+      m_numBits = numBits;
+    }
+    m_buffer >>= numBits;
+    m_numBits -= numBits;
+  }
+  void Refill() {
+    while (m_numBits <= 56 && m_position < m_size) {
+      m_buffer |= static_cast<UINT64>(m_pData[m_position++]) << m_numBits;
+      m_numBits += 8;
+    }
+  }
+
+  const BYTE *m_pData;
+  size_t m_size;
+  size_t m_position;
+  UINT64 m_buffer;
+  int m_numBits;
+  bool m_isOverrun;
+};
+
+// Residuals are differences modulo 2^16, which keeps them in 16 bits,
+// mapped to unsigned values as 0, -1, 1, -2, 2, ...
+static UINT16 ZigZag(UINT16 residual) {
+  return static_cast<UINT16>((residual << 1) ^
+                             (static_cast<INT16>(residual) >> 15));
+}
+
+static UINT16 UnZigZag(UINT16 code) {
+  return static_cast<UINT16>((code >> 1) ^ (0 - (code & 1)));
+}
+
+static void CalculateResiduals(const UINT16 *pFrame,
+                               const UINT16 *pPrediction, int size,
+                               UINT16 *pResiduals) {
+  int i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m128i frame = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(&pFrame[i]));
+    __m128i prediction = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(&pPrediction[i]));
+    __m128i residual = _mm_sub_epi16(frame, prediction);
+    __m128i code = _mm_xor_si128(_mm_slli_epi16(residual, 1),
+                                 _mm_srai_epi16(residual, 15));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&pResiduals[i]), code);
+  }
+  for (; i < size; ++i)
+    pResiduals[i] = ZigZag(static_cast<UINT16>(pFrame[i] - pPrediction[i]));
+}
+
+static void Reconstruct(const UINT16 *pPrediction, const UINT16 *pResiduals,
+                        int size, UINT16 *pFrame) {
+  const __m128i cOne = _mm_set1_epi16(1);
+  int i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m128i code = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(&pResiduals[i]));
+    __m128i prediction = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(&pPrediction[i]));
+    __m128i sign = _mm_sub_epi16(_mm_setzero_si128(),
+                                 _mm_and_si128(code, cOne));
+    __m128i residual = _mm_xor_si128(_mm_srli_epi16(code, 1), sign);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&pFrame[i]),
+                     _mm_add_epi16(prediction, residual));
+  }
+  for (; i < size; ++i)
+    pFrame[i] = static_cast<UINT16>(pPrediction[i] + UnZigZag(pResiduals[i]));
+}
+
+static void EncodeResiduals(const UINT16 *pResiduals, int size,
+                            std::vector<BYTE> *pOutput) {
+  // Code each non-zero residual after the run of zeros before it.
+  BitWriter writer(pOutput);
+  RiceContext runContext, valueContext;
+  UINT32 run = 0;
+  for (int i = 0; i < size; ++i) {
+    if (pResiduals[i] == 0) {
+      ++run;
+      continue;
+    }
+    writer.WriteRice(run, &runContext);
+    writer.WriteRice(pResiduals[i] - 1U, &valueContext);
+    run = 0;
+  }
+  if (0 < run)
+    writer.WriteRice(run, &runContext);
+  writer.Flush();
+}
+
+static bool DecodeResiduals(const BYTE *pData, size_t size, int numResiduals,
+                            UINT16 *pResiduals) {
+  BitReader reader(pData, size);
+  RiceContext runContext, valueContext;
+  int i = 0;
+  while (i < numResiduals) {
+    UINT32 run = reader.ReadRice(&runContext);
+    if (static_cast<UINT32>(numResiduals - i) < run)
+      return false;
+    memset(&pResiduals[i], 0, run * sizeof(UINT16));
+    i += run;
+    if (i == numResiduals)
+      break;
+
+    UINT32 value = reader.ReadRice(&valueContext) + 1;
+    if (0xFFFF < value || reader.IsOverrun())
+      return false;
+    pResiduals[i++] = static_cast<UINT16>(value);
+  }
+  return !reader.IsOverrun();
+}
+
+DepthEncoder::DepthEncoder(int width, int height, int framesPerChunk)
+    : m_width(width),
+      m_height(height),
+      m_framesPerChunk(max(1, framesPerChunk)),
+      m_numFramesInChunk(0),
+      m_previous(width * height),
+      m_residuals(width * height) {
+}
+
+void DepthEncoder::Encode(const UINT16 *pFrame, const UINT16 *pReference,
+                          std::vector<BYTE> *pOutput) {
+  int size = m_width * m_height;
+  DepthFrameHeader header = {};
+  header.signature = cSignature;
+  header.width = static_cast<UINT16>(m_width);
+  header.height = static_cast<UINT16>(m_height);
+
+  if (!IsNextKeyFrame()) {
+    header.type = DepthFrameHeader::eDeltaFrame;
+    CalculateResiduals(pFrame, m_previous.data(), size, m_residuals.data());
+  } else if (pReference) {
+    header.type = DepthFrameHeader::eReferenceKeyFrame;
+    CalculateResiduals(pFrame, pReference, size, m_residuals.data());
+  } else {
+    header.type = DepthFrameHeader::eIntraKeyFrame;
+    for (int x = 0; x < m_width; ++x)
+      m_residuals[x] = ZigZag(pFrame[x]);
+    CalculateResiduals(&pFrame[m_width], pFrame, size - m_width,
+                       &m_residuals[m_width]);
+  }
+
+  // Write the header after the payload to know its size.
+  size_t headerPosition = pOutput->size();
+  pOutput->resize(headerPosition + sizeof(header));
+  EncodeResiduals(m_residuals.data(), size, pOutput);
+  header.payloadBytes = static_cast<UINT32>(
+      pOutput->size() - headerPosition - sizeof(header));
+  memcpy(&(*pOutput)[headerPosition], &header, sizeof(header));
+
+  memcpy(m_previous.data(), pFrame, size * sizeof(UINT16));
+  m_numFramesInChunk = (m_numFramesInChunk + 1) % m_framesPerChunk;
+}
+
+DepthDecoder::DepthDecoder(int width, int height)
+    : m_width(width),
+      m_height(height),
+      m_hasPrevious(false),
+      m_previous(width * height),
+      m_residuals(width * height) {
+}
+
+bool DepthDecoder::ReadHeader(const BYTE *pData, size_t size,
+                              DepthFrameHeader *pHeader) {
+  if (size < sizeof(*pHeader))
+    return false;
+  memcpy(pHeader, pData, sizeof(*pHeader));
+  return pHeader->signature == cSignature &&
+         pHeader->type <= DepthFrameHeader::eDeltaFrame &&
+         pHeader->payloadBytes <= size - sizeof(*pHeader);
+}
+
+bool DepthDecoder::Decode(const BYTE *pData, size_t size,
+                          const UINT16 *pReference, UINT16 *pFrame) {
+  DepthFrameHeader header = {};
+  bool isDecodable = ReadHeader(pData, size, &header) &&
+                     header.width == m_width && header.height == m_height;
+  if (header.type == DepthFrameHeader::eDeltaFrame)
+    isDecodable = isDecodable && m_hasPrevious;
+  if (header.type == DepthFrameHeader::eReferenceKeyFrame)
+    isDecodable = isDecodable && pReference;
+
+  int numPixels = m_width * m_height;
+  if (isDecodable) {
+    isDecodable = DecodeResiduals(&pData[sizeof(header)], header.payloadBytes,
+                                  numPixels, m_residuals.data());
+  }
+
+  // A broken frame breaks the chain of delta frames too.
+  m_hasPrevious = isDecodable;
+  if (!isDecodable)
+    return false;
+
+  switch (header.type) {
+    case DepthFrameHeader::eIntraKeyFrame:
+      for (int x = 0; x < m_width; ++x)
+        pFrame[x] = UnZigZag(m_residuals[x]);
+      for (int y = 1; y < m_height; ++y) {
+        Reconstruct(&pFrame[(y - 1) * m_width], &m_residuals[y * m_width],
+                    m_width, &pFrame[y * m_width]);
+      }
+      break;
+    case DepthFrameHeader::eReferenceKeyFrame:
+      Reconstruct(pReference, m_residuals.data(), numPixels, pFrame);
+      break;
+    case DepthFrameHeader::eDeltaFrame:
+      Reconstruct(m_previous.data(), m_residuals.data(), numPixels,
+                  pFrame);
+      break;
+  }
+  memcpy(m_previous.data(), pFrame, numPixels * sizeof(UINT16));
+  return true;
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_DEPTH_CODEC_H_
+#define KINECT_PATIENTS_OBSERVER_DEPTH_CODEC_H_
+
+#include <vector>
+
+// Lossless codec for streams of depth frames.
+// A frame is predicted from the previous frame, or from a reference frame
+// such as the background of Observer at the start of a chunk.
+// Residuals are mostly zero, so they are coded as runs of zeros and
+// adaptive Rice codes of the rest.
+// A chunk starts with a key frame and can be decoded without the others.
+
+/// <summary>
+/// Header in front of every encoded frame.
+/// </summary>
+struct DepthFrameHeader {
+  enum FrameType {
+    eIntraKeyFrame,      // Predicted from the row above.
+    eReferenceKeyFrame,  // Predicted from a reference frame.
+    eDeltaFrame,         // Predicted from the previous frame.
+  };
+
+  bool IsKeyFrame() const { return type != eDeltaFrame; }
+
+  UINT32 signature;
+  UINT16 width;         // [px]
+  UINT16 height;        // [px]
+  UINT32 payloadBytes;  // Following the header.
+  BYTE type;            // FrameType.
+  BYTE reserved[3];
+};
+
+class DepthEncoder {
+public:
+  /// <summary>
+  /// Prepare to encode a stream.
+  /// </summary>
+  /// <param name="width">width of frames</param>
+  /// <param name="height">height of frames</param>
+  /// <param name="framesPerChunk">interval of key frames</param>
+  DepthEncoder(int width, int height, int framesPerChunk);
+
+  /// <summary>
+  /// Encode a frame and append it to the output.
+  /// </summary>
+  /// <param name="pFrame">frame to encode</param>
+  /// <param name="pReference">frame to predict a key frame from,
+  /// which the decoder must be given too, or NULL</param>
+  /// <param name="pOutput">encoded stream</param>
+  void Encode(const UINT16 *pFrame, const UINT16 *pReference,
+              std::vector<BYTE> *pOutput);
+  /// <summary>
+  /// Start a new chunk from the next frame.
+  /// </summary>
+  void StartChunk() { m_numFramesInChunk = 0; }
+  bool IsNextKeyFrame() const { return m_numFramesInChunk == 0; }
+
+private:
+  int m_width;   // [px]
+  int m_height;  // [px]
+  int m_framesPerChunk;
+  int m_numFramesInChunk;
+  std::vector<UINT16> m_previous;
+  std::vector<UINT16> m_residuals;
+};
+
+class DepthDecoder {
+public:
+  DepthDecoder(int width, int height);
+
+  /// <summary>
+  /// Read the header of an encoded frame.
+  /// </summary>
+  /// <param name="pData">encoded frame</param>
+  /// <param name="size">available bytes</param>
+  /// <param name="pHeader">read header</param>
+  /// <returns>whether the whole frame is available</returns>
+  static bool ReadHeader(const BYTE *pData, size_t size,
+                         DepthFrameHeader *pHeader);
+
+  /// <summary>
+  /// Decode a frame.
+  /// A delta frame needs the previous frame of the chunk decoded before.
+  /// </summary>
+  /// <param name="pData">encoded frame</param>
+  /// <param name="size">available bytes</param>
+  /// <param name="pReference">frame given to the encoder for
+  /// the key frame of the chunk, or NULL</param>
+  /// <param name="pFrame">decoded frame</param>
+  /// <returns>whether the frame was decoded</returns>
+  bool Decode(const BYTE *pData, size_t size, const UINT16 *pReference,
+              UINT16 *pFrame);
+
+private:
+  int m_width;   // [px]
+  int m_height;  // [px]
+  bool m_hasPrevious;
+  std::vector<UINT16> m_previous;
+  std::vector<UINT16> m_residuals;
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_DEPTH_CODEC_H_
\ No newline at end of file
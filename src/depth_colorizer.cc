@@ -0,0 +1,67 @@
+﻿#include "depth_colorizer.h"
+#include <emmintrin.h>  // SSE2
+
+static const int cNumDepths = 1 << 16;
+
+static UINT32 PackColor(BYTE red, BYTE green, BYTE blue) {
+  // Same layout as RGBQUAD.
+  return (static_cast<UINT32>(red) << 16) |
+         (static_cast<UINT32>(green) << 8) | blue;
+}
+
+DepthColorizer::DepthColorizer()
+    : m_backgroundColors(cNumDepths),
+      m_foregroundColors(cNumDepths) {
+  for (int depth = 0; depth < cNumDepths; ++depth) {
+    BYTE intensity = static_cast<BYTE>(
+        (0 < depth) ?
+        64 + (depth % 192) : 0);
+    m_backgroundColors[depth] = PackColor(intensity, intensity, intensity);
+
+    // Color the pixel yellow.
+    intensity = static_cast<BYTE>(128 + (depth / 3) % 128);
+    m_foregroundColors[depth] = PackColor(intensity, intensity,
+                                          intensity * 2 / 3);
+  }
+}
+
+void DepthColorizer::Colorize(const UINT16 *pDepth,
+                              const UINT16 *pDifference, int size,
+                              RGBQUAD *pImage) const {
+  const UINT32 *pBackground = m_backgroundColors.data();
+  const UINT32 *pForeground = m_foregroundColors.data();
+  UINT32 *pColors = reinterpret_cast<UINT32 *>(pImage);
+  if (!pDifference) {
+    for (int i = 0; i < size; ++i)
+      pColors[i] = pBackground[pDepth[i]];
+    return;
+  }
+
+  // Blend 8 pixels at once with masks of the differences.
+  int i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m128i difference = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(&pDifference[i]));
+    __m128i isBackground = _mm_cmpeq_epi16(difference,
+                                           _mm_setzero_si128());
+    for (int half = 0; half < 2; ++half) {
+      const UINT16 *pHalf = &pDepth[i + 4 * half];
+      __m128i background = _mm_setr_epi32(
+          pBackground[pHalf[0]], pBackground[pHalf[1]],
+          pBackground[pHalf[2]], pBackground[pHalf[3]]);
+      __m128i foreground = _mm_setr_epi32(
+          pForeground[pHalf[0]], pForeground[pHalf[1]],
+          pForeground[pHalf[2]], pForeground[pHalf[3]]);
+      __m128i mask = (half == 0) ?
+          _mm_unpacklo_epi16(isBackground, isBackground) :
+          _mm_unpackhi_epi16(isBackground, isBackground);
+      __m128i color = _mm_or_si128(_mm_and_si128(mask, background),
+                                   _mm_andnot_si128(mask, foreground));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(&pColors[i + 4 * half]),
+                       color);
+    }
+  }
+  for (; i < size; ++i)
+    pColors[i] = (0 < pDifference[i]) ? pForeground[pDepth[i]] :
+                                        pBackground[pDepth[i]];
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_DEPTH_COLORIZER_H_
+#define KINECT_PATIENTS_OBSERVER_DEPTH_COLORIZER_H_
+
+#include <vector>
+
+/// <summary>
+/// Colors depth frames for display through tables of every depth,
+/// so a pixel costs two lookups and a blend.
+/// Pixels where something is found are yellow, the others are gray.
+/// </summary>
+class DepthColorizer {
+public:
+  DepthColorizer();
+
+  /// <summary>
+  /// Color a frame.
+  /// </summary>
+  /// <param name="pDepth">depth frame</param>
+  /// <param name="pDifference">differences from the background,
+  /// nonzero where something is found, or NULL</param>
+  /// <param name="size">number of pixels</param>
+  /// <param name="pImage">colored frame</param>
+  void Colorize(const UINT16 *pDepth, const UINT16 *pDifference, int size,
+                RGBQUAD *pImage) const;
+
+private:
+  // Colors as RGBQUAD in 32 bits, indexed by depth.
+  std::vector<UINT32> m_backgroundColors;
+  std::vector<UINT32> m_foregroundColors;
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_DEPTH_COLORIZER_H_
\ No newline at end of file
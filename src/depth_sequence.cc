@@ -0,0 +1,257 @@
+﻿#include "depth_sequence.h"
+#include <stdio.h>  // sprintf_s()
+#include <algorithm>
+#include "observer.h"
+
+ArchiveSequence::ArchiveSequence(const char *fileName)
+    : m_name(fileName),
+      m_fileNames(1, fileName),
+      m_segment(0),
+      m_width(0),
+      m_height(0),
+      m_isSegmentOpen(false),
+      m_isOpen(false),
+      m_isFirstFrameRead(false),
+      m_numFramesRead(0),
+      m_timestamp(0) {
+  m_isOpen = OpenSegment(0);
+}
+
+ArchiveSequence::ArchiveSequence(const char *name,
+                                 const std::vector<std::string> &fileNames)
+    : m_name(name),
+      m_fileNames(fileNames),
+      m_segment(0),
+      m_width(0),
+      m_height(0),
+      m_isSegmentOpen(false),
+      m_isOpen(false),
+      m_isFirstFrameRead(false),
+      m_numFramesRead(0),
+      m_timestamp(0) {
+  m_isOpen = OpenSegment(0);
+}
+
+bool ArchiveSequence::Rewind() {
+  m_isFirstFrameRead = false;
+  m_numFramesRead = 0;
+  return m_isOpen && OpenSegment(0);
+}
+
+bool ArchiveSequence::ReadFrame(UINT16 *pFrame) {
+  if (!m_isOpen)
+    return false;
+
+
+  // Go on to the next segment at the end of one, skipping broken ones.
+  // Frames of a different size can't go on with the same observer.
+  while (true) {
+    bool isSameSize = m_reader.GetWidth() == m_width &&
+                      m_reader.GetHeight() == m_height;
+    if (m_isSegmentOpen && isSameSize &&
+        m_reader.ReadFrame(&m_timestamp, pFrame))
+      break;
+    if (m_fileNames.size() <= m_segment + 1)
+      return false;
+    OpenSegment(m_segment + 1);
+  }
+
+  // The first frame is the key frame holding the recorded state.
+  m_isFirstFrameRead = (m_numFramesRead == 0);
+  ++m_numFramesRead;
+  return true;
+}
+
+void ArchiveSequence::PrepareObserver(Observer *pObserver) const {
+  // Start from the recorded background and bed,
+  // or from the first frame if they were not recorded.
+  if (m_isFirstFrameRead)
+    m_reader.WarmStart(pObserver);
+}
+
+bool ArchiveSequence::OpenSegment(size_t segment) {
+  m_segment = segment;
+  m_isSegmentOpen = segment < m_fileNames.size() &&
+                    m_reader.Open(m_fileNames[segment].c_str()) &&
+                    m_reader.Seek(m_reader.GetStartTime());
+
+  // Frames of the whole sequence are as large as the first ones.
+  if (segment == 0 && m_isSegmentOpen) {
+    m_width = m_reader.GetWidth();
+    m_height = m_reader.GetHeight();
+  }
+  return m_isSegmentOpen;
+}
+
+// Scene in fractions of a frame.
+static const double cBedLeft = 0.27;
+static const double cBedTop = 0.28;
+static const double cBedRight = 0.74;
+static const double cBedBottom = 0.78;
+static const int cFloorDepth = 3000;  // [mm] At the center.
+static const int cBedHeight = 700;    // [mm]
+static const double cHeadRadius = 0.045;
+
+/// <summary>
+/// Posture of the patient at a time of the sequence.
+/// </summary>
+struct Pose {
+  double time;
+  double headX;
+  double headY;
+  int headHeight;  // [mm] Above the bed or the floor under the head.
+  int bodyHeight;  // [mm]
+  double bodyLength;
+};
+
+static const Pose cPoses[] = {
+    {0.05, 0.32, 0.53, 200, 150, 0.35},   // Lying.
+    {0.30, 0.32, 0.53, 200, 150, 0.35},
+    {0.38, 0.40, 0.53, 650, 250, 0.20},   // Sitting.
+    {0.48, 0.40, 0.53, 650, 250, 0.20},
+    {0.55, 0.45, 0.30, 650, 250, 0.10},   // Sitting on the edge.
+    {0.62, 0.45, 0.30, 650, 250, 0.10},
+    {0.70, 0.45, 0.15, 1600, 1200, 0.08},  // Standing beside the bed.
+    {0.80, 0.45, 0.15, 1600, 1200, 0.08},
+    {0.88, 0.32, 0.53, 200, 150, 0.35},   // Lying again.
+    {1.00, 0.32, 0.53, 200, 150, 0.35},
+};
+
+SyntheticSequence::SyntheticSequence(int width, int height, int numFrames,
+                                     unsigned seed)
+    : m_width(width),
+      m_height(height),
+      m_numFrames(numFrames),
+      m_seed(seed),
+      m_isMirrored(false),
+      m_depthOffset(0),
+      m_frame(0) {
+  UpdateName();
+}
+
+void SyntheticSequence::SetMirrored(bool isMirrored) {
+  m_isMirrored = isMirrored;
+  UpdateName();
+}
+
+void SyntheticSequence::SetDepthOffset(int depthOffset) {
+  m_depthOffset = depthOffset;
+  UpdateName();
+}
+
+bool SyntheticSequence::Rewind() {
+  m_frame = 0;
+  return 0 < m_numFrames;
+}
+
+bool SyntheticSequence::ReadFrame(UINT16 *pFrame) {
+  // The observer finds the bed around the center by itself.
+  if (m_numFrames <= m_frame)
+    return false;
+
+  DrawRoom(pFrame);
+  DrawPatient(pFrame);
+
+  // Lose depth here and there.
+  unsigned random = (m_seed + m_frame) * 2654435761u;
+  for (int i = 0; i < m_width * m_height; ++i) {
+    random = random * 1103515245u + 12345u;
+    if (((random >> 16) & 63) == 0)
+      pFrame[i] = 0;
+  }
+
+  if (m_isMirrored) {
+    for (int y = 0; y < m_height; ++y)
+      std::reverse(&pFrame[y * m_width], &pFrame[(y + 1) * m_width]);
+  }
+  if (m_depthOffset) {
+    for (int i = 0; i < m_width * m_height; ++i) {
+      if (pFrame[i])
+        pFrame[i] = static_cast<UINT16>(pFrame[i] + m_depthOffset);
+    }
+  }
+
+  ++m_frame;
+  return true;
+}
+
+void SyntheticSequence::UpdateName() {
+  char offset[16] = "";
+  if (m_depthOffset)
+    sprintf_s(offset, " +%dmm", m_depthOffset);
+  sprintf_s(m_name, "synthetic %dx%d #%u%s%s", m_width, m_height, m_seed,
+            m_isMirrored ? " mirrored" : "", offset);
+}
+
+void SyntheticSequence::DrawRoom(UINT16 *pFrame) const {
+  int bedLeft = static_cast<int>(cBedLeft * m_width);
+  int bedTop = static_cast<int>(cBedTop * m_height);
+  int bedRight = static_cast<int>(cBedRight * m_width);
+  int bedBottom = static_cast<int>(cBedBottom * m_height);
+  for (int y = 0; y < m_height; ++y) {
+    // The floor goes away toward the bottom of frames.
+    int floorDepth = cFloorDepth + (y - m_height / 2) * 424 / m_height;
+    for (int x = 0; x < m_width; ++x) {
+      bool isBed = bedLeft <= x && x < bedRight &&
+                   bedTop <= y && y < bedBottom;
+      pFrame[x + y * m_width] = static_cast<UINT16>(isBed ?
+          cFloorDepth - cBedHeight + (y - bedTop) / 3 : floorDepth);
+    }
+  }
+}
+
+void SyntheticSequence::DrawPatient(UINT16 *pFrame) const {
+  double time = 1.0 * m_frame / m_numFrames;
+  if (time < cPoses[0].time)
+    return;
+
+  // Move between poses.
+  Pose pose = cPoses[0];
+  for (size_t i = 1; i < sizeof(cPoses) / sizeof(cPoses[0]); ++i) {
+    const Pose &previous = cPoses[i - 1];
+    const Pose &next = cPoses[i];
+    if (time < previous.time || next.time < time)
+      continue;
+    double ratio = (time - previous.time) / (next.time - previous.time);
+    pose.headX = previous.headX + (next.headX - previous.headX) * ratio;
+    pose.headY = previous.headY + (next.headY - previous.headY) * ratio;
+    pose.headHeight = static_cast<int>(previous.headHeight +
+        (next.headHeight - previous.headHeight) * ratio);
+    pose.bodyHeight = static_cast<int>(previous.bodyHeight +
+        (next.bodyHeight - previous.bodyHeight) * ratio);
+    pose.bodyLength = previous.bodyLength +
+        (next.bodyLength - previous.bodyLength) * ratio;
+    break;
+  }
+
+  int headX = static_cast<int>(pose.headX * m_width);
+  int headY = static_cast<int>(pose.headY * m_height);
+  int headRadius = static_cast<int>(cHeadRadius * m_width);
+  int bodyWidth = static_cast<int>(0.08 * m_height);
+  DrawBox(pFrame, headX + headRadius, headY - bodyWidth,
+          headX + static_cast<int>(pose.bodyLength * m_width),
+          headY + bodyWidth, pose.bodyHeight, false);
+  DrawBox(pFrame, headX - headRadius, headY - headRadius,
+          headX + headRadius, headY + headRadius, pose.headHeight, true);
+}
+
+void SyntheticSequence::DrawBox(UINT16 *pFrame, int xBegin, int yBegin,
+                                int xEnd, int yEnd, int height,
+                                bool isRound) const {
+  int centerX = (xBegin + xEnd) / 2;
+  int centerY = (yBegin + yEnd) / 2;
+  int radius = (xEnd - xBegin) / 2;
+  for (int y = max(0, yBegin); y < min(m_height, yEnd); ++y) {
+    for (int x = max(0, xBegin); x < min(m_width, xEnd); ++x) {
+      int dx = x - centerX;
+      int dy = y - centerY;
+      if (isRound && radius * radius < dx * dx + dy * dy)
+        continue;
+
+      // Rounder toward the center like a body.
+      UINT16 &depth = pFrame[x + y * m_width];
+      int bulge = isRound ? 0 : (yEnd - yBegin) / 2 - abs(dy);
+      depth = static_cast<UINT16>(max(500, depth - height - bulge));
+    }
+  }
+}
\ No newline at end of file
@@ -0,0 +1,132 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_DEPTH_SEQUENCE_H_
+#define KINECT_PATIENTS_OBSERVER_DEPTH_SEQUENCE_H_
+
+#include <string>
+#include <vector>
+#include "depth_archive.h"
+
+class Observer;
+
+/// <summary>
+/// Depth frames replayed offline into an observer.
+/// </summary>
+class DepthSequence {
+public:
+  virtual ~DepthSequence() {}
+
+  /// <summary>
+  /// Start again from the first frame.
+  /// </summary>
+  /// <returns>whether there are frames</returns>
+  virtual bool Rewind() = 0;
+  /// <summary>
+  /// Read the next frame.
+  /// </summary>
+  /// <param name="pFrame">frame of "GetWidth()" x "GetHeight()"</param>
+  /// <returns>whether a frame was read</returns>
+  virtual bool ReadFrame(UINT16 *pFrame) = 0;
+  /// <summary>
+  /// Prepare an observer for the frame read last,
+  /// e.g. restore a recorded state before the first frame.
+  /// Call it for every observer of the frame.
+  /// </summary>
+  /// <param name="pObserver">observer of the frame</param>
+  virtual void PrepareObserver(Observer *pObserver) const {
+    UNREFERENCED_PARAMETER(pObserver);
+  }
+
+  virtual const char *GetName() const = 0;
+  virtual int GetWidth() const = 0;
+  virtual int GetHeight() const = 0;
+};
+
+/// <summary>
+/// Frames of recorded segments played one after another,
+/// starting from the state saved in the first key frame.
+/// </summary>
+class ArchiveSequence : public DepthSequence {
+public:
+  /// <param name="fileName">path to the segment</param>
+  explicit ArchiveSequence(const char *fileName);
+  /// <param name="name">name of the recording</param>
+  /// <param name="fileNames">paths to segments of a bed in time order</param>
+  ArchiveSequence(const char *name, const std::vector<std::string> &fileNames);
+
+  bool Rewind() override;
+  bool ReadFrame(UINT16 *pFrame) override;
+  void PrepareObserver(Observer *pObserver) const override;
+
+  const char *GetName() const override { return m_name.c_str(); }
+  int GetWidth() const override { return m_width; }
+  int GetHeight() const override { return m_height; }
+  bool IsOpen() const { return m_isOpen; }
+  /// <summary>
+  /// Time of the last frame read.
+  /// </summary>
+  INT64 GetTimestamp() const { return m_timestamp; }
+
+private:
+  bool OpenSegment(size_t segment);
+
+  std::string m_name;
+  std::vector<std::string> m_fileNames;
+  size_t m_segment;
+  int m_width;   // [px]
+  int m_height;  // [px]
+  DepthArchiveReader m_reader;
+  bool m_isSegmentOpen;
+  bool m_isOpen;
+  bool m_isFirstFrameRead;
+  int m_numFramesRead;
+  INT64 m_timestamp;
+};
+
+/// <summary>
+/// Frames of a room made up: a patient lies on a bed, sits up,
+/// sits on the edge, stands beside the bed and lies down again.
+/// Lost depth is scattered over the frames. The same seed gives
+/// the same frames.
+/// </summary>
+class SyntheticSequence : public DepthSequence {
+public:
+  /// <param name="width">width of frames</param>
+  /// <param name="height">height of frames</param>
+  /// <param name="numFrames">length of the sequence</param>
+  /// <param name="seed">seed of noise</param>
+  SyntheticSequence(int width, int height, int numFrames, unsigned seed);
+
+  /// <summary>
+  /// Flip frames horizontally, e.g. to lay the head to the right.
+  /// </summary>
+  void SetMirrored(bool isMirrored);
+  /// <summary>
+  /// Move the scene away from the sensor, e.g. beyond its maximum depth.
+  /// </summary>
+  /// <param name="depthOffset">depth to add [mm]</param>
+  void SetDepthOffset(int depthOffset);
+
+  bool Rewind() override;
+  bool ReadFrame(UINT16 *pFrame) override;
+
+  const char *GetName() const override { return m_name; }
+  int GetWidth() const override { return m_width; }
+  int GetHeight() const override { return m_height; }
+
+private:
+  void UpdateName();
+  void DrawRoom(UINT16 *pFrame) const;
+  void DrawPatient(UINT16 *pFrame) const;
+  void DrawBox(UINT16 *pFrame, int xBegin, int yBegin, int xEnd, int yEnd,
+               int height, bool isRound) const;
+
+  char m_name[64];
+  int m_width;   // [px]
+  int m_height;  // [px]
+  int m_numFrames;
+  unsigned m_seed;
+  bool m_isMirrored;
+  int m_depthOffset;  // [mm]
+  int m_frame;
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_DEPTH_SEQUENCE_H_
\ No newline at end of file
@@ -0,0 +1,321 @@
+﻿#include "equivalence_harness.h"
+#include <limits.h>  // INT_MAX
+#include <math.h>    // fabs()
+#include <stdlib.h>  // abs()
+#include <memory>
+#include "allocation_counter.h"
+#include "depth_archive.h"
+#include "depth_sequence.h"
+#include "sensor_profile.h"
+
+// Every configuration is compared with this one.
+static const HarnessConfiguration cReference = {
+    "reference", Observer::eKernelReference, false, Observer::eQualityFull,
+    Observer::eHeadDetectorWindow, true};
+
+/// <summary>
+/// Search for the squared distance from a pixel to the nearest
+/// unchanged one by brute force, nearer rows first.
+/// </summary>
+static int SearchForSquaredDistance(const std::vector<UINT16> &difference,
+                                    int width, int height, int id) {
+  int x0 = id % width;
+  int y0 = id / width;
+  int squaredDistance = INT_MAX;
+  for (int dy = 0; dy < height && dy * dy < squaredDistance; ++dy) {
+    for (int y : {y0 - dy, y0 + dy}) {
+      if (y < 0 || height <= y || (dy == 0 && y != y0 - dy))
+        continue;
+      for (int x = 0; x < width; ++x) {
+        if (difference[y * width + x] == 0) {
+          squaredDistance =
+              min(squaredDistance, (x - x0) * (x - x0) + dy * dy);
+        }
+      }
+    }
+  }
+  return squaredDistance;
+}
+
+EquivalenceHarness::EquivalenceHarness(ThreadPool *pThreadPool)
+    : m_pThreadPool(pThreadPool),
+      m_probabilityTolerance(0.0),
+      m_headDistanceTolerance(0) {
+  // Optimizations must not change results.
+  AddConfiguration({"fused", Observer::eKernelFused, false,
+                    Observer::eQualityFull, Observer::eHeadDetectorWindow,
+                    true});
+  AddConfiguration({"fused parallel", Observer::eKernelFused, true,
+                    Observer::eQualityFull, Observer::eHeadDetectorWindow,
+                    true});
+  // Degradations and alternatives may, which is worth knowing.
+  AddConfiguration({"no lying on side", Observer::eKernelFused, true,
+                    Observer::eQualityNoLyingOnSide,
+                    Observer::eHeadDetectorWindow, false});
+  AddConfiguration({"coarse head search", Observer::eKernelFused, true,
+                    Observer::eQualityCoarseHeadSearch,
+                    Observer::eHeadDetectorWindow, false});
+  AddConfiguration({"distance head", Observer::eKernelFused, true,
+                    Observer::eQualityFull, Observer::eHeadDetectorDistance,
+                    true});
+}
+
+bool EquivalenceHarness::Run(DepthSequence *pSequence, FILE *pReport) {
+  std::vector<FrameResult> reference;
+  double referenceTime = Replay(cReference, pSequence, &reference);
+  fprintf(pReport, "%s: %d frames\n", pSequence->GetName(),
+          static_cast<int>(reference.size()));
+  if (reference.empty())
+    return true;
+
+  fprintf(pReport,
+          "  %-20s %9s %8s %6s %6s %7s %6s %9s %6s\n",
+          "configuration", "ms/frame", "speedup", "state", "head",
+          "corners", "prob", "max dprob", "first");
+  fprintf(pReport, "  %-20s %9.2f %7.2fx\n", cReference.name,
+          referenceTime / reference.size(), 1.0);
+
+  bool isEquivalent = true;
+  for (const HarnessConfiguration &configuration : m_configurations) {
+    std::vector<FrameResult> results;
+    double time = Replay(configuration, pSequence, &results);
+    Divergence divergence = Compare(reference, results,
+                                    pSequence->GetWidth());
+    bool isDiverged = divergence.firstFrame != -1;
+    if (configuration.mustMatch && isDiverged)
+      isEquivalent = false;
+
+    fprintf(pReport,
+            "  %-20s %9.2f %7.2fx %6d %6d %7d %6d %9.2e %6d%s\n",
+            configuration.name, time / max(1, static_cast<int>(results.size())),
+            referenceTime / max(time, 1e-9),
+            divergence.numStates, divergence.numHeadPositions,
+            divergence.numPatientCorners, divergence.numProbabilities,
+            divergence.maxProbabilityDifference, divergence.firstFrame,
+            (configuration.mustMatch && isDiverged) ? "  FAIL" : "");
+  }
+
+  fflush(pReport);
+  return isEquivalent;
+}
+
+bool EquivalenceHarness::RunCorpus(const char *directory, FILE *pReport) {
+  static const int cNumSyntheticFrames = 300;
+  static const int cSizes[][2] = {
+      {KinectV2Profile::cDepthBufferWidth,
+       KinectV2Profile::cDepthBufferHeight},
+      {KinectV1Profile::cDepthBufferWidth,
+       KinectV1Profile::cDepthBufferHeight},
+      {AzureKinectNfovProfile::cDepthBufferWidth,
+       AzureKinectNfovProfile::cDepthBufferHeight},
+  };
+
+  // Mirrored too, since searches for a head depend on its side,
+  // and beyond the maximum depth, which the head search sorts apart.
+  static const int cFarDepthOffset = 2500;  // [mm]
+  bool isEquivalent = true;
+  for (const int *pSize : cSizes) {
+    for (int isMirrored = 0; isMirrored <= 1; ++isMirrored) {
+      SyntheticSequence sequence(pSize[0], pSize[1], cNumSyntheticFrames, 1);
+      sequence.SetMirrored(isMirrored != 0);
+      isEquivalent = Run(&sequence, pReport) && isEquivalent;
+    }
+    SyntheticSequence sequence(pSize[0], pSize[1], cNumSyntheticFrames, 1);
+    sequence.SetDepthOffset(cFarDepthOffset);
+    isEquivalent = Run(&sequence, pReport) && isEquivalent;
+  }
+
+  if (directory) {
+    DepthArchiveCatalog catalog;
+    catalog.Scan(directory);
+    for (const DepthArchiveCatalog::Segment &segment :
+         catalog.GetSegments()) {
+      ArchiveSequence sequence(segment.fileName.c_str());
+      if (sequence.IsOpen())
+        isEquivalent = Run(&sequence, pReport) && isEquivalent;
+    }
+  }
+
+  isEquivalent = CheckAllocations(pReport) && isEquivalent;
+  isEquivalent = CheckDistanceTransform(pReport) && isEquivalent;
+
+  fprintf(pReport, "%s\n", isEquivalent ? "PASS" : "FAIL");
+  return isEquivalent;
+}
+
+bool EquivalenceHarness::CheckAllocations(FILE *pReport) const {
+  static const int cNumWarmUpFrames = 100;
+  static const int cNumFrames = 10000;
+  if (!AllocationCounter::IsEnabled()) {
+    fprintf(pReport, "allocations: not counted in this build\n");
+    return true;
+  }
+
+  std::vector<HarnessConfiguration> configurations(1, cReference);
+  for (const HarnessConfiguration &configuration : m_configurations) {
+    if (configuration.mustMatch)
+      configurations.push_back(configuration);
+  }
+
+  int width = KinectV2Profile::cDepthBufferWidth;
+  int height = KinectV2Profile::cDepthBufferHeight;
+  SyntheticSequence sequence(width, height, cNumWarmUpFrames + cNumFrames,
+                             1);
+  std::vector<UINT16> frame(width * height);
+  fprintf(pReport, "allocations in %d frames after %d:\n", cNumFrames,
+          cNumWarmUpFrames);
+  bool isFree = true;
+  for (const HarnessConfiguration &configuration : configurations) {
+    std::unique_ptr<Observer> pObserver(Observer::Create(width, height));
+    if (!pObserver || !sequence.Rewind())
+      return false;
+    pObserver->SetKernelMode(configuration.kernelMode);
+    pObserver->SetThreadPool(configuration.isParallel ? m_pThreadPool : NULL);
+    pObserver->SetQualityLevel(configuration.qualityLevel);
+    pObserver->SetHeadDetector(configuration.headDetector);
+
+    // Count only the observer, not reading frames.
+    INT64 numAllocations = 0;
+    for (int i = 0; sequence.ReadFrame(frame.data()); ++i) {
+      INT64 numAllocationsBefore = AllocationCounter::GetCount();
+      pObserver->Observe(frame.data());
+      if (cNumWarmUpFrames <= i)
+        numAllocations += AllocationCounter::GetCount() - numAllocationsBefore;
+    }
+
+    fprintf(pReport, "  %-20s %9lld%s\n", configuration.name, numAllocations,
+            numAllocations ? "  FAIL" : "");
+    isFree = isFree && numAllocations == 0;
+  }
+
+  fflush(pReport);
+  return isFree;
+}
+
+bool EquivalenceHarness::CheckDistanceTransform(FILE *pReport) const {
+  // Pixels apart to check, since the search is slow on sparse masks.
+  static const int cStep = 101;
+  // Unchanged pixels are 1 in 2^n, or only the first one for 0.
+  static const int cSparsities[] = {1, 6, 12, 0};
+  static const int cSizes[][2] = {
+      {KinectV2Profile::cDepthBufferWidth,
+       KinectV2Profile::cDepthBufferHeight},
+      {KinectV1Profile::cDepthBufferWidth,
+       KinectV1Profile::cDepthBufferHeight},
+      {AzureKinectNfovProfile::cDepthBufferWidth,
+       AzureKinectNfovProfile::cDepthBufferHeight},
+  };
+
+  int numChecked = 0;
+  int numDiverged = 0;
+  for (const int *pSize : cSizes) {
+    int width = pSize[0];
+    int height = pSize[1];
+    std::unique_ptr<Observer> pObserver(Observer::Create(width, height));
+    if (!pObserver)
+      return false;
+    pObserver->SetThreadPool(m_pThreadPool);
+    std::vector<UINT16> difference(width * height);
+    std::vector<int> squaredDistances(width * height);
+    for (int sparsity : cSparsities) {
+      unsigned random = (sparsity + 1) * 2654435761u;
+      unsigned mask = (1u << sparsity) - 1;
+      for (int i = 0; i < width * height; ++i) {
+        random = random * 1103515245u + 12345u;
+        bool isChanged = sparsity ? ((random >> 16) & mask) != 0 : i != 0;
+        difference[i] = isChanged ? 1 : 0;
+      }
+      pObserver->CalculateDistanceTransform(difference.data(),
+                                            squaredDistances.data());
+      for (int i = 0; i < width * height; i += cStep) {
+        ++numChecked;
+        if (squaredDistances[i] !=
+            SearchForSquaredDistance(difference, width, height, i))
+          ++numDiverged;
+      }
+    }
+  }
+
+  fprintf(pReport, "distance transform: %d of %d pixels diverged%s\n",
+          numDiverged, numChecked, numDiverged ? "  FAIL" : "");
+  fflush(pReport);
+  return numDiverged == 0;
+}
+
+double EquivalenceHarness::Replay(const HarnessConfiguration &configuration,
+                                  DepthSequence *pSequence,
+                                  std::vector<FrameResult> *pResults) const {
+  pResults->clear();
+  std::unique_ptr<Observer> pObserver(Observer::Create(
+      pSequence->GetWidth(), pSequence->GetHeight()));
+  if (!pObserver || !pSequence->Rewind())
+    return 0.0;
+  pObserver->SetKernelMode(configuration.kernelMode);
+  pObserver->SetThreadPool(configuration.isParallel ? m_pThreadPool : NULL);
+  pObserver->SetQualityLevel(configuration.qualityLevel);
+  pObserver->SetHeadDetector(configuration.headDetector);
+
+  // Time only the observer, not reading frames.
+  std::vector<UINT16> frame(pSequence->GetWidth() * pSequence->GetHeight());
+  Observer::Clock::duration time = Observer::Clock::duration::zero();
+  while (pSequence->ReadFrame(frame.data())) {
+    pSequence->PrepareObserver(pObserver.get());
+    Observer::Clock::time_point start = Observer::Clock::now();
+    pObserver->Observe(frame.data());
+    time += Observer::Clock::now() - start;
+
+    FrameResult result;
+    result.state = pObserver->GetState();
+    result.headPosition = pObserver->GetHeadPosition();
+    result.patientCorners = pObserver->GetPatientCorners();
+    result.probabilityPatientOnBed = pObserver->GetProbabilityPatientOnBed();
+    pResults->push_back(result);
+  }
+
+  return std::chrono::duration<double, std::milli>(time).count();
+}
+
+EquivalenceHarness::Divergence EquivalenceHarness::Compare(
+    const std::vector<FrameResult> &reference,
+    const std::vector<FrameResult> &results, int width) const {
+  Divergence divergence = {0, 0, 0, 0, 0.0, -1};
+  int numFrames = static_cast<int>(min(reference.size(), results.size()));
+  for (int i = 0; i < numFrames; ++i) {
+    const FrameResult &expected = reference[i];
+    const FrameResult &actual = results[i];
+    bool isStateDiverged = expected.state != actual.state;
+    bool isHeadDiverged = !IsNearHead(expected.headPosition,
+                                      actual.headPosition, width);
+    bool areCornersDiverged = expected.patientCorners !=
+                              actual.patientCorners;
+    double probabilityDifference = fabs(expected.probabilityPatientOnBed -
+                                        actual.probabilityPatientOnBed);
+    bool isProbabilityDiverged =
+        m_probabilityTolerance < probabilityDifference;
+
+    divergence.numStates += isStateDiverged ? 1 : 0;
+    divergence.numHeadPositions += isHeadDiverged ? 1 : 0;
+    divergence.numPatientCorners += areCornersDiverged ? 1 : 0;
+    divergence.numProbabilities += isProbabilityDiverged ? 1 : 0;
+    divergence.maxProbabilityDifference = max(
+        divergence.maxProbabilityDifference, probabilityDifference);
+    bool isDiverged = isStateDiverged || isHeadDiverged ||
+                      areCornersDiverged || isProbabilityDiverged;
+    if (isDiverged && divergence.firstFrame == -1)
+      divergence.firstFrame = i;
+  }
+
+  // Missing frames diverge too.
+  if (reference.size() != results.size() && divergence.firstFrame == -1)
+    divergence.firstFrame = numFrames;
+  return divergence;
+}
+
+bool EquivalenceHarness::IsNearHead(int reference, int result,
+                                    int width) const {
+  if (reference == Observer::eUnknown || result == Observer::eUnknown)
+    return reference == result;
+  int dx = abs(reference % width - result % width);
+  int dy = abs(reference / width - result / width);
+  return max(dx, dy) <= m_headDistanceTolerance;
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_EQUIVALENCE_HARNESS_H_
+#define KINECT_PATIENTS_OBSERVER_EQUIVALENCE_HARNESS_H_
+
+#include <stdio.h>
+#include <vector>
+#include "observer.h"
+
+class DepthSequence;
+class ThreadPool;
+
+/// <summary>
+/// Settings of Observer to compare with the reference,
+/// which runs the reference kernel serially at full quality.
+/// </summary>
+struct HarnessConfiguration {
+  const char *name;
+  Observer::KernelMode kernelMode;
+  bool isParallel;
+  Observer::QualityLevel qualityLevel;
+  Observer::HeadDetector headDetector;
+  bool mustMatch;  // Otherwise divergence is only reported.
+};
+
+/// <summary>
+/// Replays depth sequences through the reference Observer and
+/// optimized configurations, compares their results frame by frame
+/// and reports speed against divergence.
+/// </summary>
+class EquivalenceHarness {
+public:
+  /// <summary>
+  /// Prepare the optimized configurations shipped.
+  /// </summary>
+  /// <param name="pThreadPool">pool for parallel configurations</param>
+  explicit EquivalenceHarness(ThreadPool *pThreadPool);
+
+  void AddConfiguration(const HarnessConfiguration &configuration) {
+    m_configurations.push_back(configuration);
+  }
+  /// <summary>
+  /// Allow differences, 0 to require exact results.
+  /// </summary>
+  /// <param name="probability">of "GetProbabilityPatientOnBed()"</param>
+  /// <param name="headDistance">of head positions in pixels</param>
+  void SetTolerance(double probability, int headDistance) {
+    m_probabilityTolerance = probability;
+    m_headDistanceTolerance = headDistance;
+  }
+
+  /// <summary>
+  /// Compare the configurations on a sequence.
+  /// </summary>
+  /// <param name="pSequence">frames to replay</param>
+  /// <param name="pReport">file to write the report</param>
+  /// <returns>whether configurations which must match did</returns>
+  bool Run(DepthSequence *pSequence, FILE *pReport);
+  /// <summary>
+  /// Compare the configurations on synthetic sequences of every sensor
+  /// and on the recordings in a directory, check that frames don't
+  /// allocate when allocations are counted, and check the distance
+  /// transform.
+  /// </summary>
+  /// <param name="directory">directory of recordings, or NULL</param>
+  /// <param name="pReport">file to write the report</param>
+  /// <returns>whether configurations which must match did</returns>
+  bool RunCorpus(const char *directory, FILE *pReport);
+  /// <summary>
+  /// Replay a long synthetic sequence through the reference and
+  /// configurations which must match, and count heap allocations
+  /// in "Observe()" after warm-up.
+  /// </summary>
+  /// <param name="pReport">file to write the report</param>
+  /// <returns>whether no frame allocated, or allocations
+  /// are not counted in this build</returns>
+  bool CheckAllocations(FILE *pReport) const;
+  /// <summary>
+  /// Check the distance transform of the distance head detector
+  /// against a brute force search on random masks of every sensor.
+  /// </summary>
+  /// <param name="pReport">file to write the report</param>
+  /// <returns>whether every distance checked matched</returns>
+  bool CheckDistanceTransform(FILE *pReport) const;
+private:
+  /// <summary>
+  /// Results of a frame to compare.
+  /// </summary>
+  struct FrameResult {
+    Observer::PatientState state;
+    int headPosition;
+    std::vector<int> patientCorners;
+    double probabilityPatientOnBed;
+  };
+  /// <summary>
+  /// Frames differing from the reference.
+  /// </summary>
+  struct Divergence {
+    int numStates;
+    int numHeadPositions;
+    int numPatientCorners;
+    int numProbabilities;
+    double maxProbabilityDifference;
+    int firstFrame;
+  };
+
+  double Replay(const HarnessConfiguration &configuration,
+                DepthSequence *pSequence,
+                std::vector<FrameResult> *pResults) const;
+  Divergence Compare(const std::vector<FrameResult> &reference,
+                     const std::vector<FrameResult> &results,
+                     int width) const;
+  bool IsNearHead(int reference, int result, int width) const;
+
+  ThreadPool *m_pThreadPool;
+  std::vector<HarnessConfiguration> m_configurations;
+  double m_probabilityTolerance;
+  int m_headDistanceTolerance;  // [px]
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_EQUIVALENCE_HARNESS_H_
\ No newline at end of file
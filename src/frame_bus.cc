@@ -0,0 +1,238 @@
+﻿#include "frame_bus.h"
+#include <string.h>  // memcpy()
+#include "observer.h"
+
+// To recognize a bus, "DFB1".
+static const UINT32 cBusSignature = 0x31424644;
+static const UINT32 cVersion = 1;
+// Slots and frames start on cache lines.
+static const UINT32 cAlignment = 64;  // [bytes]
+
+static UINT32 Align(UINT32 size) {
+  return (size + cAlignment - 1) / cAlignment * cAlignment;
+}
+
+static UINT32 GetFrameOffset() {
+  return Align(sizeof(FrameBusSlotHeader));
+}
+
+/// <summary>
+/// Get the slot of a frame.
+/// </summary>
+/// <param name="pData">mapped bus</param>
+/// <param name="frame">number of the frame from 1</param>
+static const FrameBusSlotHeader *GetSlot(const BYTE *pData, INT64 frame) {
+  const FrameBusHeader *pHeader =
+      reinterpret_cast<const FrameBusHeader *>(pData);
+  UINT64 slot = static_cast<UINT64>(frame - 1) % pHeader->numSlots;
+  return reinterpret_cast<const FrameBusSlotHeader *>(
+      pData + Align(sizeof(FrameBusHeader)) + slot * pHeader->slotSize);
+}
+
+FrameBusWriter::FrameBusWriter()
+    : m_hMapping(NULL),
+      m_pData(NULL),
+      m_pHeader(NULL),
+      m_numFramesWritten(0) {
+}
+
+FrameBusWriter::~FrameBusWriter() {
+  Close();
+}
+
+bool FrameBusWriter::Create(const char *name, int width, int height,
+                            int numSlots) {
+  Close();
+  if (width <= 0 || height <= 0 || numSlots < 2)
+    return false;
+
+  UINT32 slotSize = GetFrameOffset() +
+                    Align(width * height * sizeof(UINT16));
+  UINT64 size = Align(sizeof(FrameBusHeader)) +
+                static_cast<UINT64>(slotSize) * numSlots;
+  m_hMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                  static_cast<DWORD>(size >> 32),
+                                  static_cast<DWORD>(size), name);
+  // Another writer owns the bus.
+  if (m_hMapping && GetLastError() == ERROR_ALREADY_EXISTS) {
+    Close();
+    return false;
+  }
+  if (m_hMapping) {
+    m_pData = static_cast<BYTE *>(
+        MapViewOfFile(m_hMapping, FILE_MAP_WRITE, 0, 0, 0));
+  }
+  if (!m_pData) {
+    Close();
+    return false;
+  }
+
+  // New mappings are zeroed, so every slot has sequence 0 first.
+  // The signature is written last for readers opening meanwhile.
+  m_pHeader = reinterpret_cast<FrameBusHeader *>(m_pData);
+  m_pHeader->version = cVersion;
+  m_pHeader->width = width;
+  m_pHeader->height = height;
+  m_pHeader->numSlots = numSlots;
+  m_pHeader->slotSize = slotSize;
+  m_pHeader->numFramesWritten.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  m_pHeader->signature = cBusSignature;
+  m_numFramesWritten = 0;
+  return true;
+}
+
+void FrameBusWriter::Close() {
+  if (m_pData)
+    UnmapViewOfFile(m_pData);
+  if (m_hMapping)
+    CloseHandle(m_hMapping);
+  m_hMapping = NULL;
+  m_pData = NULL;
+  m_pHeader = NULL;
+}
+
+void FrameBusWriter::Write(INT64 timestamp, const UINT16 *pFrame) {
+  if (!m_pHeader)
+    return;
+
+  INT64 frame = m_numFramesWritten + 1;
+  FrameBusSlotHeader *pSlot =
+      const_cast<FrameBusSlotHeader *>(GetSlot(m_pData, frame));
+  pSlot->sequence.store(2 * frame - 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  pSlot->timestamp = timestamp;
+  memcpy(reinterpret_cast<BYTE *>(pSlot) + GetFrameOffset(), pFrame,
+         m_pHeader->width * m_pHeader->height * sizeof(UINT16));
+  pSlot->sequence.store(2 * frame, std::memory_order_release);
+
+  m_pHeader->numFramesWritten.store(frame, std::memory_order_release);
+  m_numFramesWritten = frame;
+}
+
+FrameBusReader::FrameBusReader()
+    : m_hMapping(NULL),
+      m_pData(NULL),
+      m_pHeader(NULL),
+      m_nextFrame(1),
+      m_pAcquiredSlot(NULL),
+      m_acquiredFrame(0),
+      m_numFramesRead(0),
+      m_numFramesSkipped(0),
+      m_numFramesTorn(0) {
+}
+
+FrameBusReader::~FrameBusReader() {
+  Close();
+}
+
+bool FrameBusReader::Open(const char *name) {
+  Close();
+
+  m_hMapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+  if (m_hMapping) {
+    m_pData = static_cast<const BYTE *>(
+        MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+  }
+  const FrameBusHeader *pHeader =
+      reinterpret_cast<const FrameBusHeader *>(m_pData);
+  bool isOpened = pHeader && pHeader->signature == cBusSignature;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  isOpened = isOpened && pHeader->version == cVersion &&
+             2 <= pHeader->numSlots;
+  if (!isOpened) {
+    Close();
+    return false;
+  }
+
+  m_pHeader = pHeader;
+  m_nextFrame = max(1LL, m_pHeader->numFramesWritten.load(
+                             std::memory_order_acquire));
+  return true;
+}
+
+void FrameBusReader::Close() {
+  if (m_pData)
+    UnmapViewOfFile(m_pData);
+  if (m_hMapping)
+    CloseHandle(m_hMapping);
+  m_hMapping = NULL;
+  m_pData = NULL;
+  m_pHeader = NULL;
+  m_pAcquiredSlot = NULL;
+}
+
+const UINT16 *FrameBusReader::AcquireFrame(INT64 *pTimestamp) {
+  if (!m_pHeader || m_pAcquiredSlot)
+    return NULL;
+
+  const FrameBusSlotHeader *pSlot = NULL;
+  while (true) {
+    INT64 latestFrame =
+        m_pHeader->numFramesWritten.load(std::memory_order_acquire);
+    if (latestFrame < m_nextFrame)
+      return NULL;
+
+    // Leave the slot the writer writes next, which is the oldest.
+    INT64 oldestFrame = max(1LL, latestFrame - m_pHeader->numSlots + 2);
+    if (m_nextFrame < oldestFrame) {
+      m_numFramesSkipped += oldestFrame - m_nextFrame;
+      m_nextFrame = oldestFrame;
+    }
+
+    pSlot = GetSlot(m_pData, m_nextFrame);
+    if (pSlot->sequence.load(std::memory_order_acquire) == 2 * m_nextFrame)
+      break;
+    // Overwritten since the writer went on.
+    ++m_numFramesSkipped;
+    ++m_nextFrame;
+  }
+
+  m_pAcquiredSlot = pSlot;
+  m_acquiredFrame = m_nextFrame++;
+  *pTimestamp = pSlot->timestamp;
+  return reinterpret_cast<const UINT16 *>(
+      reinterpret_cast<const BYTE *>(pSlot) + GetFrameOffset());
+}
+
+bool FrameBusReader::ReleaseFrame() {
+  if (!m_pAcquiredSlot)
+    return false;
+
+  // Check that the writer didn't enter the slot during the reads.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  bool isIntact = m_pAcquiredSlot->sequence.load(
+                      std::memory_order_relaxed) == 2 * m_acquiredFrame;
+  m_pAcquiredSlot = NULL;
+  ++m_numFramesRead;
+  if (!isIntact)
+    ++m_numFramesTorn;
+  return isIntact;
+}
+
+FrameBusObserverAdapter::FrameBusObserverAdapter(FrameBusReader *pReader,
+                                                 Observer *pObserver)
+    : m_pReader(pReader),
+      m_pObserver(pObserver) {
+}
+
+FrameBusObserverAdapter::Status FrameBusObserverAdapter::ObserveNext() {
+  bool isSameSize =
+      m_pReader->GetWidth() == m_pObserver->GetDepthBufferWidth() &&
+      m_pReader->GetHeight() == m_pObserver->GetDepthBufferHeight();
+  if (!isSameSize)
+    return eNoFrame;
+
+  INT64 timestamp;
+  const UINT16 *pFrame = m_pReader->AcquireFrame(&timestamp);
+  if (!pFrame)
+    return eNoFrame;
+
+  // Copy the frame at once, so that the slot is read only briefly.
+  // A torn copy is left to be overwritten by the next frame.
+  m_pObserver->LoadFrame(pFrame);
+  if (!m_pReader->ReleaseFrame())
+    return eTorn;
+  m_pObserver->ObserveLoadedFrame();
+  return eObserved;
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_FRAME_BUS_H_
+#define KINECT_PATIENTS_OBSERVER_FRAME_BUS_H_
+
+#include <atomic>
+
+class Observer;
+
+// A frame bus is a ring of depth frames in named shared memory,
+// written by the capture process and read in place by any number of
+// processes, e.g. an observer, a recorder and a viewer.
+// Frames are numbered from 1 and the n-th one goes to slot (n - 1) %
+// numSlots. The sequence of a slot is 2n - 1 while the n-th frame is
+// written into it and 2n after, so that readers can tell a frame
+// overwritten before or while it was read without locks.
+
+struct FrameBusHeader {
+  UINT32 signature;
+  UINT32 version;
+  UINT32 width;     // [px]
+  UINT32 height;    // [px]
+  UINT32 numSlots;
+  UINT32 slotSize;  // [bytes] Including FrameBusSlotHeader.
+  std::atomic<INT64> numFramesWritten;
+};
+
+// Followed by the frame.
+struct FrameBusSlotHeader {
+  std::atomic<INT64> sequence;
+  INT64 timestamp;
+};
+
+/// <summary>
+/// Publishes depth frames to a bus. Only one writer may exist per bus.
+/// </summary>
+class FrameBusWriter {
+public:
+  FrameBusWriter();
+  ~FrameBusWriter();
+
+  /// <summary>
+  /// Create a bus.
+  /// </summary>
+  /// <param name="name">name of the bus shared with readers</param>
+  /// <param name="width">width of frames</param>
+  /// <param name="height">height of frames</param>
+  /// <param name="numSlots">frames kept, at least 2</param>
+  /// <returns>whether the bus was created</returns>
+  bool Create(const char *name, int width, int height, int numSlots);
+  void Close();
+
+  /// <summary>
+  /// Copy a frame into the next slot and publish it.
+  /// </summary>
+  /// <param name="timestamp">time when the frame was taken</param>
+  /// <param name="pFrame">raw depth frame</param>
+  void Write(INT64 timestamp, const UINT16 *pFrame);
+
+private:
+  HANDLE m_hMapping;
+  BYTE *m_pData;
+  FrameBusHeader *m_pHeader;
+  INT64 m_numFramesWritten;
+};
+
+/// <summary>
+/// Reads depth frames of a bus in place.
+/// A reader falling behind skips to recent frames
+/// instead of reading ones the writer is about to overwrite.
+/// </summary>
+class FrameBusReader {
+public:
+  FrameBusReader();
+  ~FrameBusReader();
+
+  /// <summary>
+  /// Open a bus created by the writer, starting from its latest frame.
+  /// </summary>
+  /// <param name="name">name of the bus</param>
+  /// <returns>whether the bus was opened</returns>
+  bool Open(const char *name);
+  void Close();
+
+  /// <summary>
+  /// Get the next frame in its slot.
+  /// The frame must be released before acquiring another.
+  /// </summary>
+  /// <param name="pTimestamp">time of the frame</param>
+  /// <returns>frame valid until it is released, or NULL
+  /// if no new frame has been written</returns>
+  const UINT16 *AcquireFrame(INT64 *pTimestamp);
+  /// <summary>
+  /// Finish reading the acquired frame.
+  /// </summary>
+  /// <returns>whether the frame stayed intact while read,
+  /// otherwise it was partly overwritten</returns>
+  bool ReleaseFrame();
+
+  // Accessors.
+  bool IsOpen() const { return m_pHeader != NULL; }
+  int GetWidth() const { return IsOpen() ? m_pHeader->width : 0; }
+  int GetHeight() const { return IsOpen() ? m_pHeader->height : 0; }
+  INT64 GetNumFramesRead() const { return m_numFramesRead; }
+  INT64 GetNumFramesSkipped() const { return m_numFramesSkipped; }
+  INT64 GetNumFramesTorn() const { return m_numFramesTorn; }
+
+private:
+  HANDLE m_hMapping;
+  const BYTE *m_pData;
+  const FrameBusHeader *m_pHeader;
+  INT64 m_nextFrame;
+  const FrameBusSlotHeader *m_pAcquiredSlot;
+  INT64 m_acquiredFrame;
+  // Overruns.
+  INT64 m_numFramesRead;
+  INT64 m_numFramesSkipped;  // Overwritten before they were read.
+  INT64 m_numFramesTorn;     // Overwritten while they were read.
+};
+
+/// <summary>
+/// Lets an observer consume frames of a bus.
+/// A frame is copied out of its slot into the observer and checked
+/// before it is observed, since the observer reads it throughout the
+/// frame and a frame torn by the writer must not be judged.
+/// </summary>
+class FrameBusObserverAdapter {
+public:
+  enum Status {
+    eNoFrame,   // No new frame has been written.
+    eObserved,
+    eTorn,      // Overwritten while copied, and not observed.
+  };
+
+  /// <param name="pReader">opened reader</param>
+  /// <param name="pObserver">observer for frames of the size</param>
+  FrameBusObserverAdapter(FrameBusReader *pReader, Observer *pObserver);
+
+  /// <summary>
+  /// Observe the next frame if any and intact.
+  /// </summary>
+  /// <returns>what became of the next frame</returns>
+  Status ObserveNext();
+
+private:
+  FrameBusReader *m_pReader;
+  Observer *m_pObserver;
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_FRAME_BUS_H_
\ No newline at end of file
@@ -0,0 +1,66 @@
+﻿#include "frame_trace.h"
+#include <vector>
+#include "atomic_file.h"
+
+static const char *const cBedExitNames[] = {
+    "none", "provisional", "confirmed"};
+
+static double ToMilliseconds(Observer::Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+void FrameTraceRing::Add(const FrameTrace &trace) {
+  INT64 number = m_numTraces.load(std::memory_order_relaxed) + 1;
+  FrameTrace numbered = trace;
+  numbered.number = number;
+  m_traces[(number - 1) % cNumTraces].Store(numbered);
+  m_numTraces.store(number, std::memory_order_release);
+}
+
+void FrameTraceRing::Write(FILE *pFile) const {
+  // Copy the traces first, leaving out ones overwritten meanwhile.
+  INT64 numTraces = m_numTraces.load(std::memory_order_acquire);
+  std::vector<FrameTrace> traces;
+  traces.reserve(cNumTraces);
+  for (INT64 number = max(1LL, numTraces - cNumTraces + 1);
+       number <= numTraces; ++number) {
+    FrameTrace trace;
+    m_traces[(number - 1) % cNumTraces].Load(&trace);
+    if (trace.number == number)
+      traces.push_back(trace);
+  }
+
+  // The least delay from the sensor to arrival is taken as zero.
+  typedef std::chrono::duration<INT64, std::ratio<1, 10000000>> Ticks;
+  INT64 minDelay = LLONG_MAX;  // [100 ns]
+  for (const FrameTrace &trace : traces) {
+    if (!trace.frameTime)
+      continue;
+    INT64 arrivalTime = std::chrono::duration_cast<Ticks>(
+        trace.arrivalTime.time_since_epoch()).count();
+    minDelay = min(minDelay, arrivalTime - trace.frameTime);
+  }
+
+  fprintf(pFile, "frame,frame_time,arrival_delay_ms,start_ms,decision_ms,"
+                 "publication_ms,state,bed_exit,observed\n");
+  for (const FrameTrace &trace : traces) {
+    fprintf(pFile, "%lld,%lld,", trace.number, trace.frameTime);
+    if (trace.frameTime) {
+      INT64 arrivalTime = std::chrono::duration_cast<Ticks>(
+          trace.arrivalTime.time_since_epoch()).count();
+      fprintf(pFile, "%.3f", (arrivalTime - trace.frameTime - minDelay) /
+                             1e4);
+    }
+    fprintf(pFile, ",%.3f,%.3f,%.3f,%s,%s,%d\n",
+            ToMilliseconds(trace.startTime - trace.arrivalTime),
+            ToMilliseconds(trace.decisionTime - trace.arrivalTime),
+            ToMilliseconds(trace.publicationTime - trace.arrivalTime),
+            Observer::cStateNames[trace.state], cBedExitNames[trace.bedExitStatus],
+            trace.isObserved ? 1 : 0);
+  }
+}
+
+bool FrameTraceRing::WriteFile(const char *fileName) const {
+  return WriteFileAtomically(fileName,
+                             [this](FILE *pFile) { Write(pFile); });
+}
\ No newline at end of file
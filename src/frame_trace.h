@@ -0,0 +1,61 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_FRAME_TRACE_H_
+#define KINECT_PATIENTS_OBSERVER_FRAME_TRACE_H_
+
+#include <stdio.h>
+#include <atomic>
+#include "observer.h"
+#include "seqlock.h"
+
+/// <summary>
+/// Times of a frame from the sensor to its published result.
+/// </summary>
+struct FrameTrace {
+  INT64 number;     // Counted from 1 by the ring.
+  INT64 frameTime;  // [100 ns] Of the sensor, or 0 if unknown.
+  Observer::Clock::time_point arrivalTime;
+  Observer::Clock::time_point startTime;     // Of the analysis.
+  Observer::Clock::time_point decisionTime;  // Of the state and bed exit.
+  Observer::Clock::time_point publicationTime;
+  Observer::PatientState state;
+  Observer::BedExitStatus bedExitStatus;
+  bool isObserved;  // Otherwise only through the fast path.
+};
+
+/// <summary>
+/// Keeps the traces of the latest frames in a ring without locks,
+/// so that it can be dumped on any thread while frames are observed.
+/// Only one thread may add traces.
+/// </summary>
+class FrameTraceRing {
+public:
+  // About half a minute at 30 fps.
+  static const int cNumTraces = 1024;
+
+  FrameTraceRing() : m_numTraces(0) {}
+
+  /// <summary>
+  /// Add the trace of a frame over the oldest one.
+  /// </summary>
+  /// <param name="trace">trace, numbered by the ring</param>
+  void Add(const FrameTrace &trace);
+  /// <summary>
+  /// Write the traces kept as CSV in time order, with times in
+  /// milliseconds from the arrival of each frame.
+  /// The delay of arrival is over the least one in the ring,
+  /// since the clock of the sensor is unrelated to this one.
+  /// </summary>
+  /// <param name="pFile">file to write</param>
+  void Write(FILE *pFile) const;
+  /// <summary>
+  /// Replace a file with the traces at once.
+  /// </summary>
+  /// <param name="fileName">path to the file</param>
+  /// <returns>whether the file was replaced</returns>
+  bool WriteFile(const char *fileName) const;
+
+private:
+  SeqLock<FrameTrace> m_traces[cNumTraces];
+  std::atomic<INT64> m_numTraces;
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_FRAME_TRACE_H_
\ No newline at end of file
@@ -1,739 +1,1623 @@
-﻿#include "observer.h"
-#define _USE_MATH_DEFINES  // M_PI
-#include <math.h>          // M_PI
-#include <queue>
-#include <map>
-
-const double Observer::cBorderProbabilityStanding = 0.55;
-const double Observer::cBorderProbabilitySittingOnEdge = 0.93;
-
-// To get differences of depths.
-const int Observer::cDepthNoiseBorder = 300;
-const int Observer::cDepthOnBedNoiseBorder = 100;
-// To search for a patient area.
-const int Observer::cDepthNoiseBorderToSearchForPatientArea = 20;
-const int Observer::cNumSkipToSearchForPatientArea = 5;
-// To define a bed area.
-const int Observer::cNormalsDegreeTolerance = 50;
-const int Observer::cNeighborPixelsDistanceTolerance = 25;
-// To find a head.
-const int Observer::cHeadWidth = 140;
-// To judge a patient's state.
-const int Observer::cShoulderHeightBorderTurningAndLying = 200;
-const int Observer::cHeadHeightBorderSittingAndLying = 550;
-const int Observer::cDistanceHeadAndShoulder = 250;
-const int Observer::cDistanceHeadAndHip = 750;
-
-Observer::Observer()
-    : m_headPosition(eUnknown),
-      m_shoulderPosition(eUnknown),
-      m_depthAtHead(eUnknown),
-      m_relativeHeadSize(eUnknown),
-      m_quiltHeight(0.0) {
-  InitializeAllNext();
-}
-
-void Observer::Observe(const UINT16 *pBuffer) {
-  // Copy the given depth buffer and interpolate depth
-  // to protect the original.
-  UINT16 pTempBuffer[KinectOption::cDepthBufferSize];
-  memcpy(pTempBuffer, pBuffer, sizeof(pTempBuffer));
-  InterpolateDepth(pTempBuffer);
-
-  // Initialize as needed.
-  if (m_initializeNext)
-    return Initialize(pTempBuffer);
-  
-  // Get a patient's area.
-  CalculateDepthDifferences(pTempBuffer);
-  TrackHead(pTempBuffer);
-  SearchForPatientArea(pTempBuffer);  // From the tracked head.
-  UpdateBackgroundWithoutPatient(pTempBuffer);
-  if (m_headPosition != eUnknown)
-    CalculateDepthDifferences(pTempBuffer);  // Mask the buffer.
-
-  // Add a new frame to draw graph within set range.
-  static const int cMaxLogs = 100;
-  if (cMaxLogs <= m_logs.size())
-    m_logs.erase(m_logs.begin());
-  m_logs.push_back({});
-
-  JudgePatientState(pTempBuffer);
-  ReduceNoiseOfPatientState();
-
-  static const double cEpsilon = 1e-2;
-  if (GetProbabilityPatientOnBed() < cEpsilon)
-    GetAverageQuiltHeight(pTempBuffer);
-}
-
-void Observer::RegisterBedCorners(int x, int y) {
-  // Redefine bed corners if they were registered already.
-  if (IsBedAreaDefined())
-    m_bedCorners.clear();
-
-  // Calculate the normal around the clicked point.
-  int clickedId = KinectOption::GetId(x, y);
-  Vector tempBedNormal = GetTempBedNormal(clickedId);
-
-  // Search for a bed area.
-  bool bed[KinectOption::cDepthBufferSize] = {false};
-  std::queue<int> task; task.push(clickedId);
-  std::map<int, bool> isSearched;
-  while (!task.empty()) {
-    // Pop a point.
-    int current = task.front(); task.pop();
-    bed[current] = true;
-
-    // Search for 4-neighbor of the point recursively.
-    static const int cDx[4] = {0, -1, 1, 0};
-    static const int cDy[4] = {-1, 0, 0, 1};
-    for (int i = 0; i < 4; ++i) {
-      // Skip a point checked already.
-      int next = KinectOption::GetNextId(current, cDx[i], cDy[i]);
-      if (0 < isSearched.count(next))
-        continue;
-      isSearched[next] = true;
-
-      // Skip a lost depth.
-      if (!KinectOption::IsAvailableDepth(m_pBackground[next]))
-        continue;
-
-      // Calculate the normal around the current point.
-      Vector normal = KinectOption::CalculateNormal(next, m_pBackground);
-      normal = normal.Normalize();
-
-      // Calculate the angle between the normal of bed and
-      // around current point.
-      double angleDegree = tempBedNormal.AngleDegree(normal);
-
-      double distance = KinectOption::CalculateWorldDistance(
-          current, m_pBackground[current],
-          next, m_pBackground[next]);
-
-      bool isBed = distance < cNeighborPixelsDistanceTolerance &&
-                   angleDegree < cNormalsDegreeTolerance;
-      if (isBed)
-        task.push(next);
-    }
-  }
-
-  // Find bed corners from the bed area.
-  double minDistance[4] = {DBL_MAX, DBL_MAX, DBL_MAX, DBL_MAX};
-  int bedCorners[4];
-  for (int i = 0; i < KinectOption::cDepthBufferSize; ++i) {
-    if (!bed[i])
-      continue;
-
-    // Regard a point that minimize the distance to
-    // a corner of the screen as a bed corner.
-    for (int j = 0; j < 4; ++j) {
-      double distance = KinectOption::CalculateScreenDistance(
-          i,
-          KinectOption::cScreenCornersId[j]);
-      if (distance < minDistance[j]) {
-        minDistance[j] = distance;
-        bedCorners[j] = i;
-      }
-    }
-  }
-
-  for (int i = 0; i < 4; ++i)
-    m_bedCorners.push_back(bedCorners[i]);
-  CalculateCoordinatesOfBedCorners();
-
-  // Recalculate a bed normal using the defined area.
-  GetAverageBedNormal();
-}
-
-void Observer::Initialize(const UINT16 *pBuffer) {
-  if (!m_initializeNext)
-    return;
-
-  // Set current depth buffer into "m_pBackground".
-  memcpy(m_pBackground, pBuffer, sizeof(m_pBackground));
-  memset(m_pDifference, 0, sizeof(m_pDifference));
-
-  m_logs.clear();
-
-  if (!m_initializeOnlyBackground) {
-    LoadConstants();
-
-    // Search for a bed area around the center of the screen.
-    m_bedCorners.clear();
-    RegisterBedCorners(KinectOption::cDepthBufferXCenter,
-                       KinectOption::cDepthBufferYCenter);
-  }
-  
-  // Prevent to reinitialize.
-  m_initializeNext = false;
-  m_initializeOnlyBackground = false;
-}
-
-void Observer::LoadConstants() {
-  // At first, initialize constants with defaults.
-
-
-  // Open the configuration file from "cConstantsFileUrl".
-  static const char cConstantsFileUrl[] = "constants.ini";
-  FILE *pConstants;
-  errno_t error = fopen_s(&pConstants, cConstantsFileUrl, "r");
-  if (error != 0)
-    return;
-
-  // Read constants.
-  // http://stackoverflow.com/questions/17214026/
-  while (!feof(pConstants)) {
-    char name[128];
-    double value;
-    fscanf_s(pConstants, "%s%lf%*[\r\n ]", name, 128, &value);
-
-    // Interpret what the value is.
-
-  }
-
-  fclose(pConstants);
-
-  // Correct constants.
-
-}
-
-void Observer::InterpolateDepth(UINT16 *pBuffer) const {
-  UINT16 pTempBuffer[KinectOption::cDepthBufferSize];
-  memcpy(pTempBuffer, pBuffer, sizeof(pTempBuffer));
-
-  for (int i = 0; i < KinectOption::cDepthBufferSize; ++i) {
-    if (KinectOption::IsAvailableDepth(pTempBuffer[i]))
-      continue;
-
-    // Interpolate average depth of 8-neighbor.
-    double sumDepth = 0;
-    double sumWeight = 0;
-    static const double cWeight[8] = {0.7, 1, 0.7, 1, 1, 0.7, 1, 0.7};
-    static const int cDx[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
-    static const int cDy[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
-    for (int j = 0; j < 8; ++j) {
-      int next = KinectOption::GetNextId(i, cDx[j], cDy[j]);
-      if (KinectOption::IsAvailableDepth(pTempBuffer[next])) {
-        sumDepth += cWeight[j] * pTempBuffer[next];
-        sumWeight += cWeight[j];
-      }
-    }
-    pBuffer[i] = (sumWeight == 0.0) ? 0 :
-        static_cast<UINT16>(sumDepth / sumWeight);
-  }
-}
-
-void Observer::CalculateDepthDifferences(const UINT16 *pBuffer) {
-  // Claculate the difference between first depth buffer and given one.
-  for (int i = 0; i < KinectOption::cDepthBufferSize; ++i) {
-    bool isCorrect = KinectOption::IsAvailableDepth(m_pBackground[i]) &&
-                     KinectOption::IsAvailableDepth(pBuffer[i]);
-    if (!isCorrect) {
-      m_pDifference[i] = 0;
-    } else {
-      m_pDifference[i] = max(0, m_pBackground[i] - pBuffer[i]);
-
-      // Ignore noise.
-      if (IsOnBed(i, pBuffer[i])) {
-        if (m_pDifference[i] < cDepthOnBedNoiseBorder)
-          m_pDifference[i] = 0;
-      } else {
-        if (m_pDifference[i] < cDepthNoiseBorder)
-          m_pDifference[i] = 0;
-      }
-    }
-  }
-}
-
-void Observer::UpdateBackgroundWithoutPatient(const UINT16 *pBuffer) {
-  if (m_headPosition == eUnknown)
-    return;
-
-  for (int i = 0; i < KinectOption::cDepthBufferSize; ++i) {
-    if (!IsInnerPatientArea(i))
-      m_pBackground[i] = pBuffer[i];
-  }
-}
-
-void Observer::JudgePatientState(const UINT16 *pBuffer) {
-  m_shoulderPosition = eUnknown;
-
-  // There is no head.
-  if (eUnknown == m_headPosition) {
-    m_logs.back().state = eNone;
-    return;
-  }
-
-  // There is a head. ->
-  double probabilityPatientOnBed = CalculateProbabilityOnBed(pBuffer);
-  m_logs.back().probabilityPatientOnBed = probabilityPatientOnBed;
-
-  // Judge a patient's state from probability that a patient is on a bed.
-  // The relationship is as follows.
-  // |-> 0.0     |-> cBorderProbabilityStanding       |-> 1.0
-  // |           |                |-> cBorderProbabilitySittingOnEdge
-  // | eStanding | eSittingOnEdge | eSitting = eLying |
-  PatientState state;
-  if (cBorderProbabilitySittingOnEdge < probabilityPatientOnBed) {
-    double headHeight;
-    IsOnBed(m_headPosition, m_depthAtHead, &headHeight);
-    state = cHeadHeightBorderSittingAndLying < headHeight ? eSitting :
-            IsLyingOnSide(pBuffer) ? eLyingOnSide : eLying;
-  } else if (cBorderProbabilityStanding < probabilityPatientOnBed) {
-    state = eSittingOnEdge;
-  } else {
-    state = eStanding;
-  }
-
-  m_logs.back().state = state;
-}
-
-void Observer::ReduceNoiseOfPatientState() {
-  static double prevState = eNone;
-  if (m_logs.size() <= 1)  // When "Initialize()" was called.
-    prevState = eNone;  // Reset a state.
-  double currentState = GetState();
-
-  // Low-pass filter.
-  static const double cFilterStrength = 0.92;
-  double newState = (1.0 - cFilterStrength) * currentState +
-      cFilterStrength * prevState;
-
-  // Convert the type of the filtered state into "PatientState".
-  m_logs.back().state = static_cast<PatientState>(static_cast<int>(
-      round(newState)));
-
-  prevState = newState;
-}
-
-double Observer::CalculateProbabilityOnBed(const UINT16 *pBuffer) const {
-  if (!IsBedAreaDefined())
-    return 0.0;
-
-  // Count the number of changed pixels.
-  int numPixelsInnerBed = 0;
-  int numPixelsOuterBed = 0;
-  for (int i = 0; i < KinectOption::cDepthBufferSize; ++i) {
-    // Skip a pixel whose depth changed little.
-    if (!IsThereSomething(i))
-      continue;
-
-    // Check whether a pixel is an inner of the bed.
-    if (IsOnBed(i, pBuffer[i]))
-      ++numPixelsInnerBed;
-    else
-      ++numPixelsOuterBed;  
-  }
-
-  // Calculate max() to avoid 0 division.
-  double probabilityPatientOnBed = 1.0 * numPixelsInnerBed /
-      max(1, numPixelsInnerBed + numPixelsOuterBed);
-
-  return probabilityPatientOnBed;
-}
-
-bool Observer::IsLyingOnSide(const UINT16 *pBuffer) {
-  int dxHeadAndShoulder = static_cast<int>(
-      KinectOption::ConvertIntoScreenLength(cDistanceHeadAndShoulder,
-                                            m_depthAtHead));
-  int dxHeadAndHip = static_cast<int>(
-      KinectOption::ConvertIntoScreenLength(cDistanceHeadAndHip,
-                                            m_depthAtHead));
-
-  // Get a body shape.
-  std::vector<double> bodyHeights;
-  std::vector<int> bodyHeightsIds;
-  for (int dx = dxHeadAndShoulder; dx <= dxHeadAndHip; ++dx) {
-    int x = KinectOption::GetNextX(
-        m_headPosition,
-        KinectOption::IsLeftSide(m_headPosition) ? dx : -dx);
-
-    // Search for the highest point along the current x line.
-    double highestHeight = DBL_MIN;
-    int idAthighestPoint;
-    for (int y = 0; y < KinectOption::cDepthBufferHeight; ++y) {
-      int id = KinectOption::GetId(x, y);
-      double height;
-      if (IsThereSomething(id) && IsOnBed(id, pBuffer[id], &height) &&
-          highestHeight < height) {
-        highestHeight = height;
-        idAthighestPoint = id;
-      }
-    }
-
-    if (highestHeight != DBL_MIN) {
-      bodyHeights.push_back(highestHeight);
-      bodyHeightsIds.push_back(idAthighestPoint);
-    }
-  }
-
-  // Regard the lowest point in "bodyHeights" as shoulder.
-  double shoulderHeight = bodyHeights.empty() ? 0.0 : DBL_MAX;
-  for (int i = 0; i < static_cast<int>(bodyHeights.size()) - 1; ++i) {
-    double height = bodyHeights[i];
-    if (height < shoulderHeight) {
-      shoulderHeight = height;
-      m_shoulderPosition = bodyHeightsIds[i];
-    }
-  }
-
-  return cShoulderHeightBorderTurningAndLying < shoulderHeight - m_quiltHeight;
-}
-
-void Observer::TrackHead(const UINT16 *pBuffer) {
-  m_headPosition = SearchForHead(pBuffer);
-  m_depthAtHead = (m_headPosition == eUnknown) ? eUnknown :
-      pBuffer[m_headPosition];
-  
-  // Calculate variables related with a head.
-  m_relativeHeadSize = eUnknown;
-  if (eUnknown != m_headPosition) {
-    m_relativeHeadSize = static_cast<int>(
-        KinectOption::ConvertIntoScreenLength(cHeadWidth, m_depthAtHead));
-  }
-}
-
-int Observer::SearchForHead(const UINT16 *pBuffer) const {
-  // Search for a topmost position where a head can exist.
-  int headTopmost = eUnknown;
-  int minDepth = INT_MAX;
-  for (int id = 0; id < KinectOption::cDepthBufferSize; ++id) {
-    int depth = pBuffer[id];
-
-    // Check skippable of this pixel for faster searching.
-    if (!IsThereSomething(id) || minDepth <= depth)
-      continue;
-
-    // Check whether a head can be here.
-    // NOTE: This function call costs time.
-    if (IsHead(id, depth)) {
-      minDepth = depth;
-      headTopmost = id;
-    }
-  }
-
-  bool isThereNoHead = (headTopmost == eUnknown);
-  if (isThereNoHead)
-    return eUnknown;
-
-  // Search for the nearest position to an edge where a head can exist
-  // if a patient is lying at a previous frame.
-  int headNearestEdge = eUnknown;
-  for (int dx = 0; dx < KinectOption::cDepthBufferWidth; ++dx) {
-    int x = KinectOption::IsLeftSide(m_headPosition) ? dx :
-        KinectOption::cDepthBufferWidth - 1 - dx;
-    for (int y = 0; y < KinectOption::cDepthBufferHeight; ++y) {
-      int id = KinectOption::GetId(x, y);
-      int depth = pBuffer[id];
-
-      // Check skippable of this pixel for faster searching.
-      if (!IsThereSomething(id))
-        continue;
-
-      // Check whether a head can be here.
-      // NOTE: This function call costs time.
-      if (IsHead(id, depth)) {
-        headNearestEdge = id;
-        break;
-      }
-    }
-    if (headNearestEdge != eUnknown)
-      break;
-  }
-
-  // Choose the most suitable position as a head
-  // with weighting each distance.
-  // Calculate weight.
-  static const double cWeightHeadTopmostRising = 3.0;
-  double weightHeadTopmost = cWeightHeadTopmostRising;
-  bool isRising = (GetState() <= eSitting);
-  if (!isRising) {
-    double headHeight;
-    IsOnBed(m_headPosition, m_depthAtHead, &headHeight);
-    double coefficientRising = headHeight / cHeadHeightBorderSittingAndLying;
-    weightHeadTopmost = coefficientRising;
-  }
-
-  // Determine a head.
-  double distanceHeadNearestEdge = KinectOption::CalculateWorldDistance(
-      headNearestEdge, pBuffer[headNearestEdge],
-      m_headPosition, m_depthAtHead);
-  double distanceHeadTopmost = KinectOption::CalculateWorldDistance(
-      headTopmost, pBuffer[headTopmost],
-      m_headPosition, m_depthAtHead);
-  return (distanceHeadNearestEdge * weightHeadTopmost < distanceHeadTopmost) ?
-      headNearestEdge : headTopmost;
-}
-
-bool Observer::IsHead(int id, int depth) const {
-  static const double cRatioCircumscribedSquareToCircle = M_PI / 4;
-  int currentHeadSize = static_cast<int>(
-      KinectOption::ConvertIntoScreenLength(cHeadWidth, depth));
-  int searchArea = static_cast<int>(pow(currentHeadSize, 2));
-  int minAreaToRegardAsHead = static_cast<int>(
-      cRatioCircumscribedSquareToCircle * searchArea);
-
-  // Get depth data around the current position.
-  int area = 0;
-  int counter = 0;
-  for (int dy = -currentHeadSize / 2; dy < currentHeadSize / 2; ++dy) {
-    for (int dx = -currentHeadSize / 2; dx < currentHeadSize / 2; ++dx) {
-      int idAroundCurrent = KinectOption::GetNextId(id, dx, dy);
-      area += IsThereSomething(idAroundCurrent) ? 1 : 0;
-
-      // If the area is larger than the setting,
-      // regard the current position as a head position.
-      if (minAreaToRegardAsHead <= area)
-        return true;
-
-      // If won't find a head any more, stop searching.
-      int remainingAllArea = searchArea - (++counter);
-      int remainingNeededArea = minAreaToRegardAsHead - area;
-      if (remainingAllArea < remainingNeededArea)
-        return false;
-    }
-  }
-
-  return false;
-}
-
-Vector Observer::GetTempBedNormal(int clickedId) {
-  int clickedDepth = m_pBackground[clickedId];
-  static const int cWidthToGetTempBedNormal = 150;
-  int currentSize = static_cast<int>(KinectOption::ConvertIntoScreenLength(
-      cWidthToGetTempBedNormal,  // ID.
-      clickedDepth));            // Depth at ID.
-
-  // Average normals around the clicked position.
-  Vector normalSum;
-  for (int dy = -currentSize / 2; dy < currentSize / 2; ++dy) {
-    for (int dx = -currentSize / 2; dx < currentSize / 2; ++dx) {
-      int id = KinectOption::GetNextId(clickedId, dx, dy);
-      Vector normal = KinectOption::CalculateNormal(id, m_pBackground);
-      normal = normal.Normalize();
-      normalSum = normalSum.Add(normal);
-    }
-  }
-  
-  bool isInvalid = (0.0 == normalSum.Length());
-  if (isInvalid) {
-    InitializeAllNext();
-    return normalSum;
-  }
-  return normalSum.Normalize();
-}
-
-void Observer::GetAverageBedNormal() {
-  // Average normals on the bed area.
-  Vector normalSum;
-  for (int i = 0; i < KinectOption::cDepthBufferSize; ++i) {
-    if (IsInnerBed(i)) {
-      Vector normal = KinectOption::CalculateNormal(i, m_pBackground);
-      normal = normal.Normalize();
-      normalSum = normalSum.Add(normal);
-    }
-  }
-
-  bool isInvalid = (0.0 == normalSum.Length());
-  if (isInvalid) {
-    InitializeAllNext();
-    return;
-  }
-  m_bedNormal = normalSum.Normalize();
-}
-
-void Observer::GetAverageQuiltHeight(const UINT16 *pBuffer) {
-  static const double cAirRatio = 0.1;
-  double sumHeight = 0.0;
-  int counter = 0;
-  for (int i = 0; i < KinectOption::cDepthBufferSize; ++i) {
-    double height;
-    if (IsOnBed(i, pBuffer[i], &height)) {
-      sumHeight += height;
-      ++counter;
-    }
-  }
-  m_quiltHeight = sumHeight / counter * (1.0 - cAirRatio);
-}
-
-void Observer::CalculateCoordinatesOfBedCorners() {
-  m_coordinatesBedCorners.clear();
-  for (int i = 0; i < static_cast<int>(m_bedCorners.size()); ++i) {
-    int id = m_bedCorners[i];
-    int depth = m_pBackground[id];
-    Vector coordinates = KinectOption::ConvertIntoWorldCoordinates(id, depth);
-    m_coordinatesBedCorners.push_back(coordinates);
-  }
-}
-
-bool Observer::IsInnerBed(int id) const {
-  if (!IsBedAreaDefined())
-    return false;
-
-  // With crossing number algorithm.
-  // http://geomalgorithms.com/a03-_inclusion.html
-  // Count the number of intersections.
-  int numIntersections = 0;
-  int x = KinectOption::GetX(id);
-  int y = KinectOption::GetY(id);
-  for (int i = 0; i < static_cast<int>(m_bedCorners.size()); ++i) {
-    int id1 = m_bedCorners[i];
-    int id2 = m_bedCorners[(i + 1) % m_bedCorners.size()];
-    int x1 = KinectOption::GetX(id1);
-    int y1 = KinectOption::GetY(id1);
-    int x2 = KinectOption::GetX(id2);
-    int y2 = KinectOption::GetY(id2);
-
-    // Y-coordinate of given pixel is in y-coordinates of a side.
-    bool isYInRange = (y1 <= y && y < y2) || (y2 <= y && y < y1);
-    if (isYInRange && x < x1 + 1.0 * (y - y1) / (y2 - y1) * (x2 - x1))
-      ++numIntersections;
-  }
-
-  // Judge.
-  return numIntersections % 2 == 1;
-}
-
-bool Observer::IsOnBed(int id, int depth, double *height) const {
-  if (!IsBedAreaDefined() || !KinectOption::IsAvailableDepth(depth))
-    return false;
-
-  // Convert viewport coordinates into world them.
-  Vector p = KinectOption::ConvertIntoWorldCoordinates(id, depth);
-
-  // Check whether the point is on the bed.
-  for (int i = 0; i < 2; ++i) {
-    // With the Möller–Trumbore intersection algorithm
-    // from "Practical Analysis of Optimized Ray-Triangle Intersection".
-    // http://stackoverflow.com/questions/37652337/
-    static const double cEpsilon = 1e-5;
-    Vector e1 = m_coordinatesBedCorners[2].Subtract(
-        m_coordinatesBedCorners[0]);
-    Vector e2 = m_coordinatesBedCorners[i * 2 + 1].Subtract(
-        m_coordinatesBedCorners[0]);
-    Vector qVec, pVec = m_bedNormal.Cross(e2);
-    double det = e1.Dot(pVec);
-
-    if (cEpsilon < det) {
-      Vector tVec = p.Subtract(m_coordinatesBedCorners[0]);
-      double u = tVec.Dot(pVec);
-      if (u < 0.0 || det < u)
-        continue;
-
-      qVec = tVec.Cross(e1);
-      double v = m_bedNormal.Dot(qVec);
-      if (v < 0.0 || det < u + v)
-        continue;
-    } else if (det < -cEpsilon) {
-      Vector tVec = p.Subtract(m_coordinatesBedCorners[0]);
-      double u = tVec.Dot(pVec);
-      if (0.0 < u || u < det)
-        continue;
-
-      qVec = tVec.Cross(e1);
-      double v = m_bedNormal.Dot(qVec);
-      if (0.0 < v || u + v < det)
-        continue;
-    } else {
-      continue;
-    }
-
-    // Get the distance between the given point and the intersection.
-    if (height != NULL)
-      *height = e2.Dot(qVec) / det;
-
-    return true;
-  }
-
-  return false;
-}
-
-void Observer::SearchForPatientArea(const UINT16 *pBuffer) {
-  m_patientCorners.clear();
-  if (m_headPosition == eUnknown)
-    return;
-
-  // Search for a patient area.
-  bool patient[KinectOption::cDepthBufferSize] = {false};
-  std::queue<int> task; task.push(m_headPosition);
-  std::map<int, bool> isSearched;
-  while (!task.empty()) {
-    // Pop a point.
-    int current = task.front(); task.pop();
-    patient[current] = true;
-
-    // Search for 4-neighbor of the point recursively.
-    static const int cDx[4] = {0, -1, 1, 0};
-    static const int cDy[4] = {-1, 0, 0, 1};
-    for (int i = 0; i < 4; ++i) {
-      // Skip a point checked already.
-      int next = KinectOption::GetNextId(
-          current,
-          cDx[i] * (1 + cNumSkipToSearchForPatientArea),
-          cDy[i] * (1 + cNumSkipToSearchForPatientArea));
-      if (0 < isSearched.count(next))
-        continue;
-      isSearched[next] = true;
-
-      // Skip a point whose depth has changed little.
-      if (m_pBackground[next] - pBuffer[next] <=
-          cDepthNoiseBorderToSearchForPatientArea) {
-        patient[next] = true;  // Space.
-        continue;
-      }
-
-      task.push(next);
-    }
-  }
-
-  // Find the corners of the patient area.
-  int xRange[2] = {INT_MAX, INT_MIN};  // xRange[0]: minX, xRange[1]: maxX
-  int yRange[2] = {INT_MAX, INT_MIN};  // yRange[0]: minY, yRange[1]: maxY
-  for (int y = 0; y < KinectOption::cDepthBufferHeight; ++y) {
-    for (int x = 0; x < KinectOption::cDepthBufferWidth; ++x) {
-      if (!patient[KinectOption::GetId(x, y)])
-        continue;
-      xRange[0] = min(xRange[0], x);
-      xRange[1] = max(xRange[1], x);
-      yRange[0] = min(yRange[0], y);
-      yRange[1] = max(yRange[1], y);
-    }
-  }
-  for (int xId = 0; xId < 2; ++xId) {
-    for (int yId = 0; yId < 2; ++yId) {
-      int y = xId ? yRange[1 - yId] : yRange[yId];  // To loop.
-      int corner = KinectOption::GetId(xRange[xId], y);
-      m_patientCorners.push_back(corner);
-    }
-  }
-}
-
-// TODO: Create a new class, "Plane" and "ScreenPoint"
-// and merge with "IsInnerBed()".
-bool Observer::IsInnerPatientArea(int id) const {
-  if (m_patientCorners.size() < 4)
-    return false;
-
-  // With crossing number algorithm.
-  // http://geomalgorithms.com/a03-_inclusion.html
-  // Count the number of intersections.
-  int numIntersections = 0;
-  int x = KinectOption::GetX(id);
-  int y = KinectOption::GetY(id);
-  for (int i = 0; i < static_cast<int>(m_patientCorners.size()); ++i) {
-    int id1 = m_patientCorners[i];
-    int id2 = m_patientCorners[(i + 1) % m_patientCorners.size()];
-    int x1 = KinectOption::GetX(id1);
-    int y1 = KinectOption::GetY(id1);
-    int x2 = KinectOption::GetX(id2);
-    int y2 = KinectOption::GetY(id2);
-
-    // Y-coordinate of given pixel is in y-coordinates of a side.
-    bool isYInRange = (y1 <= y && y < y2) || (y2 <= y && y < y1);
-    if (isYInRange && x < x1 + 1.0 * (y - y1) / (y2 - y1) * (x2 - x1))
-      ++numIntersections;
-  }
-
-  // Judge.
-  return numIntersections % 2 == 1;
-}
\ No newline at end of file
+﻿#include "observer.h"
+#define _USE_MATH_DEFINES  // M_PI
+#include <math.h>          // M_PI
+#include <limits.h>        // INT_MAX
+#include <algorithm>  // std::copy_n(), std::sort()
+#include <chrono>
+#include "frame_trace.h"
+#include "observer_metrics.h"
+#include "thread_pool.h"
+#include "trace_events.h"
+
+const double Observer::cBedExitLatencyBudget = 10.0;
+const char *const Observer::cStateNames[eLyingOnSide + 1] = {
+    "none", "standing", "sitting_on_edge", "sitting", "lying",
+    "lying_on_side"};
+
+// Largest head size accepted by the distance transform alone.
+static const int cMaxHeadSizeByDistance = 256;  // [px]
+
+/// <summary>
+/// Add the time since the start of a stage into metrics,
+/// and start the next stage.
+/// </summary>
+static void EndStage(ObserverMetrics *pMetrics, ObserverMetrics::Stage stage,
+                     Observer::Clock::time_point *pStageStart) {
+  if (!pMetrics)
+    return;
+  Observer::Clock::time_point now = Observer::Clock::now();
+  pMetrics->AddStageTime(stage, now - *pStageStart);
+  *pStageStart = now;
+}
+
+/// <summary>
+/// Get the least squared distance from a candidate to the nearest
+/// unchanged pixel with which the window of "IsHead()" surely holds
+/// enough changed pixels, by head size, or INT_MAX if no distance does.
+/// A window clamps onto the frame, which only brings its pixels nearer.
+/// </summary>
+static const int *GetMinSquaredDistancesOfHeads() {
+  static const std::vector<int> cDistances = []() {
+    std::vector<int> distances(cMaxHeadSizeByDistance + 1, INT_MAX);
+    std::vector<int> numPixels;  // By squared distance from the center.
+    for (int size = 2; size <= cMaxHeadSizeByDistance; ++size) {
+      // Count as "IsHead()" does.
+      int half = size / 2;
+      int minArea = static_cast<int>(
+          M_PI / 4 * static_cast<int>(pow(size, 2)));
+      numPixels.assign(2 * half * half + 1, 0);
+      for (int dy = -half; dy < half; ++dy) {
+        for (int dx = -half; dx < half; ++dx)
+          ++numPixels[dx * dx + dy * dy];
+      }
+      int area = 0;
+      for (int d = 0; d < static_cast<int>(numPixels.size()); ++d) {
+        area += numPixels[d];
+        if (minArea <= area) {
+          distances[size] = d + 1;
+          break;
+        }
+      }
+    }
+    return distances;
+  }();
+  return cDistances.data();
+}
+
+Observer::Observer(int depthBufferWidth, int depthBufferHeight)
+    : m_depthBufferWidth(depthBufferWidth),
+      m_depthBufferHeight(depthBufferHeight),
+      m_pConstants(&m_loadedConstants),
+      m_constantsGeneration(0),
+      m_pConstantsWatcher(NULL),
+      m_hasGivenConstants(false),
+      m_headPosition(eUnknown),
+      m_shoulderPosition(eUnknown),
+      m_depthAtHead(eUnknown),
+      m_relativeHeadSize(eUnknown),
+      m_quiltHeight(0.0),
+      m_kernelMode(eKernelReference),
+      m_bytesTouched(0),
+      m_pThreadPool(NULL),
+      m_headDetector(eHeadDetectorWindow),
+      m_bedExitStatistics(),
+      m_hasArrivalTime(false),
+      m_nextFrameTime(0),
+      m_frameTime(0),
+      m_qualityLevel(eQualityFull),
+      m_filteredState(eNone),
+      m_pMetrics(NULL),
+      m_pTraceRing(NULL) {
+  // Reserve containers to keep frames free of allocations.
+  m_patientCorners.reserve(cMaxCorners);
+  m_bedCorners.reserve(cMaxCorners);
+  m_coordinatesBedCorners.reserve(cMaxCorners);
+  m_logs.reserve(cMaxLogs);
+
+  InitializeAllNext();
+  ResetBedExit();
+  PublishResult();
+}
+
+Observer *Observer::Create(int depthBufferWidth, int depthBufferHeight) {
+  // Choose the specialization by the size of depth frames.
+  if (depthBufferWidth == KinectV2Profile::cDepthBufferWidth &&
+      depthBufferHeight == KinectV2Profile::cDepthBufferHeight)
+    return new BasicObserver<KinectV2Profile>();
+  if (depthBufferWidth == KinectV1Profile::cDepthBufferWidth &&
+      depthBufferHeight == KinectV1Profile::cDepthBufferHeight)
+    return new BasicObserver<KinectV1Profile>();
+  if (depthBufferWidth == AzureKinectNfovProfile::cDepthBufferWidth &&
+      depthBufferHeight == AzureKinectNfovProfile::cDepthBufferHeight)
+    return new BasicObserver<AzureKinectNfovProfile>();
+  return NULL;
+}
+
+template <class Profile>
+BasicObserver<Profile>::BasicObserver()
+    : Observer(KinectOption::cDepthBufferWidth,
+               KinectOption::cDepthBufferHeight),
+      m_pTables(new ScreenLengthTables()),
+      m_pNextTables(new ScreenLengthTables()),
+      m_nextConstantsGeneration(0) {
+  m_blockReductions.resize(cNumBlocks);
+  BuildScreenLengthTables(*m_pConstants, m_pTables.get());
+}
+
+template <class Profile>
+void BasicObserver<Profile>::Observe(const UINT16 *pBuffer,
+                                     const UINT16 *pFilled) {
+  TRACE_SCOPE("Observe");
+  // Count memory traffic in sweeps over a whole depth frame.
+  static const int cFrameBytes = sizeof(m_pDifference);
+  m_bytesTouched = 0;
+
+  // Use the same constants through a frame.
+  SwapConstants();
+
+  // Judge a bed exit roughly at first with the raw frame.
+  StartFrame();
+  Clock::time_point stageStart = m_pMetrics ? Clock::now() :
+                                              Clock::time_point();
+  PatientState previousState = GetState();
+  DetectBedExit(pBuffer, previousState);
+  EndStage(m_pMetrics, ObserverMetrics::eStageFastPath, &stageStart);
+
+  // Copy the given depth buffer and interpolate depth
+  // to protect the original.
+  // The fused kernel also calculates differences in the same pass,
+  // which is useless just before initialization.
+  bool isFused = (m_kernelMode == eKernelFused) && !m_initializeNext;
+  if (isFused) {
+    FilterAndDifferentiate(pBuffer, pFilled, m_pFrame);
+    m_bytesTouched += 4 * cFrameBytes + sizeof(m_pOnBed);
+  } else if (pFilled) {
+    memcpy(m_pFrame, pFilled, sizeof(m_pFrame));
+    m_bytesTouched += 2 * cFrameBytes;
+  } else {
+    memcpy(m_pFrame, pBuffer, sizeof(m_pFrame));
+    InterpolateDepth(m_pFrame);
+    m_bytesTouched += 6 * cFrameBytes;
+  }
+  EndStage(m_pMetrics, ObserverMetrics::eStageFilter, &stageStart);
+
+  // Initialize as needed.
+  if (m_initializeNext) {
+    Initialize(m_pFrame);
+    m_frameDecisionTime = Clock::now();
+    EndFrame(true);
+    return;
+  }
+  
+  // Get a patient's area.
+  if (!isFused) {
+    CalculateDepthDifferences(m_pFrame);
+    m_bytesTouched += 3 * cFrameBytes;
+    EndStage(m_pMetrics, ObserverMetrics::eStageDifference, &stageStart);
+  }
+  TrackHead(m_pFrame);
+  EndStage(m_pMetrics, ObserverMetrics::eStageHead, &stageStart);
+  SearchForPatientArea(m_pFrame);  // From the tracked head.
+  EndStage(m_pMetrics, ObserverMetrics::eStagePatientArea, &stageStart);
+  if (isFused) {
+    if (m_headPosition != eUnknown) {
+      MaskOutsidePatientArea(m_pFrame);  // Mask the buffer.
+      m_bytesTouched += 4 * cFrameBytes + sizeof(m_pOnBed);
+      EndStage(m_pMetrics, ObserverMetrics::eStageBackground, &stageStart);
+    }
+  } else if (m_headPosition != eUnknown) {
+    UpdateBackgroundWithoutPatient(m_pFrame);
+    CalculateDepthDifferences(m_pFrame);  // Mask the buffer.
+    m_bytesTouched += 5 * cFrameBytes;
+    EndStage(m_pMetrics, ObserverMetrics::eStageBackground, &stageStart);
+  }
+
+  // Add a new frame to draw graph within set range.
+  if (cMaxLogs <= m_logs.size())
+    m_logs.erase(m_logs.begin());
+  m_logs.push_back({});
+
+  JudgePatientState(m_pFrame);
+  PatientState judgedState = m_logs.back().state;
+  ReduceNoiseOfPatientState();
+  ConfirmBedExit(previousState, judgedState);
+  m_frameDecisionTime = Clock::now();
+  if (!isFused && m_headPosition != eUnknown)
+    m_bytesTouched += 2 * cFrameBytes;  // CalculateProbabilityOnBed().
+  EndStage(m_pMetrics, ObserverMetrics::eStageJudgement, &stageStart);
+
+  static const double cEpsilon = 1e-2;
+  bool updatesQuilt = m_qualityLevel < eQualityNoQuiltUpdate;
+  if (updatesQuilt && GetProbabilityPatientOnBed() < cEpsilon) {
+    GetAverageQuiltHeight(m_pFrame);
+    if (!isFused)
+      m_bytesTouched += cFrameBytes;
+    EndStage(m_pMetrics, ObserverMetrics::eStageQuilt, &stageStart);
+  }
+
+  EndFrame(true);
+}
+
+template <class Profile>
+void BasicObserver<Profile>::SkipFrame(const UINT16 *pBuffer) {
+  TRACE_SCOPE("SkipFrame");
+  m_bytesTouched = 0;
+  if (m_initializeNext)
+    return;
+
+  SwapConstants();
+  StartFrame();
+  Clock::time_point stageStart = m_pMetrics ? Clock::now() :
+                                              Clock::time_point();
+  DetectBedExit(pBuffer, GetState());
+  m_frameDecisionTime = Clock::now();
+  EndStage(m_pMetrics, ObserverMetrics::eStageFastPath, &stageStart);
+  EndFrame(false);
+}
+
+template <class Profile>
+void BasicObserver<Profile>::LoadFrame(const UINT16 *pBuffer) {
+  memcpy(m_pLoadedFrame, pBuffer, sizeof(m_pLoadedFrame));
+}
+
+template <class Profile>
+void BasicObserver<Profile>::RegisterBedCorners(int x, int y) {
+  TRACE_SCOPE("RegisterBedCorners");
+  Clock::time_point start = Clock::now();
+
+  // Redefine bed corners if they were registered already.
+  if (IsBedAreaDefined())
+    m_bedCorners.clear();
+
+  // Calculate the normal around the clicked point.
+  int clickedId = KinectOption::GetId(x, y);
+  Vector tempBedNormal = GetTempBedNormal(clickedId);
+
+  // Search for a bed area.
+  bool bed[KinectOption::cDepthBufferSize] = {false};
+  memset(m_pIsSearched, 0, sizeof(m_pIsSearched));
+  int numPopped = 0;
+  int numPushed = 0;
+  m_pSearchQueue[numPushed++] = clickedId;
+  while (numPopped < numPushed) {
+    // Pop a point.
+    int current = m_pSearchQueue[numPopped++];
+    bed[current] = true;
+
+    // Search for 4-neighbor of the point recursively.
+    static const int cDx[4] = {0, -1, 1, 0};
+    static const int cDy[4] = {-1, 0, 0, 1};
+    for (int i = 0; i < 4; ++i) {
+      // Skip a point checked already.
+      int next = KinectOption::GetNextId(current, cDx[i], cDy[i]);
+      if (m_pIsSearched[next])
+        continue;
+      m_pIsSearched[next] = true;
+
+      // Skip a lost depth.
+      if (!KinectOption::IsAvailableDepth(m_pBackground[next]))
+        continue;
+
+      // Calculate the normal around the current point.
+      Vector normal = KinectOption::CalculateNormal(next, m_pBackground);
+      normal = normal.Normalize();
+
+      // Calculate the angle between the normal of bed and
+      // around current point.
+      double angleDegree = tempBedNormal.AngleDegree(normal);
+
+      double distance = KinectOption::CalculateWorldDistance(
+          current, m_pBackground[current],
+          next, m_pBackground[next]);
+
+      bool isBed = distance < m_pConstants->neighborPixelsDistanceTolerance &&
+                   angleDegree < m_pConstants->normalsDegreeTolerance;
+      if (isBed)
+        m_pSearchQueue[numPushed++] = next;
+    }
+  }
+
+  // Find bed corners from the bed area.
+  double minDistance[4] = {DBL_MAX, DBL_MAX, DBL_MAX, DBL_MAX};
+  int bedCorners[4];
+  for (int i = 0; i < KinectOption::cDepthBufferSize; ++i) {
+    if (!bed[i])
+      continue;
+
+    // Regard a point that minimize the distance to
+    // a corner of the screen as a bed corner.
+    for (int j = 0; j < 4; ++j) {
+      double distance = KinectOption::CalculateScreenDistance(
+          i,
+          KinectOption::cScreenCornersId[j]);
+      if (distance < minDistance[j]) {
+        minDistance[j] = distance;
+        bedCorners[j] = i;
+      }
+    }
+  }
+
+  for (int i = 0; i < 4; ++i)
+    m_bedCorners.push_back(bedCorners[i]);
+  CalculateCoordinatesOfBedCorners();
+
+  // Recalculate a bed normal using the defined area.
+  GetAverageBedNormal();
+  if (m_pMetrics)
+    m_pMetrics->SetBedRegistrationTime(Clock::now() - start);
+  PublishResult();
+}
+
+template <class Profile>
+void BasicObserver<Profile>::WarmStart(const UINT16 *pBackground,
+                                       const std::vector<int> &bedCorners,
+                                       double quiltHeight) {
+  TRACE_SCOPE("WarmStart");
+  memcpy(m_pBackground, pBackground, sizeof(m_pBackground));
+  memset(m_pDifference, 0, sizeof(m_pDifference));
+
+  m_logs.clear();
+  m_headPosition = eUnknown;
+  m_shoulderPosition = eUnknown;
+  m_depthAtHead = eUnknown;
+  m_relativeHeadSize = eUnknown;
+  m_patientCorners.clear();
+  ResetBedExit();
+
+  LoadConstants();
+  BuildScreenLengthTables(*m_pConstants, m_pTables.get());
+
+  // Take the recorded bed instead of searching for it.
+  m_bedCorners = bedCorners;
+  CalculateCoordinatesOfBedCorners();
+  m_quiltHeight = quiltHeight;
+
+  // Prevent to initialize.
+  m_initializeNext = false;
+  m_initializeOnlyBackground = false;
+  if (IsBedAreaDefined())
+    GetAverageBedNormal();
+  PublishResult();
+}
+
+template <class Profile>
+void BasicObserver<Profile>::Initialize(const UINT16 *pBuffer) {
+  TRACE_SCOPE("Initialize");
+  if (!m_initializeNext)
+    return;
+  if (m_pMetrics)
+    m_pMetrics->AddInitialization(m_initializeOnlyBackground);
+
+  // Set current depth buffer into "m_pBackground".
+  memcpy(m_pBackground, pBuffer, sizeof(m_pBackground));
+  memset(m_pDifference, 0, sizeof(m_pDifference));
+
+  m_logs.clear();
+  ResetBedExit();
+
+  if (!m_initializeOnlyBackground) {
+    LoadConstants();
+    BuildScreenLengthTables(*m_pConstants, m_pTables.get());
+
+    // Search for a bed area around the center of the screen.
+    m_bedCorners.clear();
+    RegisterBedCorners(KinectOption::cDepthBufferXCenter,
+                       KinectOption::cDepthBufferYCenter);
+  }
+  
+  // Prevent to reinitialize.
+  m_initializeNext = false;
+  m_initializeOnlyBackground = false;
+}
+
+void Observer::LoadConstants() {
+  // The watcher has loaded the file already.
+  if (m_pConstantsWatcher) {
+    m_constantsGeneration = m_pConstantsWatcher->GetGeneration();
+    m_pWatchedConstants = m_pConstantsWatcher->GetCurrent();
+    m_pConstants = m_pWatchedConstants.get();
+    return;
+  }
+
+  // Defaults are used if the file can't be read.
+  static const char cConstantsFileUrl[] = "constants.ini";
+  if (!m_hasGivenConstants)
+    Constants::Load(cConstantsFileUrl, &m_loadedConstants);
+  m_pConstants = &m_loadedConstants;
+}
+
+template <class Profile>
+void BasicObserver<Profile>::SwapConstants() {
+  if (!m_pConstantsWatcher)
+    return;
+
+  // Swap constants and their tables together once the tables are built.
+  // Tables for an outdated snapshot are thrown away.
+  if (m_nextTablesBuilt.valid()) {
+    std::future_status status =
+        m_nextTablesBuilt.wait_for(std::chrono::seconds(0));
+    if (status != std::future_status::ready)
+      return;
+    m_nextTablesBuilt.get();
+    if (m_nextConstantsGeneration == m_pConstantsWatcher->GetGeneration()) {
+      m_pWatchedConstants = m_pNextConstants;
+      m_constantsGeneration = m_nextConstantsGeneration;
+      m_pConstants = m_pWatchedConstants.get();
+      m_pTables.swap(m_pNextTables);
+    }
+    // Let the outdated snapshot go.
+    m_pNextConstants.reset();
+  }
+
+  // Build tables for a new snapshot off the frame loop.
+  // Most frames only read the generation, since taking a snapshot
+  // may lock.
+  UINT32 generation = m_pConstantsWatcher->GetGeneration();
+  if (generation == m_constantsGeneration)
+    return;
+  m_pNextConstants = m_pConstantsWatcher->GetCurrent();
+  m_nextConstantsGeneration = generation;
+  const Constants *pNextConstants = m_pNextConstants.get();
+  ScreenLengthTables *pNextTables = m_pNextTables.get();
+  m_nextTablesBuilt = std::async(std::launch::async,
+                                 [pNextConstants, pNextTables]() {
+    BuildScreenLengthTables(*pNextConstants, pNextTables);
+  });
+}
+
+template <class Profile>
+void BasicObserver<Profile>::BuildScreenLengthTables(
+    const Constants &constants, ScreenLengthTables *pTables) {
+  for (int depth = 0; depth <= KinectOption::cMaxDepth; ++depth) {
+    pTables->pHeadSizes[depth] = static_cast<int>(
+        KinectOption::ConvertIntoScreenLength(constants.headWidth, depth));
+    pTables->pHeadToShoulderLengths[depth] = static_cast<int>(
+        KinectOption::ConvertIntoScreenLength(
+            constants.distanceHeadAndShoulder, depth));
+    pTables->pHeadToHipLengths[depth] = static_cast<int>(
+        KinectOption::ConvertIntoScreenLength(constants.distanceHeadAndHip,
+                                              depth));
+    pTables->pWindowSizesToGetNormal[depth] = static_cast<int>(
+        KinectOption::ConvertIntoScreenLength(
+            constants.widthToGetTempBedNormal, depth));
+  }
+}
+
+template <class Profile>
+int BasicObserver<Profile>::ConvertIntoScreenLength(const int *pTable,
+                                                    double length,
+                                                    int depth) const {
+  // Calculate a depth out of the valid range as it is.
+  if (depth < 0 || KinectOption::cMaxDepth < depth) {
+    return static_cast<int>(
+        KinectOption::ConvertIntoScreenLength(length, depth));
+  }
+  return pTable[depth];
+}
+
+template <class Profile>
+void BasicObserver<Profile>::InterpolateDepth(UINT16 *pBuffer) {
+  memcpy(m_pInterpolationSource, pBuffer, sizeof(m_pInterpolationSource));
+
+  RunBlocks([&](int block) {
+    int begin, end;
+    GetBlockRange(block, &begin, &end);
+    for (int i = begin; i < end; ++i) {
+      if (KinectOption::IsAvailableDepth(m_pInterpolationSource[i]))
+        continue;
+      pBuffer[i] = InterpolateDepthAt(i, m_pInterpolationSource);
+    }
+  });
+}
+
+template <class Profile>
+UINT16 BasicObserver<Profile>::InterpolateDepthAt(
+    int id, const UINT16 *pSource) const {
+  // Interpolate average depth of 8-neighbor.
+  double sumDepth = 0;
+  double sumWeight = 0;
+  static const double cWeight[8] = {0.7, 1, 0.7, 1, 1, 0.7, 1, 0.7};
+  static const int cDx[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+  static const int cDy[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+  for (int j = 0; j < 8; ++j) {
+    int next = KinectOption::GetNextId(id, cDx[j], cDy[j]);
+    if (KinectOption::IsAvailableDepth(pSource[next])) {
+      sumDepth += cWeight[j] * pSource[next];
+      sumWeight += cWeight[j];
+    }
+  }
+  return (sumWeight == 0.0) ? 0 :
+      static_cast<UINT16>(sumDepth / sumWeight);
+}
+
+template <class Profile>
+void BasicObserver<Profile>::FillHoles(const UINT16 *pSource,
+                                       UINT16 *pFilled) const {
+  RunBlocks([&](int block) {
+    int begin, end;
+    GetBlockRange(block, &begin, &end);
+    for (int i = begin; i < end; ++i) {
+      pFilled[i] = KinectOption::IsAvailableDepth(pSource[i]) ? pSource[i] :
+          InterpolateDepthAt(i, pSource);
+    }
+  });
+}
+
+template <class Profile>
+void BasicObserver<Profile>::FilterAndDifferentiate(const UINT16 *pSource,
+                                                    const UINT16 *pFilled,
+                                                    UINT16 *pBuffer) {
+  TRACE_SCOPE("FilterAndDifferentiate");
+  RunBlocks([&](int block) {
+    FilterAndDifferentiateBlock(block, pSource, pFilled, pBuffer);
+  });
+}
+
+template <class Profile>
+void BasicObserver<Profile>::FilterAndDifferentiateBlock(int block,
+                                                         const UINT16 *pSource,
+                                                         const UINT16 *pFilled,
+                                                         UINT16 *pBuffer) {
+  int begin, end;
+  GetBlockRange(block, &begin, &end);
+
+  // Interpolate depth of the block at first, unless it was shared.
+  // Holes are filled from the original, so neighbor blocks don't matter.
+  if (pFilled) {
+    memcpy(&pBuffer[begin], &pFilled[begin], (end - begin) * sizeof(UINT16));
+  } else {
+    for (int i = begin; i < end; ++i) {
+      pBuffer[i] = KinectOption::IsAvailableDepth(pSource[i]) ? pSource[i] :
+          InterpolateDepthAt(i, pSource);
+    }
+  }
+
+  // Then calculate differences and reductions
+  // while the block stays in the cache.
+  BlockReduction reduction = {};
+  for (int i = begin; i < end; ++i) {
+    double height;
+    m_pOnBed[i] = IsOnBed(i, pBuffer[i], &height);
+    if (m_pOnBed[i]) {
+      reduction.sumQuiltHeight += height;
+      ++reduction.numPixelsQuilt;
+    }
+
+    bool isCorrect = KinectOption::IsAvailableDepth(m_pBackground[i]) &&
+                     KinectOption::IsAvailableDepth(pBuffer[i]);
+    if (!isCorrect) {
+      m_pDifference[i] = 0;
+      continue;
+    }
+    int difference = max(0, m_pBackground[i] - pBuffer[i]);
+
+    // Ignore noise.
+    int noiseBorder = m_pOnBed[i] ? m_pConstants->depthOnBedNoiseBorder :
+        m_pConstants->depthNoiseBorder;
+    m_pDifference[i] = (difference < noiseBorder) ? 0 :
+        static_cast<UINT16>(difference);
+    if (0 < m_pDifference[i]) {
+      if (m_pOnBed[i])
+        ++reduction.numPixelsInnerBed;
+      else
+        ++reduction.numPixelsOuterBed;
+    }
+  }
+  m_blockReductions[block] = reduction;
+}
+
+template <class Profile>
+void BasicObserver<Profile>::MaskOutsidePatientArea(const UINT16 *pBuffer) {
+  TRACE_SCOPE("MaskOutsidePatientArea");
+  // The patient area is the rectangle made in "SearchForPatientArea()",
+  // and "IsInnerPatientArea()" reduces into this half-open range.
+  int xBegin = KinectOption::GetX(m_patientCorners[0]);
+  int yBegin = KinectOption::GetY(m_patientCorners[0]);
+  int xEnd = KinectOption::GetX(m_patientCorners[2]);
+  int yEnd = KinectOption::GetY(m_patientCorners[2]);
+  if (xEnd <= xBegin)
+    yEnd = yBegin;  // No pixel is inside.
+
+  // Update the background without the patient and mask differences,
+  // which is the same as calculating differences again.
+  RunBlocks([&](int block) {
+    BlockReduction &reduction = m_blockReductions[block];
+    reduction.numPixelsInnerBed = 0;
+    reduction.numPixelsOuterBed = 0;
+
+    int yBlockBegin = block * cRowsPerBlock;
+    int yBlockEnd = min(KinectOption::cDepthBufferHeight,
+                        yBlockBegin + cRowsPerBlock);
+    for (int y = yBlockBegin; y < yBlockEnd; ++y) {
+      int row = KinectOption::GetId(0, y);
+      bool isInnerRow = yBegin <= y && y < yEnd;
+      if (!isInnerRow) {
+        memcpy(&m_pBackground[row], &pBuffer[row],
+               KinectOption::cDepthBufferWidth * sizeof(UINT16));
+        memset(&m_pDifference[row], 0,
+               KinectOption::cDepthBufferWidth * sizeof(UINT16));
+        continue;
+      }
+
+      // Outside of the patient area on the left and right.
+      memcpy(&m_pBackground[row], &pBuffer[row], xBegin * sizeof(UINT16));
+      memset(&m_pDifference[row], 0, xBegin * sizeof(UINT16));
+      int numRight = KinectOption::cDepthBufferWidth - xEnd;
+      memcpy(&m_pBackground[row + xEnd], &pBuffer[row + xEnd],
+             numRight * sizeof(UINT16));
+      memset(&m_pDifference[row + xEnd], 0, numRight * sizeof(UINT16));
+
+      // Count changed pixels inside of the patient area.
+      for (int i = row + xBegin; i < row + xEnd; ++i) {
+        if (!IsThereSomething(i))
+          continue;
+        if (m_pOnBed[i])
+          ++reduction.numPixelsInnerBed;
+        else
+          ++reduction.numPixelsOuterBed;
+      }
+    }
+  });
+}
+
+template <class Profile>
+Observer::BlockReduction BasicObserver<Profile>::SumBlockReductions() const {
+  BlockReduction sum = {};
+  for (int i = 0; i < cNumBlocks; ++i) {
+    sum.numPixelsInnerBed += m_blockReductions[i].numPixelsInnerBed;
+    sum.numPixelsOuterBed += m_blockReductions[i].numPixelsOuterBed;
+    sum.numPixelsQuilt += m_blockReductions[i].numPixelsQuilt;
+    sum.sumQuiltHeight += m_blockReductions[i].sumQuiltHeight;
+  }
+  return sum;
+}
+
+template <class Profile>
+template <class Function>
+void BasicObserver<Profile>::RunBlocks(const Function &function) const {
+  // Trace blocks on the threads running them.
+  auto tracedFunction = [&function](int block) {
+    TRACE_SCOPE("Block");
+    function(block);
+  };
+  if (m_pThreadPool) {
+    // std::function holds a reference without allocations.
+    m_pThreadPool->ParallelFor(cNumBlocks, std::cref(tracedFunction));
+    return;
+  }
+  for (int block = 0; block < cNumBlocks; ++block)
+    tracedFunction(block);
+}
+
+template <class Profile>
+void BasicObserver<Profile>::GetBlockRange(int block, int *pBegin, int *pEnd) {
+  *pBegin = block * cRowsPerBlock * KinectOption::cDepthBufferWidth;
+  *pEnd = min(KinectOption::cDepthBufferSize,
+              *pBegin + cRowsPerBlock * KinectOption::cDepthBufferWidth);
+}
+
+template <class Profile>
+void BasicObserver<Profile>::CalculateDepthDifferences(const UINT16 *pBuffer) {
+  TRACE_SCOPE("CalculateDepthDifferences");
+  // Claculate the difference between first depth buffer and given one.
+  RunBlocks([&](int block) {
+    int begin, end;
+    GetBlockRange(block, &begin, &end);
+    for (int i = begin; i < end; ++i) {
+      bool isCorrect = KinectOption::IsAvailableDepth(m_pBackground[i]) &&
+                       KinectOption::IsAvailableDepth(pBuffer[i]);
+      if (!isCorrect) {
+        m_pDifference[i] = 0;
+      } else {
+        m_pDifference[i] = max(0, m_pBackground[i] - pBuffer[i]);
+
+        // Ignore noise.
+        if (IsOnBed(i, pBuffer[i])) {
+          if (m_pDifference[i] < m_pConstants->depthOnBedNoiseBorder)
+            m_pDifference[i] = 0;
+        } else {
+          if (m_pDifference[i] < m_pConstants->depthNoiseBorder)
+            m_pDifference[i] = 0;
+        }
+      }
+    }
+  });
+}
+
+template <class Profile>
+void BasicObserver<Profile>::UpdateBackgroundWithoutPatient(
+    const UINT16 *pBuffer) {
+  TRACE_SCOPE("UpdateBackgroundWithoutPatient");
+  if (m_headPosition == eUnknown)
+    return;
+
+  RunBlocks([&](int block) {
+    int begin, end;
+    GetBlockRange(block, &begin, &end);
+    for (int i = begin; i < end; ++i) {
+      if (!IsInnerPatientArea(i))
+        m_pBackground[i] = pBuffer[i];
+    }
+  });
+}
+
+template <class Profile>
+void BasicObserver<Profile>::JudgePatientState(const UINT16 *pBuffer) {
+  TRACE_SCOPE("JudgePatientState");
+  m_shoulderPosition = eUnknown;
+
+  // There is no head.
+  if (eUnknown == m_headPosition) {
+    m_logs.back().state = eNone;
+    return;
+  }
+
+  // There is a head. ->
+  double probabilityPatientOnBed = CalculateProbabilityOnBed(pBuffer);
+  m_logs.back().probabilityPatientOnBed = probabilityPatientOnBed;
+
+  // Judge a patient's state from probability that a patient is on a bed.
+  // The relationship is as follows.
+  // |-> 0.0     |-> borderProbabilityStanding        |-> 1.0
+  // |           |                |-> borderProbabilitySittingOnEdge
+  // | eStanding | eSittingOnEdge | eSitting = eLying |
+  PatientState state;
+  const Constants &constants = *m_pConstants;
+  if (constants.borderProbabilitySittingOnEdge < probabilityPatientOnBed) {
+    double headHeight;
+    IsOnBed(m_headPosition, m_depthAtHead, &headHeight);
+    if (constants.headHeightBorderSittingAndLying < headHeight) {
+      state = eSitting;
+    } else if (m_qualityLevel < eQualityNoLyingOnSide) {
+      state = IsLyingOnSide(pBuffer) ? eLyingOnSide : eLying;
+    } else {
+      // Keep the last lying posture without judging it.
+      bool wasLyingOnSide = 2 <= m_logs.size() &&
+          m_logs[m_logs.size() - 2].state == eLyingOnSide;
+      state = wasLyingOnSide ? eLyingOnSide : eLying;
+    }
+  } else if (constants.borderProbabilityStanding < probabilityPatientOnBed) {
+    state = eSittingOnEdge;
+  } else {
+    state = eStanding;
+  }
+
+  m_logs.back().state = state;
+}
+
+void Observer::ReduceNoiseOfPatientState() {
+  double &prevState = m_filteredState;
+  if (m_logs.size() <= 1)  // When "Initialize()" was called.
+    prevState = eNone;  // Reset a state.
+  double currentState = GetState();
+
+  // Low-pass filter.
+  static const double cFilterStrength = 0.92;
+  double newState = (1.0 - cFilterStrength) * currentState +
+      cFilterStrength * prevState;
+
+  // Convert the type of the filtered state into "PatientState".
+  m_logs.back().state = static_cast<PatientState>(static_cast<int>(
+      round(newState)));
+
+  prevState = newState;
+}
+
+void Observer::StartFrame() {
+  m_frameStartTime = Clock::now();
+  m_frameArrivalTime = m_hasArrivalTime ? m_arrivalTime : m_frameStartTime;
+  m_hasArrivalTime = false;
+  m_frameTime = m_nextFrameTime;
+  m_nextFrameTime = 0;
+}
+
+template <class Profile>
+void BasicObserver<Profile>::DetectBedExit(const UINT16 *pBuffer,
+                                           PatientState previousState) {
+  TRACE_SCOPE("DetectBedExit");
+  bool wasOnBed = eSitting <= previousState;
+  if (m_bedExitStatus != eBedExitNone || !wasOnBed || !IsBedAreaDefined()) {
+    m_numFramesBedExitSuspected = 0;
+    return;
+  }
+
+  // Count changed pixels on and off the bed in a subsampled frame
+  // as "CalculateProbabilityOnBed()" does.
+  // A patient leaving the bed appears outside of the patient area,
+  // where the background is kept up to date.
+  const Constants &constants = *m_pConstants;
+  int numPixelsInnerBed = 0;
+  int numPixelsOuterBed = 0;
+  for (int y = 0; y < KinectOption::cDepthBufferHeight;
+       y += cFastPathStride) {
+    for (int x = 0; x < KinectOption::cDepthBufferWidth;
+         x += cFastPathStride) {
+      int id = KinectOption::GetId(x, y);
+      bool isCorrect = KinectOption::IsAvailableDepth(m_pBackground[id]) &&
+                       KinectOption::IsAvailableDepth(pBuffer[id]);
+      if (!isCorrect)
+        continue;
+      int difference = m_pBackground[id] - pBuffer[id];
+      if (difference < constants.depthOnBedNoiseBorder)
+        continue;
+
+      if (IsOnBed(id, pBuffer[id]))
+        ++numPixelsInnerBed;
+      else if (constants.depthNoiseBorder <= difference)
+        ++numPixelsOuterBed;
+    }
+  }
+
+  int numPixels = numPixelsInnerBed + numPixelsOuterBed;
+  double probabilityPatientOnBed = 1.0 * numPixelsInnerBed /
+      max(1, numPixels);
+  bool isSuspected = cFastPathMinPixels <= numPixels &&
+      probabilityPatientOnBed <= constants.borderProbabilitySittingOnEdge;
+  m_numFramesBedExitSuspected = isSuspected ?
+      m_numFramesBedExitSuspected + 1 : 0;
+  if (cFastPathFramesToRaise <= m_numFramesBedExitSuspected)
+    RaiseBedExit();
+}
+
+void Observer::RaiseBedExit() {
+  m_bedExitStatus = eBedExitProvisional;
+  m_provisionalTime = Clock::now();
+  m_numFramesBedExitSuspected = 0;
+  m_numFramesSinceProvisional = 0;
+  m_numFramesJudgedOnBed = 0;
+
+  BedExitStatistics &statistics = m_bedExitStatistics;
+  double timeToAlarm = std::chrono::duration<double, std::milli>(
+      m_provisionalTime - m_frameArrivalTime).count();
+  ++statistics.numProvisional;
+  statistics.lastTimeToAlarm = timeToAlarm;
+  statistics.maxTimeToAlarm = max(statistics.maxTimeToAlarm, timeToAlarm);
+  if (cBedExitLatencyBudget < timeToAlarm)
+    ++statistics.numOverBudget;
+}
+
+void Observer::ConfirmBedExit(PatientState previousState,
+                              PatientState judgedState) {
+  PatientState state = GetState();
+  bool isOffBed = (state == eStanding || state == eSittingOnEdge);
+  BedExitStatistics &statistics = m_bedExitStatistics;
+
+  switch (m_bedExitStatus) {
+  case eBedExitNone:
+    // The fast path overlooked it.
+    if (eSitting <= previousState && isOffBed) {
+      m_bedExitStatus = eBedExitConfirmed;
+      ++statistics.numMissed;
+    }
+    break;
+
+  case eBedExitProvisional:
+    // Retract it when the full pipeline keeps judging the patient on the bed
+    // before the filtered state changes.
+    ++m_numFramesSinceProvisional;
+    m_numFramesJudgedOnBed = (eSitting <= judgedState) ?
+        m_numFramesJudgedOnBed + 1 : 0;
+    if (isOffBed) {
+      m_bedExitStatus = eBedExitConfirmed;
+      ++statistics.numConfirmed;
+      statistics.lastLeadTime = std::chrono::duration<double, std::milli>(
+          Clock::now() - m_provisionalTime).count();
+      statistics.lastLeadFrames = m_numFramesSinceProvisional;
+    } else if (cFramesToRetractBedExit <= m_numFramesJudgedOnBed ||
+               cMaxFramesToConfirmBedExit <= m_numFramesSinceProvisional) {
+      m_bedExitStatus = eBedExitNone;
+      ++statistics.numRetracted;
+    }
+    break;
+
+  case eBedExitConfirmed:
+    // Back on the bed.
+    if (eSitting <= state)
+      m_bedExitStatus = eBedExitNone;
+    break;
+  }
+}
+
+void Observer::ResetBedExit() {
+  m_bedExitStatus = eBedExitNone;
+  m_numFramesBedExitSuspected = 0;
+  m_numFramesSinceProvisional = 0;
+  m_numFramesJudgedOnBed = 0;
+}
+
+void Observer::CountFrame(bool isObserved) {
+  if (!m_pMetrics)
+    return;
+
+  // Take the state judged now as the one since the last frame.
+  Clock::time_point now = Clock::now();
+  if (m_lastFrameTime != Clock::time_point())
+    m_pMetrics->AddStateTime(GetState(), now - m_lastFrameTime);
+  m_lastFrameTime = now;
+
+  m_pMetrics->AddFrames(isObserved ? ObserverMetrics::eFrameObserved :
+                                     ObserverMetrics::eFrameSkipped, 1);
+  m_pMetrics->SetQualityLevel(m_qualityLevel);
+}
+
+void Observer::PublishResult() {
+  Result result;
+  result.state = GetState();
+  result.probabilityPatientOnBed = GetProbabilityPatientOnBed();
+  result.headPosition = m_headPosition;
+  result.shoulderPosition = m_shoulderPosition;
+  result.relativeHeadSize = m_relativeHeadSize;
+  result.numPatientCorners =
+      min(static_cast<int>(m_patientCorners.size()), cMaxCorners);
+  std::copy_n(m_patientCorners.begin(), result.numPatientCorners,
+              result.patientCorners);
+  result.numBedCorners =
+      min(static_cast<int>(m_bedCorners.size()), cMaxCorners);
+  std::copy_n(m_bedCorners.begin(), result.numBedCorners,
+              result.bedCorners);
+  result.bedNormal = m_bedNormal;
+  result.quiltHeight = m_quiltHeight;
+  result.bedExitStatus = m_bedExitStatus;
+  result.qualityLevel = m_qualityLevel;
+  result.frameTime = m_frameTime;
+  result.arrivalTime = m_frameArrivalTime;
+  m_result.Store(result);
+}
+
+void Observer::EndFrame(bool isObserved) {
+  CountFrame(isObserved);
+  PublishResult();
+  if (!m_pTraceRing)
+    return;
+
+  FrameTrace trace = {};
+  trace.frameTime = m_frameTime;
+  trace.arrivalTime = m_frameArrivalTime;
+  trace.startTime = m_frameStartTime;
+  trace.decisionTime = m_frameDecisionTime;
+  trace.publicationTime = Clock::now();
+  trace.state = GetState();
+  trace.bedExitStatus = m_bedExitStatus;
+  trace.isObserved = isObserved;
+  m_pTraceRing->Add(trace);
+}
+
+template <class Profile>
+double BasicObserver<Profile>::CalculateProbabilityOnBed(
+    const UINT16 *pBuffer) {
+  if (!IsBedAreaDefined())
+    return 0.0;
+
+  // Count the number of changed pixels.
+  // The fused kernel has already counted them.
+  if (m_kernelMode != eKernelFused) {
+    RunBlocks([&](int block) {
+      BlockReduction &reduction = m_blockReductions[block];
+      reduction.numPixelsInnerBed = 0;
+      reduction.numPixelsOuterBed = 0;
+
+      int begin, end;
+      GetBlockRange(block, &begin, &end);
+      for (int i = begin; i < end; ++i) {
+        // Skip a pixel whose depth changed little.
+        if (!IsThereSomething(i))
+          continue;
+
+        // Check whether a pixel is an inner of the bed.
+        if (IsOnBed(i, pBuffer[i]))
+          ++reduction.numPixelsInnerBed;
+        else
+          ++reduction.numPixelsOuterBed;
+      }
+    });
+  }
+  BlockReduction sum = SumBlockReductions();
+
+  // Calculate max() to avoid 0 division.
+  double probabilityPatientOnBed = 1.0 * sum.numPixelsInnerBed /
+      max(1, sum.numPixelsInnerBed + sum.numPixelsOuterBed);
+
+  return probabilityPatientOnBed;
+}
+
+template <class Profile>
+bool BasicObserver<Profile>::IsLyingOnSide(const UINT16 *pBuffer) {
+  int dxHeadAndShoulder = ConvertIntoScreenLength(
+      m_pTables->pHeadToShoulderLengths,
+      m_pConstants->distanceHeadAndShoulder, m_depthAtHead);
+  int dxHeadAndHip = ConvertIntoScreenLength(
+      m_pTables->pHeadToHipLengths, m_pConstants->distanceHeadAndHip,
+      m_depthAtHead);
+
+  // Get a body shape.
+  int direction = KinectOption::IsLeftSide(m_headPosition) ? 1 : -1;
+  int xShoulder = KinectOption::GetNextX(m_headPosition,
+                                         direction * dxHeadAndShoulder);
+  int xHip = KinectOption::GetNextX(m_headPosition, direction * dxHeadAndHip);
+  CalculateHeightProfile(pBuffer, min(xShoulder, xHip), max(xShoulder, xHip));
+
+  // Regard the lowest point in the body shape as shoulder
+  // except the point at the end, so it is judged one x line behind.
+  double shoulderHeight = DBL_MAX;
+  int xPrevious = eUnknown;
+  for (int dx = dxHeadAndShoulder; dx <= dxHeadAndHip; ++dx) {
+    int x = KinectOption::GetNextX(m_headPosition, direction * dx);
+    if (m_pColumnMaxHeight[x] == DBL_MIN)
+      continue;
+
+    if (xPrevious != eUnknown &&
+        m_pColumnMaxHeight[xPrevious] < shoulderHeight) {
+      shoulderHeight = m_pColumnMaxHeight[xPrevious];
+      m_shoulderPosition = m_pColumnMaxHeightId[xPrevious];
+    }
+    xPrevious = x;
+  }
+  if (xPrevious == eUnknown)  // There is no body.
+    shoulderHeight = 0.0;
+
+  return m_pConstants->shoulderHeightBorderTurningAndLying <
+         shoulderHeight - m_quiltHeight;
+}
+
+template <class Profile>
+void BasicObserver<Profile>::CalculateHeightProfile(const UINT16 *pBuffer,
+                                                    int xBegin, int xEnd) {
+  for (int x = xBegin; x <= xEnd; ++x)
+    m_pColumnMaxHeight[x] = DBL_MIN;
+
+  // Search for the highest point along each x line
+  // sweeping rows to access the buffer in order.
+  for (int y = 0; y < KinectOption::cDepthBufferHeight; ++y) {
+    for (int x = xBegin; x <= xEnd; ++x) {
+      int id = KinectOption::GetId(x, y);
+      double height;
+      if (IsThereSomething(id) && IsOnBed(id, pBuffer[id], &height) &&
+          m_pColumnMaxHeight[x] < height) {
+        m_pColumnMaxHeight[x] = height;
+        m_pColumnMaxHeightId[x] = id;
+      }
+    }
+  }
+}
+
+template <class Profile>
+void BasicObserver<Profile>::TrackHead(const UINT16 *pBuffer) {
+  TRACE_SCOPE("TrackHead");
+  m_headPosition = SearchForHead(pBuffer);
+  m_depthAtHead = (m_headPosition == eUnknown) ? eUnknown :
+      pBuffer[m_headPosition];
+  
+  // Calculate variables related with a head.
+  m_relativeHeadSize = eUnknown;
+  if (eUnknown != m_headPosition) {
+    m_relativeHeadSize = ConvertIntoScreenLength(
+        m_pTables->pHeadSizes, m_pConstants->headWidth, m_depthAtHead);
+  }
+}
+
+template <class Profile>
+int BasicObserver<Profile>::SearchForHead(const UINT16 *pBuffer) {
+  // Search every other pixel when degraded.
+  int step = (eQualityCoarseHeadSearch <= m_qualityLevel) ? 2 : 1;
+
+  // Then most heads are accepted by a lookup.
+  if (m_headDetector == eHeadDetectorDistance)
+    CalculateDistanceTransform(m_pDifference, m_pSquaredDistances);
+
+  // Either search counts changed pixels in every column too.
+  memset(m_pNumCandidatesInColumns, 0, sizeof(m_pNumCandidatesInColumns));
+  int headTopmost = (m_kernelMode == eKernelFused) ?
+      SortForTopmostHead(pBuffer, step) : ScanForTopmostHead(pBuffer, step);
+
+  bool isThereNoHead = (headTopmost == eUnknown);
+  if (isThereNoHead)
+    return eUnknown;
+
+  // Search for the nearest position to an edge where a head can exist
+  // if a patient is lying at a previous frame.
+  // Scan the same columns as the topmost position from either side.
+  int lastColumn = (KinectOption::cDepthBufferWidth - 1) -
+                   (KinectOption::cDepthBufferWidth - 1) % step;
+  int headNearestEdge = eUnknown;
+  for (int dx = 0; dx <= lastColumn; dx += step) {
+    int x = KinectOption::IsLeftSide(m_headPosition) ? dx : lastColumn - dx;
+
+    // Skip an empty column, and stop after the last candidate of a column.
+    int numRemaining = m_pNumCandidatesInColumns[x];
+    for (int y = 0;
+         0 < numRemaining && y < KinectOption::cDepthBufferHeight;
+         y += step) {
+      int id = KinectOption::GetId(x, y);
+      int depth = pBuffer[id];
+
+      // Check skippable of this pixel for faster searching.
+      if (!IsThereSomething(id))
+        continue;
+      --numRemaining;
+
+      // Check whether a head can be here.
+      // NOTE: This function call costs time.
+      if (IsHead(id, depth)) {
+        headNearestEdge = id;
+        break;
+      }
+    }
+    if (headNearestEdge != eUnknown)
+      break;
+  }
+  if (headNearestEdge == eUnknown)
+    return headTopmost;
+
+  // Choose the most suitable position as a head
+  // with weighting each distance.
+  // Calculate weight.
+  static const double cWeightHeadTopmostRising = 3.0;
+  double weightHeadTopmost = cWeightHeadTopmostRising;
+  bool isRising = (GetState() <= eSitting);
+  if (!isRising) {
+    double headHeight;
+    IsOnBed(m_headPosition, m_depthAtHead, &headHeight);
+    double coefficientRising =
+        headHeight / m_pConstants->headHeightBorderSittingAndLying;
+    weightHeadTopmost = coefficientRising;
+  }
+
+  // Determine a head.
+  double distanceHeadNearestEdge = KinectOption::CalculateWorldDistance(
+      headNearestEdge, pBuffer[headNearestEdge],
+      m_headPosition, m_depthAtHead);
+  double distanceHeadTopmost = KinectOption::CalculateWorldDistance(
+      headTopmost, pBuffer[headTopmost],
+      m_headPosition, m_depthAtHead);
+  return (distanceHeadNearestEdge * weightHeadTopmost < distanceHeadTopmost) ?
+      headNearestEdge : headTopmost;
+}
+
+template <class Profile>
+void BasicObserver<Profile>::CalculateDistanceTransform(
+    const UINT16 *pDifference, int *pSquaredDistances) const {
+  // Exact Euclidean distance transform in two separable passes
+  // of linear time (Meijster et al. 2000).
+  // Pixels beyond the frame count as changed like "IsThereSomething()".
+  static const int cWidth = KinectOption::cDepthBufferWidth;
+  static const int cHeight = KinectOption::cDepthBufferHeight;
+  static const int cFar = cWidth + cHeight;  // [px]
+  int *pDistances = pSquaredDistances;
+
+  // Vertical distances, down and then up row by row to keep
+  // accesses sequential.
+  for (int x = 0; x < cWidth; ++x)
+    pDistances[x] = (0 < pDifference[x]) ? cFar : 0;
+  for (int i = cWidth; i < KinectOption::cDepthBufferSize; ++i) {
+    pDistances[i] = (0 < pDifference[i]) ?
+        min(cFar, pDistances[i - cWidth] + 1) : 0;
+  }
+  for (int i = KinectOption::cDepthBufferSize - cWidth - 1; 0 <= i; --i)
+    pDistances[i] = min(pDistances[i], pDistances[i + cWidth] + 1);
+
+  // Squared distances along rows over the lower envelope of parabolas
+  // made from the vertical distances.
+  RunBlocks([&](int block) {
+    int begin, end;
+    GetBlockRange(block, &begin, &end);
+    for (int row = begin; row < end; row += cWidth) {
+      int pVertical[cWidth];
+      int pSites[cWidth];   // Apexes of parabolas on the envelope.
+      int pStarts[cWidth];  // Where they start to be the lowest.
+      memcpy(pVertical, &pDistances[row], sizeof(pVertical));
+      int *g = pVertical;
+
+      int q = 0;
+      pSites[0] = 0;
+      pStarts[0] = 0;
+      for (int u = 1; u < cWidth; ++u) {
+        while (0 <= q) {
+          int t = pStarts[q];
+          int s = pSites[q];
+          if ((t - s) * (t - s) + g[s] * g[s] <=
+              (t - u) * (t - u) + g[u] * g[u]) {
+            break;
+          }
+          --q;
+        }
+        if (q < 0) {
+          q = 0;
+          pSites[0] = u;
+          continue;
+        }
+
+        // Where the parabola of u gets lower, rounded down.
+        int s = pSites[q];
+        int numerator = u * u - s * s + g[u] * g[u] - g[s] * g[s];
+        int denominator = 2 * (u - s);
+        int separation = (0 <= numerator) ? numerator / denominator :
+            -((denominator - 1 - numerator) / denominator);
+        int start = separation + 1;
+        if (start < cWidth) {
+          ++q;
+          pSites[q] = u;
+          pStarts[q] = start;
+        }
+      }
+      for (int u = cWidth - 1; 0 <= u; --u) {
+        int s = pSites[q];
+        pDistances[row + u] = (u - s) * (u - s) + g[s] * g[s];
+        if (u == pStarts[q])
+          --q;
+      }
+    }
+  });
+}
+
+template <class Profile>
+int BasicObserver<Profile>::ScanForTopmostHead(const UINT16 *pBuffer,
+                                               int step) {
+  // Search for a topmost position where a head can exist,
+  // testing only changed pixels nearer than the head found so far.
+  int headTopmost = eUnknown;
+  int minDepth = INT_MAX;
+  for (int y = 0; y < KinectOption::cDepthBufferHeight; y += step) {
+    for (int x = 0; x < KinectOption::cDepthBufferWidth; x += step) {
+      int id = KinectOption::GetId(x, y);
+      if (!IsThereSomething(id))
+        continue;
+      ++m_pNumCandidatesInColumns[x];
+      int depth = pBuffer[id];
+      if (minDepth <= depth)
+        continue;
+
+      // Check whether a head can be here.
+      // NOTE: This function call costs time.
+      if (IsHead(id, depth)) {
+        minDepth = depth;
+        headTopmost = id;
+      }
+    }
+  }
+  return headTopmost;
+}
+
+template <class Profile>
+int BasicObserver<Profile>::SortForTopmostHead(const UINT16 *pBuffer,
+                                               int step) {
+  // Sort changed pixels by depth with a counting sort, which keeps
+  // raster order within a depth. The sensor may report depth beyond
+  // the maximum, which shares the last bucket.
+  int *pStarts = m_pCandidateStarts;
+  memset(m_pCandidateStarts, 0, sizeof(m_pCandidateStarts));
+  for (int y = 0; y < KinectOption::cDepthBufferHeight; y += step) {
+    for (int x = 0; x < KinectOption::cDepthBufferWidth; x += step) {
+      int id = KinectOption::GetId(x, y);
+      if (!IsThereSomething(id))
+        continue;
+      int depth = min(static_cast<int>(pBuffer[id]), KinectOption::cMaxDepth);
+      ++pStarts[depth + 1];
+      ++m_pNumCandidatesInColumns[x];
+    }
+  }
+  for (int depth = 1; depth <= KinectOption::cMaxDepth + 1; ++depth)
+    pStarts[depth] += pStarts[depth - 1];
+  int numCandidates = pStarts[KinectOption::cMaxDepth + 1];
+  int lastBucketStart = pStarts[KinectOption::cMaxDepth];
+  for (int y = 0; y < KinectOption::cDepthBufferHeight; y += step) {
+    for (int x = 0; x < KinectOption::cDepthBufferWidth; x += step) {
+      int id = KinectOption::GetId(x, y);
+      if (!IsThereSomething(id))
+        continue;
+      int depth = min(static_cast<int>(pBuffer[id]), KinectOption::cMaxDepth);
+      m_pCandidates[pStarts[depth]++] = id;
+    }
+  }
+
+  // Sort the last bucket by depth and raster order like the others.
+  // It is usually empty.
+  std::sort(&m_pCandidates[lastBucketStart], &m_pCandidates[numCandidates],
+            [pBuffer](int a, int b) {
+              return pBuffer[a] != pBuffer[b] ? pBuffer[a] < pBuffer[b] :
+                  a < b;
+            });
+
+  // Search for a topmost position where a head can exist,
+  // which is the first candidate passing the test.
+  for (int i = 0; i < numCandidates; ++i) {
+    // Check whether a head can be here.
+    // NOTE: This function call costs time.
+    int id = m_pCandidates[i];
+    if (IsHead(id, pBuffer[id]))
+      return id;
+  }
+  return eUnknown;
+}
+
+template <class Profile>
+bool BasicObserver<Profile>::IsHead(int id, int depth) const {
+  static const double cRatioCircumscribedSquareToCircle = M_PI / 4;
+  int currentHeadSize = ConvertIntoScreenLength(
+      m_pTables->pHeadSizes, m_pConstants->headWidth, depth);
+
+  // Accept a head far enough from unchanged pixels without counting,
+  // which gives the same result as counting.
+  if (m_headDetector == eHeadDetectorDistance &&
+      0 <= currentHeadSize && currentHeadSize <= cMaxHeadSizeByDistance &&
+      GetMinSquaredDistancesOfHeads()[currentHeadSize] <=
+          m_pSquaredDistances[id])
+    return true;
+
+  int searchArea = static_cast<int>(pow(currentHeadSize, 2));
+  int minAreaToRegardAsHead = static_cast<int>(
+      cRatioCircumscribedSquareToCircle * searchArea);
+
+  // Get depth data around the current position.
+  int area = 0;
+  int counter = 0;
+  for (int dy = -currentHeadSize / 2; dy < currentHeadSize / 2; ++dy) {
+    for (int dx = -currentHeadSize / 2; dx < currentHeadSize / 2; ++dx) {
+      int idAroundCurrent = KinectOption::GetNextId(id, dx, dy);
+      area += IsThereSomething(idAroundCurrent) ? 1 : 0;
+
+      // If the area is larger than the setting,
+      // regard the current position as a head position.
+      if (minAreaToRegardAsHead <= area)
+        return true;
+
+      // If won't find a head any more, stop searching.
+      int remainingAllArea = searchArea - (++counter);
+      int remainingNeededArea = minAreaToRegardAsHead - area;
+      if (remainingAllArea < remainingNeededArea)
+        return false;
+    }
+  }
+
+  return false;
+}
+
+template <class Profile>
+Vector BasicObserver<Profile>::GetTempBedNormal(int clickedId) {
+  int clickedDepth = m_pBackground[clickedId];
+  int currentSize = ConvertIntoScreenLength(
+      m_pTables->pWindowSizesToGetNormal,
+      m_pConstants->widthToGetTempBedNormal,  // ID.
+      clickedDepth);                          // Depth at ID.
+
+  // Average normals around the clicked position.
+  Vector normalSum;
+  for (int dy = -currentSize / 2; dy < currentSize / 2; ++dy) {
+    for (int dx = -currentSize / 2; dx < currentSize / 2; ++dx) {
+      int id = KinectOption::GetNextId(clickedId, dx, dy);
+      Vector normal = KinectOption::CalculateNormal(id, m_pBackground);
+      normal = normal.Normalize();
+      normalSum = normalSum.Add(normal);
+    }
+  }
+  
+  bool isInvalid = (0.0 == normalSum.Length());
+  if (isInvalid) {
+    InitializeAllNext();
+    return normalSum;
+  }
+  return normalSum.Normalize();
+}
+
+template <class Profile>
+void BasicObserver<Profile>::GetAverageBedNormal() {
+  // Average normals on the bed area.
+  Vector normalSum;
+  for (int i = 0; i < KinectOption::cDepthBufferSize; ++i) {
+    if (IsInnerBed(i)) {
+      Vector normal = KinectOption::CalculateNormal(i, m_pBackground);
+      normal = normal.Normalize();
+      normalSum = normalSum.Add(normal);
+    }
+  }
+
+  bool isInvalid = (0.0 == normalSum.Length());
+  if (isInvalid) {
+    InitializeAllNext();
+    return;
+  }
+  m_bedNormal = normalSum.Normalize();
+}
+
+template <class Profile>
+void BasicObserver<Profile>::GetAverageQuiltHeight(const UINT16 *pBuffer) {
+  TRACE_SCOPE("GetAverageQuiltHeight");
+  // Sum up heights by blocks in any mode,
+  // so that the order of additions doesn't depend on threads.
+  // The fused kernel has already summed them up.
+  if (m_kernelMode != eKernelFused) {
+    RunBlocks([&](int block) {
+      BlockReduction &reduction = m_blockReductions[block];
+      reduction.sumQuiltHeight = 0.0;
+      reduction.numPixelsQuilt = 0;
+
+      int begin, end;
+      GetBlockRange(block, &begin, &end);
+      for (int i = begin; i < end; ++i) {
+        double height;
+        if (IsOnBed(i, pBuffer[i], &height)) {
+          reduction.sumQuiltHeight += height;
+          ++reduction.numPixelsQuilt;
+        }
+      }
+    });
+  }
+  BlockReduction sum = SumBlockReductions();
+
+  static const double cAirRatio = 0.1;
+  m_quiltHeight = sum.sumQuiltHeight / sum.numPixelsQuilt *
+      (1.0 - cAirRatio);
+}
+
+template <class Profile>
+void BasicObserver<Profile>::CalculateCoordinatesOfBedCorners() {
+  m_coordinatesBedCorners.clear();
+  for (int i = 0; i < static_cast<int>(m_bedCorners.size()); ++i) {
+    int id = m_bedCorners[i];
+    int depth = m_pBackground[id];
+    Vector coordinates = KinectOption::ConvertIntoWorldCoordinates(id, depth);
+    m_coordinatesBedCorners.push_back(coordinates);
+  }
+}
+
+template <class Profile>
+bool BasicObserver<Profile>::IsInnerBed(int id) const {
+  if (!IsBedAreaDefined())
+    return false;
+
+  // With crossing number algorithm.
+  // http://geomalgorithms.com/a03-_inclusion.html
+  // Count the number of intersections.
+  int numIntersections = 0;
+  int x = KinectOption::GetX(id);
+  int y = KinectOption::GetY(id);
+  for (int i = 0; i < static_cast<int>(m_bedCorners.size()); ++i) {
+    int id1 = m_bedCorners[i];
+    int id2 = m_bedCorners[(i + 1) % m_bedCorners.size()];
+    int x1 = KinectOption::GetX(id1);
+    int y1 = KinectOption::GetY(id1);
+    int x2 = KinectOption::GetX(id2);
+    int y2 = KinectOption::GetY(id2);
+
+    // Y-coordinate of given pixel is in y-coordinates of a side.
+    bool isYInRange = (y1 <= y && y < y2) || (y2 <= y && y < y1);
+    if (isYInRange && x < x1 + 1.0 * (y - y1) / (y2 - y1) * (x2 - x1))
+      ++numIntersections;
+  }
+
+  // Judge.
+  return numIntersections % 2 == 1;
+}
+
+template <class Profile>
+bool BasicObserver<Profile>::IsOnBed(int id, int depth, double *height) const {
+  if (!IsBedAreaDefined() || !KinectOption::IsAvailableDepth(depth))
+    return false;
+
+  // Convert viewport coordinates into world them.
+  Vector p = KinectOption::ConvertIntoWorldCoordinates(id, depth);
+
+  // Check whether the point is on the bed.
+  for (int i = 0; i < 2; ++i) {
+    // With the Möller–Trumbore intersection algorithm
+    // from "Practical Analysis of Optimized Ray-Triangle Intersection".
+    // http://stackoverflow.com/questions/37652337/
+    static const double cEpsilon = 1e-5;
+    Vector e1 = m_coordinatesBedCorners[2].Subtract(
+        m_coordinatesBedCorners[0]);
+    Vector e2 = m_coordinatesBedCorners[i * 2 + 1].Subtract(
+        m_coordinatesBedCorners[0]);
+    Vector qVec, pVec = m_bedNormal.Cross(e2);
+    double det = e1.Dot(pVec);
+
+    if (cEpsilon < det) {
+      Vector tVec = p.Subtract(m_coordinatesBedCorners[0]);
+      double u = tVec.Dot(pVec);
+      if (u < 0.0 || det < u)
+        continue;
+
+      qVec = tVec.Cross(e1);
+      double v = m_bedNormal.Dot(qVec);
+      if (v < 0.0 || det < u + v)
+        continue;
+    } else if (det < -cEpsilon) {
+      Vector tVec = p.Subtract(m_coordinatesBedCorners[0]);
+      double u = tVec.Dot(pVec);
+      if (0.0 < u || u < det)
+        continue;
+
+      qVec = tVec.Cross(e1);
+      double v = m_bedNormal.Dot(qVec);
+      if (0.0 < v || u + v < det)
+        continue;
+    } else {
+      continue;
+    }
+
+    // Get the distance between the given point and the intersection.
+    if (height != NULL)
+      *height = e2.Dot(qVec) / det;
+
+    return true;
+  }
+
+  return false;
+}
+
+template <class Profile>
+void BasicObserver<Profile>::SearchForPatientArea(const UINT16 *pBuffer) {
+  TRACE_SCOPE("SearchForPatientArea");
+  m_patientCorners.clear();
+  if (m_headPosition == eUnknown)
+    return;
+
+  // Search for a patient area.
+  bool patient[KinectOption::cDepthBufferSize] = {false};
+  memset(m_pIsSearched, 0, sizeof(m_pIsSearched));
+  int numPopped = 0;
+  int numPushed = 0;
+  m_pSearchQueue[numPushed++] = m_headPosition;
+  while (numPopped < numPushed) {
+    // Pop a point.
+    int current = m_pSearchQueue[numPopped++];
+    patient[current] = true;
+
+    // Search for 4-neighbor of the point recursively.
+    static const int cDx[4] = {0, -1, 1, 0};
+    static const int cDy[4] = {-1, 0, 0, 1};
+    for (int i = 0; i < 4; ++i) {
+      // Skip a point checked already.
+      int next = KinectOption::GetNextId(
+          current,
+          cDx[i] * (1 + m_pConstants->numSkipToSearchForPatientArea),
+          cDy[i] * (1 + m_pConstants->numSkipToSearchForPatientArea));
+      if (m_pIsSearched[next])
+        continue;
+      m_pIsSearched[next] = true;
+
+      // Skip a point whose depth has changed little.
+      if (m_pBackground[next] - pBuffer[next] <=
+          m_pConstants->depthNoiseBorderToSearchForPatientArea) {
+        patient[next] = true;  // Space.
+        continue;
+      }
+
+      m_pSearchQueue[numPushed++] = next;
+    }
+  }
+
+  // Find the corners of the patient area.
+  int xRange[2] = {INT_MAX, INT_MIN};  // xRange[0]: minX, xRange[1]: maxX
+  int yRange[2] = {INT_MAX, INT_MIN};  // yRange[0]: minY, yRange[1]: maxY
+  for (int y = 0; y < KinectOption::cDepthBufferHeight; ++y) {
+    for (int x = 0; x < KinectOption::cDepthBufferWidth; ++x) {
+      if (!patient[KinectOption::GetId(x, y)])
+        continue;
+      xRange[0] = min(xRange[0], x);
+      xRange[1] = max(xRange[1], x);
+      yRange[0] = min(yRange[0], y);
+      yRange[1] = max(yRange[1], y);
+    }
+  }
+  for (int xId = 0; xId < 2; ++xId) {
+    for (int yId = 0; yId < 2; ++yId) {
+      int y = xId ? yRange[1 - yId] : yRange[yId];  // To loop.
+      int corner = KinectOption::GetId(xRange[xId], y);
+      m_patientCorners.push_back(corner);
+    }
+  }
+}
+
+// TODO: Create a new class, "Plane" and "ScreenPoint"
+// and merge with "IsInnerBed()".
+template <class Profile>
+bool BasicObserver<Profile>::IsInnerPatientArea(int id) const {
+  if (m_patientCorners.size() < 4)
+    return false;
+
+  // With crossing number algorithm.
+  // http://geomalgorithms.com/a03-_inclusion.html
+  // Count the number of intersections.
+  int numIntersections = 0;
+  int x = KinectOption::GetX(id);
+  int y = KinectOption::GetY(id);
+  for (int i = 0; i < static_cast<int>(m_patientCorners.size()); ++i) {
+    int id1 = m_patientCorners[i];
+    int id2 = m_patientCorners[(i + 1) % m_patientCorners.size()];
+    int x1 = KinectOption::GetX(id1);
+    int y1 = KinectOption::GetY(id1);
+    int x2 = KinectOption::GetX(id2);
+    int y2 = KinectOption::GetY(id2);
+
+    // Y-coordinate of given pixel is in y-coordinates of a side.
+    bool isYInRange = (y1 <= y && y < y2) || (y2 <= y && y < y1);
+    if (isYInRange && x < x1 + 1.0 * (y - y1) / (y2 - y1) * (x2 - x1))
+      ++numIntersections;
+  }
+
+  // Judge.
+  return numIntersections % 2 == 1;
+}
+
+template class BasicObserver<KinectV2Profile>;
+template class BasicObserver<KinectV1Profile>;
+template class BasicObserver<AzureKinectNfovProfile>;
\ No newline at end of file
@@ -1,140 +1,555 @@
-﻿#ifndef KINECT_PATIENTS_OBSERVER_OBSERVER_H_
-#define KINECT_PATIENTS_OBSERVER_OBSERVER_H_
-
-#include <vector>
-#include "vector.h"
-#include "kinect_option.h"  // KinectOption::cDepthBufferSize
-
-class Observer {
-public:
-  enum VariableStatus { eUnknown = -1 };
-  enum PatientState {
-    eNone,
-    eStanding,
-    eSittingOnEdge,
-    eSitting,
-    eLying,
-    eLyingOnSide,
-  };
-
-  /// <summary>
-  /// Frame information to draw graph.
-  /// </summary>
-  struct Log {
-    double probabilityPatientOnBed;
-    PatientState state;
-  };
-
-  // To judge a patient's state.
-  static const double cBorderProbabilityStanding;
-  static const double cBorderProbabilitySittingOnEdge;
-
-  Observer();
-
-  /// <summary>
-  /// Main processing function.
-  /// </summary>
-  /// <param name="pBuffer">pointer to depth frame data</param>
-  void Observe(const UINT16 *pBuffer);
-  /// <summary>
-  /// Register bed corners calculating the normal around a clicked point.
-  /// </summary>
-  /// <param name="x">x of a clicked point</param>
-  /// <param name="y">y of a clicked point</param>
-  void RegisterBedCorners(int x, int y);
-
-  // Accessors.
-  int GetHeadPosition() const { return m_headPosition; }
-  int GetShoulderPosition() const { return m_shoulderPosition; }
-  int GetRelativeHeadSize() const { return m_relativeHeadSize; }
-  std::vector<int> GetPatientCorners() const { return m_patientCorners; }
-  Vector GetBedNormal() const { return m_bedNormal; }
-  std::vector<int> GetBedCorners() const { return m_bedCorners; }
-  const std::vector<Log> &GetLog() const { return m_logs; }
-  PatientState GetState() const {
-    return m_logs.empty() ? eNone : m_logs.back().state;
-  }
-  double GetProbabilityPatientOnBed() const {
-    return m_logs.empty() ? 0.0 : m_logs.back().probabilityPatientOnBed;
-  }
-  bool IsThereSomething(int id) const {
-    id = max(id, 0);
-    id = min(id, KinectOption::cDepthBufferSize - 1);
-    return 0 < m_pDifference[id];
-  }
-  void InitializeAllNext() {
-    m_initializeNext = true;
-    m_initializeOnlyBackground = false;
-  }
-  void InitializeOnlyBackgroundNext() {
-    m_initializeNext = true;
-    m_initializeOnlyBackground = true;
-  }
-
-private:
-  // To get differences of depths.
-  static const int cDepthNoiseBorder;       // [mm]
-  static const int cDepthOnBedNoiseBorder;  // [mm]
-  // To search for a patient area.
-  static const int cDepthNoiseBorderToSearchForPatientArea;  // [mm]
-  static const int cNumSkipToSearchForPatientArea;
-  // To define a bed area.
-  static const int cNormalsDegreeTolerance;           // [degree]
-  static const int cNeighborPixelsDistanceTolerance;  // [mm]
-  // To find a head.
-  static const int cHeadWidth;  // [mm]
-  // To judge a patient's state.
-  static const int cShoulderHeightBorderTurningAndLying;  // [mm]
-  static const int cHeadHeightBorderSittingAndLying;      // [mm]
-  static const int cDistanceHeadAndShoulder;              // [mm]
-  static const int cDistanceHeadAndHip;                   // [mm]
-
-  void Initialize(const UINT16 *pBuffer);
-  void LoadConstants();
-  void InterpolateDepth(UINT16 *pBuffer) const;
-  void CalculateDepthDifferences(const UINT16 *pBuffer);
-  void UpdateBackgroundWithoutPatient(const UINT16 *pBuffer);
-  // Judge a patient's state.
-  void JudgePatientState(const UINT16 *pBuffer);
-  void ReduceNoiseOfPatientState();
-  double CalculateProbabilityOnBed(const UINT16 *pBuffer) const;
-  bool IsLyingOnSide(const UINT16 *pBuffer);
-  // Track a head.
-  void TrackHead(const UINT16 *pBuffer);
-  int SearchForHead(const UINT16 *pBuffer) const;
-  bool IsHead(int id, int depth) const;
-  // Register a bed.
-  Vector GetTempBedNormal(int clickedId);
-  void GetAverageBedNormal();
-  void GetAverageQuiltHeight(const UINT16 *pBuffer);
-  void CalculateCoordinatesOfBedCorners();
-  bool IsInnerBed(int id) const;
-  bool IsOnBed(int id, int depth, double *height = NULL) const;
-  bool IsBedAreaDefined() const {
-    return 4 <= m_bedCorners.size() && 4 <= m_coordinatesBedCorners.size();
-  }
-  // Search for a patient.
-  void SearchForPatientArea(const UINT16 *pBuffer);
-  bool IsInnerPatientArea(int id) const;
-
-  // To get difference of depths.
-  bool m_initializeNext;
-  bool m_initializeOnlyBackground;
-  UINT16 m_pBackground[KinectOption::cDepthBufferSize];  // [mm]
-  UINT16 m_pDifference[KinectOption::cDepthBufferSize];  // [mm]
-  // Patient.
-  int m_headPosition;
-  int m_shoulderPosition;
-  int m_depthAtHead;       // [mm]
-  int m_relativeHeadSize;  // [px]
-  std::vector<int> m_patientCorners;
-  // Bed area.
-  double m_quiltHeight;
-  Vector m_bedNormal;
-  std::vector<int> m_bedCorners;
-  std::vector<Vector> m_coordinatesBedCorners;
-  // To draw graph.
-  std::vector<Log> m_logs;
-};
-
+﻿#ifndef KINECT_PATIENTS_OBSERVER_OBSERVER_H_
+#define KINECT_PATIENTS_OBSERVER_OBSERVER_H_
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+#include "vector.h"
+#include "constants.h"
+#include "kinect_option.h"  // BasicKinectOption
+#include "seqlock.h"
+
+class FrameTraceRing;
+class ObserverMetrics;
+class ThreadPool;
+
+/// <summary>
+/// Estimates a patient's state from depth frames.
+/// Use "Create()" to get the pipeline compiled for the sensor.
+/// </summary>
+class Observer {
+public:
+  enum VariableStatus { eUnknown = -1 };
+  enum PatientState {
+    eNone,
+    eStanding,
+    eSittingOnEdge,
+    eSitting,
+    eLying,
+    eLyingOnSide,
+  };
+
+  /// <summary>
+  /// Frame information to draw graph.
+  /// </summary>
+  struct Log {
+    double probabilityPatientOnBed;
+    PatientState state;
+  };
+  /// <summary>
+  /// How the pixel-wise stages sweep a frame.
+  /// eKernelReference runs every stage as its own full-frame pass,
+  /// and scans changed pixels for the nearest head.
+  /// eKernelFused fills holes, calculates differences and accumulates
+  /// reductions in one row-blocked pass, and tests changed pixels
+  /// sorted by depth for a head.
+  /// </summary>
+  enum KernelMode {
+    eKernelReference,
+    eKernelFused,
+  };
+  /// <summary>
+  /// How a head is told from other changed pixels.
+  /// eHeadDetectorWindow counts changed pixels in a window as large
+  /// as a head around every candidate.
+  /// eHeadDetectorDistance takes a distance transform of changed pixels
+  /// once per frame to accept candidates far from unchanged pixels
+  /// without counting, with the same results.
+  /// </summary>
+  enum HeadDetector {
+    eHeadDetectorWindow,
+    eHeadDetectorDistance,
+  };
+  /// <summary>
+  /// Bed exit raised by the fast path ahead of the full pipeline.
+  /// </summary>
+  enum BedExitStatus {
+    eBedExitNone,
+    eBedExitProvisional,  // Raised by the fast path.
+    eBedExitConfirmed,    // Confirmed by the full pipeline.
+  };
+  /// <summary>
+  /// Instrumentation of the bed exit fast path.
+  /// </summary>
+  struct BedExitStatistics {
+    int numProvisional;
+    int numConfirmed;
+    int numRetracted;
+    int numMissed;            // Confirmed without a provisional one.
+    int numOverBudget;        // Raised later than the latency budget.
+    double lastTimeToAlarm;   // [ms] From the arrival of the frame.
+    double maxTimeToAlarm;    // [ms]
+    double lastLeadTime;      // [ms] Ahead of the full pipeline.
+    int lastLeadFrames;
+  };
+  /// <summary>
+  /// Steps of degradation to keep up with frames.
+  /// Each level includes the lower ones, and bed exits are kept
+  /// judged on every frame at any level.
+  /// </summary>
+  enum QualityLevel {
+    eQualityFull,
+    eQualityNoLyingOnSide,     // Keep the last lying posture.
+    eQualityNoQuiltUpdate,     // Keep the last quilt height.
+    eQualityCoarseHeadSearch,  // Search for a head every other pixel.
+    eQualityHalfFrameRate,     // Skip every other frame.
+    eNumQualityLevels,
+  };
+  typedef std::chrono::steady_clock Clock;
+
+  // Corners of the bed and the patient area.
+  static const int cMaxCorners = 4;
+
+  /// <summary>
+  /// Results of a frame published for readers on any thread,
+  /// with corners in fixed-size arrays to copy without allocations.
+  /// </summary>
+  struct Result {
+    PatientState state;
+    double probabilityPatientOnBed;
+    int headPosition;
+    int shoulderPosition;
+    int relativeHeadSize;  // [px]
+    int patientCorners[cMaxCorners];
+    int numPatientCorners;
+    int bedCorners[cMaxCorners];
+    int numBedCorners;
+    Vector bedNormal;
+    double quiltHeight;  // [mm]
+    BedExitStatus bedExitStatus;
+    QualityLevel qualityLevel;
+    // The frame judged.
+    INT64 frameTime;  // [100 ns] Of the sensor, or 0 if unknown.
+    Clock::time_point arrivalTime;
+  };
+  // To raise a bed exit.
+  static const double cBedExitLatencyBudget;  // [ms]
+  // Names of "PatientState" in reports, e.g. "sitting_on_edge".
+  static const char *const cStateNames[eLyingOnSide + 1];
+
+  /// <summary>
+  /// Create the observer specialized for the sensor profile
+  /// whose depth frame has the given size.
+  /// </summary>
+  /// <param name="depthBufferWidth">width of depth frames</param>
+  /// <param name="depthBufferHeight">height of depth frames</param>
+  /// <returns>new observer, or NULL for an unsupported sensor</returns>
+  static Observer *Create(int depthBufferWidth, int depthBufferHeight);
+  virtual ~Observer() {}
+
+  /// <summary>
+  /// Main processing function.
+  /// </summary>
+  /// <param name="pBuffer">pointer to depth frame data</param>
+  virtual void Observe(const UINT16 *pBuffer) = 0;
+  /// <summary>
+  /// Main processing function for a frame whose holes were filled
+  /// by "FillHoles()" already, to share the work among observers.
+  /// </summary>
+  /// <param name="pBuffer">pointer to depth frame data</param>
+  /// <param name="pFilled">the frame with holes filled</param>
+  virtual void Observe(const UINT16 *pBuffer, const UINT16 *pFilled) = 0;
+  /// <summary>
+  /// Fill holes of a frame as "Observe()" does.
+  /// </summary>
+  /// <param name="pSource">pointer to depth frame data</param>
+  /// <param name="pFilled">the frame with holes filled</param>
+  virtual void FillHoles(const UINT16 *pSource, UINT16 *pFilled) const = 0;
+  /// <summary>
+  /// Skip the full pipeline for a frame,
+  /// judging only a bed exit by the fast path.
+  /// </summary>
+  /// <param name="pBuffer">pointer to depth frame data</param>
+  virtual void SkipFrame(const UINT16 *pBuffer) = 0;
+  /// <summary>
+  /// Copy a frame into the observer, e.g. out of memory that another
+  /// process may overwrite, to observe it by "ObserveLoadedFrame()".
+  /// </summary>
+  /// <param name="pBuffer">pointer to depth frame data</param>
+  virtual void LoadFrame(const UINT16 *pBuffer) = 0;
+  /// <summary>
+  /// Observe the frame copied by "LoadFrame()".
+  /// </summary>
+  virtual void ObserveLoadedFrame() = 0;
+  /// <summary>
+  /// Register bed corners calculating the normal around a clicked point.
+  /// </summary>
+  /// <param name="x">x of a clicked point</param>
+  /// <param name="y">y of a clicked point</param>
+  virtual void RegisterBedCorners(int x, int y) = 0;
+  virtual bool IsThereSomething(int id) const = 0;
+  /// <summary>
+  /// Start from a recorded state instead of initializing with a frame.
+  /// </summary>
+  /// <param name="pBackground">background depth frame</param>
+  /// <param name="bedCorners">ids of bed corners, or empty</param>
+  /// <param name="quiltHeight">height of a quilt on the bed</param>
+  virtual void WarmStart(const UINT16 *pBackground,
+                         const std::vector<int> &bedCorners,
+                         double quiltHeight) = 0;
+  virtual const UINT16 *GetBackground() const = 0;
+  /// <summary>
+  /// Differences from the background of the last frame,
+  /// nonzero where "IsThereSomething()".
+  /// </summary>
+  virtual const UINT16 *GetDifference() const = 0;
+  /// <summary>
+  /// Calculate squared distances from every pixel to the nearest
+  /// unchanged one, as the distance head detector does.
+  /// </summary>
+  /// <param name="pDifference">differences of the frame size,
+  /// nonzero where changed</param>
+  /// <param name="pSquaredDistances">squared distances in pixels,
+  /// of the frame size</param>
+  virtual void CalculateDistanceTransform(
+      const UINT16 *pDifference, int *pSquaredDistances) const = 0;
+
+  /// <summary>
+  /// Copy the latest published results without locks.
+  /// Unlike the other accessors, it can be called while observing
+  /// on another thread.
+  /// </summary>
+  /// <param name="pResult">copied results</param>
+  /// <returns>number of results published until the copied one,
+  /// to tell new results</returns>
+  UINT32 GetResult(Result *pResult) const {
+    return m_result.Load(pResult);
+  }
+
+  // Accessors.
+  int GetDepthBufferWidth() const { return m_depthBufferWidth; }
+  int GetDepthBufferHeight() const { return m_depthBufferHeight; }
+  int GetHeadPosition() const { return m_headPosition; }
+  int GetShoulderPosition() const { return m_shoulderPosition; }
+  int GetRelativeHeadSize() const { return m_relativeHeadSize; }
+  std::vector<int> GetPatientCorners() const { return m_patientCorners; }
+  Vector GetBedNormal() const { return m_bedNormal; }
+  std::vector<int> GetBedCorners() const { return m_bedCorners; }
+  double GetQuiltHeight() const { return m_quiltHeight; }
+  const std::vector<Log> &GetLog() const { return m_logs; }
+  PatientState GetState() const {
+    return m_logs.empty() ? eNone : m_logs.back().state;
+  }
+  double GetProbabilityPatientOnBed() const {
+    return m_logs.empty() ? 0.0 : m_logs.back().probabilityPatientOnBed;
+  }
+  /// <summary>
+  /// Thresholds used for the last frame.
+  /// </summary>
+  const Constants &GetConstants() const { return *m_pConstants; }
+  /// <summary>
+  /// Take new constants from the watcher at frame boundaries
+  /// instead of loading the file on initialization.
+  /// </summary>
+  /// <param name="pWatcher">watcher outliving the observer,
+  /// or NULL to load the file on initialization</param>
+  void SetConstantsWatcher(const ConstantsWatcher *pWatcher) {
+    m_pConstantsWatcher = pWatcher;
+  }
+  /// <summary>
+  /// Use the given constants from the next initialization
+  /// instead of loading the file, e.g. to compare settings.
+  /// </summary>
+  void SetConstants(const Constants &constants) {
+    m_loadedConstants = constants;
+    m_hasGivenConstants = true;
+  }
+  void InitializeAllNext() {
+    m_initializeNext = true;
+    m_initializeOnlyBackground = false;
+  }
+  void InitializeOnlyBackgroundNext() {
+    m_initializeNext = true;
+    m_initializeOnlyBackground = true;
+  }
+  BedExitStatus GetBedExitStatus() const { return m_bedExitStatus; }
+  const BedExitStatistics &GetBedExitStatistics() const {
+    return m_bedExitStatistics;
+  }
+  /// <summary>
+  /// Set when the next frame arrived to measure the time to alarm.
+  /// Without it, the time is measured from the call of "Observe()".
+  /// </summary>
+  void SetArrivalTime(Clock::time_point arrivalTime) {
+    m_arrivalTime = arrivalTime;
+    m_hasArrivalTime = true;
+  }
+  /// <summary>
+  /// Set when the sensor took the next frame, e.g. its RelativeTime,
+  /// to pass it on to the result and the trace.
+  /// </summary>
+  /// <param name="frameTime">time of the sensor in 100 ns</param>
+  void SetFrameTime(INT64 frameTime) { m_nextFrameTime = frameTime; }
+  QualityLevel GetQualityLevel() const { return m_qualityLevel; }
+  void SetQualityLevel(QualityLevel level) { m_qualityLevel = level; }
+  KernelMode GetKernelMode() const { return m_kernelMode; }
+  void SetKernelMode(KernelMode mode) { m_kernelMode = mode; }
+  HeadDetector GetHeadDetector() const { return m_headDetector; }
+  void SetHeadDetector(HeadDetector detector) { m_headDetector = detector; }
+  /// <summary>
+  /// Estimated bytes the last frame read and wrote over the frame buffers.
+  /// </summary>
+  int GetBytesTouched() const { return m_bytesTouched; }
+  /// <summary>
+  /// Run pixel-wise stages over bands of rows in parallel.
+  /// Results are identical to the serial execution.
+  /// </summary>
+  /// <param name="pThreadPool">shared pool, or NULL to run serially</param>
+  void SetThreadPool(ThreadPool *pThreadPool) { m_pThreadPool = pThreadPool; }
+  /// <summary>
+  /// Count frames and time stages into metrics.
+  /// </summary>
+  /// <param name="pMetrics">metrics outliving the observer,
+  /// or NULL not to measure</param>
+  void SetMetrics(ObserverMetrics *pMetrics) { m_pMetrics = pMetrics; }
+  /// <summary>
+  /// Trace times of every frame from its arrival to the result.
+  /// </summary>
+  /// <param name="pTraceRing">ring outliving the observer,
+  /// or NULL not to trace</param>
+  void SetTraceRing(FrameTraceRing *pTraceRing) { m_pTraceRing = pTraceRing; }
+
+protected:
+  // To run the fused kernel.
+  static const int cRowsPerBlock = 8;
+  // To raise a bed exit.
+  static const int cFastPathStride = 4;  // [px]
+  static const int cFastPathMinPixels = 16;
+  static const int cFastPathFramesToRaise = 2;
+  static const int cFramesToRetractBedExit = 10;
+  static const int cMaxFramesToConfirmBedExit = 90;
+  // To draw graph.
+  static const int cMaxLogs = 100;
+
+  /// <summary>
+  /// Partial sums accumulated over a block of rows.
+  /// They are combined in block order to keep the results deterministic.
+  /// </summary>
+  struct BlockReduction {
+    int numPixelsInnerBed;
+    int numPixelsOuterBed;
+    int numPixelsQuilt;
+    double sumQuiltHeight;
+  };
+
+  Observer(int depthBufferWidth, int depthBufferHeight);
+
+  void LoadConstants();
+  void ReduceNoiseOfPatientState();
+  // Bed exit.
+  void StartFrame();
+  void RaiseBedExit();
+  void ConfirmBedExit(PatientState previousState, PatientState judgedState);
+  void ResetBedExit();
+  /// <summary>
+  /// Publish the current results for "GetResult()".
+  /// </summary>
+  void PublishResult();
+  /// <summary>
+  /// Count a frame and the time of the patient's state until it.
+  /// </summary>
+  /// <param name="isObserved">whether the frame went through
+  /// the full pipeline, or skipped it</param>
+  void CountFrame(bool isObserved);
+  /// <summary>
+  /// Count, publish and trace a frame.
+  /// </summary>
+  /// <param name="isObserved">whether the frame went through
+  /// the full pipeline, or skipped it</param>
+  void EndFrame(bool isObserved);
+  bool IsBedAreaDefined() const {
+    return 4 <= m_bedCorners.size() && 4 <= m_coordinatesBedCorners.size();
+  }
+
+  // Screen.
+  int m_depthBufferWidth;   // [px]
+  int m_depthBufferHeight;  // [px]
+  // Thresholds, which point to "m_loadedConstants" or a snapshot
+  // of "m_pConstantsWatcher".
+  Constants m_loadedConstants;
+  const Constants *m_pConstants;
+  std::shared_ptr<const Constants> m_pWatchedConstants;  // Held snapshot.
+  UINT32 m_constantsGeneration;  // Of "m_pWatchedConstants".
+  const ConstantsWatcher *m_pConstantsWatcher;
+  bool m_hasGivenConstants;
+  // To get difference of depths.
+  bool m_initializeNext;
+  bool m_initializeOnlyBackground;
+  // Patient.
+  int m_headPosition;
+  int m_shoulderPosition;
+  int m_depthAtHead;       // [mm]
+  int m_relativeHeadSize;  // [px]
+  std::vector<int> m_patientCorners;
+  // Bed area.
+  double m_quiltHeight;
+  Vector m_bedNormal;
+  std::vector<int> m_bedCorners;
+  std::vector<Vector> m_coordinatesBedCorners;
+  // To draw graph.
+  std::vector<Log> m_logs;
+  // Fused kernel.
+  KernelMode m_kernelMode;
+  std::vector<BlockReduction> m_blockReductions;
+  int m_bytesTouched;
+  ThreadPool *m_pThreadPool;
+  // Head.
+  HeadDetector m_headDetector;
+  // Bed exit.
+  BedExitStatus m_bedExitStatus;
+  BedExitStatistics m_bedExitStatistics;
+  Clock::time_point m_arrivalTime;
+  bool m_hasArrivalTime;
+  Clock::time_point m_frameArrivalTime;
+  Clock::time_point m_frameStartTime;
+  Clock::time_point m_frameDecisionTime;
+  INT64 m_nextFrameTime;  // [100 ns]
+  INT64 m_frameTime;      // [100 ns]
+  Clock::time_point m_provisionalTime;
+  int m_numFramesBedExitSuspected;
+  int m_numFramesSinceProvisional;
+  int m_numFramesJudgedOnBed;
+  // Degradation.
+  QualityLevel m_qualityLevel;
+  // Low-pass filtered state, kept per observer.
+  double m_filteredState;
+  // Published results.
+  SeqLock<Result> m_result;
+  // Metrics.
+  ObserverMetrics *m_pMetrics;
+  Clock::time_point m_lastFrameTime;
+  // Tracing.
+  FrameTraceRing *m_pTraceRing;
+};
+
+/// <summary>
+/// The pipeline of Observer compiled for a sensor profile,
+/// so that loop bounds and strides are constants.
+/// Instantiated for the profiles in sensor_profile.h.
+/// </summary>
+template <class Profile>
+class BasicObserver final : public Observer {
+public:
+  typedef BasicKinectOption<Profile> KinectOption;
+
+  BasicObserver();
+
+  void Observe(const UINT16 *pBuffer) override { Observe(pBuffer, NULL); }
+  void Observe(const UINT16 *pBuffer, const UINT16 *pFilled) override;
+  void FillHoles(const UINT16 *pSource, UINT16 *pFilled) const override;
+  void SkipFrame(const UINT16 *pBuffer) override;
+  void LoadFrame(const UINT16 *pBuffer) override;
+  void ObserveLoadedFrame() override { Observe(m_pLoadedFrame, NULL); }
+  void RegisterBedCorners(int x, int y) override;
+  bool IsThereSomething(int id) const override {
+    id = max(id, 0);
+    id = min(id, KinectOption::cDepthBufferSize - 1);
+    return 0 < m_pDifference[id];
+  }
+  void WarmStart(const UINT16 *pBackground,
+                 const std::vector<int> &bedCorners,
+                 double quiltHeight) override;
+  const UINT16 *GetBackground() const override { return m_pBackground; }
+  const UINT16 *GetDifference() const override { return m_pDifference; }
+  void CalculateDistanceTransform(const UINT16 *pDifference,
+                                  int *pSquaredDistances) const override;
+
+private:
+  static const int cNumBlocks =
+      (KinectOption::cDepthBufferHeight + cRowsPerBlock - 1) / cRowsPerBlock;
+
+  /// <summary>
+  /// Screen lengths of physical constants indexed by depth
+  /// in the valid range.
+  /// </summary>
+  struct ScreenLengthTables {
+    int pHeadSizes[KinectOption::cMaxDepth + 1];               // [px]
+    int pHeadToShoulderLengths[KinectOption::cMaxDepth + 1];   // [px]
+    int pHeadToHipLengths[KinectOption::cMaxDepth + 1];        // [px]
+    int pWindowSizesToGetNormal[KinectOption::cMaxDepth + 1];  // [px]
+  };
+
+  void Initialize(const UINT16 *pBuffer);
+  // Bed exit fast path.
+  void DetectBedExit(const UINT16 *pBuffer, PatientState previousState);
+  // Constants.
+  void SwapConstants();
+  static void BuildScreenLengthTables(const Constants &constants,
+                                      ScreenLengthTables *pTables);
+  int ConvertIntoScreenLength(const int *pTable, double length,
+                              int depth) const;
+  void InterpolateDepth(UINT16 *pBuffer);
+  UINT16 InterpolateDepthAt(int id, const UINT16 *pSource) const;
+  // Fused kernel.
+  void FilterAndDifferentiate(const UINT16 *pSource, const UINT16 *pFilled,
+                              UINT16 *pBuffer);
+  void FilterAndDifferentiateBlock(int block, const UINT16 *pSource,
+                                   const UINT16 *pFilled,
+                                   UINT16 *pBuffer);
+  void MaskOutsidePatientArea(const UINT16 *pBuffer);
+  BlockReduction SumBlockReductions() const;
+  template <class Function>
+  void RunBlocks(const Function &function) const;
+  static void GetBlockRange(int block, int *pBegin, int *pEnd);
+  void CalculateDepthDifferences(const UINT16 *pBuffer);
+  void UpdateBackgroundWithoutPatient(const UINT16 *pBuffer);
+  // Judge a patient's state.
+  void JudgePatientState(const UINT16 *pBuffer);
+  double CalculateProbabilityOnBed(const UINT16 *pBuffer);
+  bool IsLyingOnSide(const UINT16 *pBuffer);
+  void CalculateHeightProfile(const UINT16 *pBuffer, int xBegin, int xEnd);
+  // Track a head.
+  void TrackHead(const UINT16 *pBuffer);
+  int SearchForHead(const UINT16 *pBuffer);
+  int ScanForTopmostHead(const UINT16 *pBuffer, int step);
+  int SortForTopmostHead(const UINT16 *pBuffer, int step);
+  bool IsHead(int id, int depth) const;
+  // Register a bed.
+  Vector GetTempBedNormal(int clickedId);
+  void GetAverageBedNormal();
+  void GetAverageQuiltHeight(const UINT16 *pBuffer);
+  void CalculateCoordinatesOfBedCorners();
+  bool IsInnerBed(int id) const;
+  bool IsOnBed(int id, int depth, double *height = NULL) const;
+  // Search for a patient.
+  void SearchForPatientArea(const UINT16 *pBuffer);
+  bool IsInnerPatientArea(int id) const;
+
+  // Frames, kept here since they are too large for the stack
+  // with some profiles.
+  UINT16 m_pFrame[KinectOption::cDepthBufferSize];               // [mm]
+  UINT16 m_pLoadedFrame[KinectOption::cDepthBufferSize];          // [mm]
+  UINT16 m_pInterpolationSource[KinectOption::cDepthBufferSize];  // [mm]
+  // To get difference of depths.
+  UINT16 m_pBackground[KinectOption::cDepthBufferSize];  // [mm]
+  UINT16 m_pDifference[KinectOption::cDepthBufferSize];  // [mm]
+  // Height profile, the highest point above the bed along each x line.
+  double m_pColumnMaxHeight[KinectOption::cDepthBufferWidth];  // [mm]
+  int m_pColumnMaxHeightId[KinectOption::cDepthBufferWidth];
+  // Fused kernel.
+  bool m_pOnBed[KinectOption::cDepthBufferSize];
+  // Changed pixels sorted by depth to search for a head,
+  // candidates at a depth start at the index of the depth.
+  // Depth beyond the maximum shares the last one.
+  int m_pCandidateStarts[KinectOption::cMaxDepth + 2];
+  int m_pCandidates[KinectOption::cDepthBufferSize];
+  int m_pNumCandidatesInColumns[KinectOption::cDepthBufferWidth];
+  // Squared distances from changed pixels to the nearest unchanged one,
+  // for the distance transform head detector.
+  int m_pSquaredDistances[KinectOption::cDepthBufferSize];  // [px^2]
+  // Flood fills, a point is pushed once besides the seed.
+  int m_pSearchQueue[KinectOption::cDepthBufferSize + 1];
+  bool m_pIsSearched[KinectOption::cDepthBufferSize];
+  // Screen lengths for "m_pConstants".
+  std::unique_ptr<ScreenLengthTables> m_pTables;
+  // Tables built off the frame loop for "m_pNextConstants".
+  // The future is declared last to wait for the build on destruction.
+  std::unique_ptr<ScreenLengthTables> m_pNextTables;
+  std::shared_ptr<const Constants> m_pNextConstants;
+  UINT32 m_nextConstantsGeneration;
+  std::future<void> m_nextTablesBuilt;
+};
+
 #endif  // KINECT_PATIENTS_OBSERVER_OBSERVER_H_
\ No newline at end of file
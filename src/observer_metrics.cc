@@ -0,0 +1,161 @@
+﻿#include "observer_metrics.h"
+#include "atomic_file.h"
+
+const double LatencyHistogram::cBucketBounds[cNumBuckets - 1] = {
+    0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005,
+    0.01, 0.025, 0.05, 0.1, 0.25};
+
+static const char *const cStageNames[ObserverMetrics::eNumStages] = {
+    "fast_path", "filter", "difference", "head", "patient_area",
+    "background", "judgement", "quilt"};
+static const char *const cFrameResultNames[] = {
+    "observed", "skipped", "dropped"};
+
+static INT64 ToNanoseconds(Observer::Clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      duration).count();
+}
+
+static double ToSeconds(INT64 nanoseconds) {
+  return nanoseconds / 1e9;
+}
+
+LatencyHistogram::LatencyHistogram() : m_sum(0) {
+  for (std::atomic<INT64> &count : m_counts)
+    count.store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Add(Observer::Clock::duration duration) {
+  INT64 nanoseconds = ToNanoseconds(duration);
+  double seconds = ToSeconds(nanoseconds);
+  int bucket = 0;
+  while (bucket < cNumBuckets - 1 && cBucketBounds[bucket] < seconds)
+    ++bucket;
+  m_counts[bucket].fetch_add(1, std::memory_order_relaxed);
+  m_sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Write(FILE *pFile, const char *name,
+                             const char *labels) const {
+  const char *separator = labels[0] ? "," : "";
+  // Buckets are cumulative in the exposition.
+  INT64 count = 0;
+  for (int i = 0; i < cNumBuckets; ++i) {
+    count += m_counts[i].load(std::memory_order_relaxed);
+    if (i < cNumBuckets - 1) {
+      fprintf(pFile, "%s_bucket{%s%sle=\"%g\"} %lld\n", name, labels,
+              separator, cBucketBounds[i], count);
+    } else {
+      fprintf(pFile, "%s_bucket{%s%sle=\"+Inf\"} %lld\n", name, labels,
+              separator, count);
+    }
+  }
+  fprintf(pFile, "%s_sum{%s} %.9f\n", name, labels,
+          ToSeconds(m_sum.load(std::memory_order_relaxed)));
+  fprintf(pFile, "%s_count{%s} %lld\n", name, labels, count);
+}
+
+ObserverMetrics::ObserverMetrics()
+    : m_numBedRegistrations(0),
+      m_lastBedRegistrationTime(0),
+      m_qualityLevel(Observer::eQualityFull) {
+  for (std::atomic<INT64> &numFrames : m_numFrames)
+    numFrames.store(0, std::memory_order_relaxed);
+  for (std::atomic<INT64> &lastStageTime : m_lastStageTimes)
+    lastStageTime.store(0, std::memory_order_relaxed);
+  for (std::atomic<INT64> &stateTime : m_stateTimes)
+    stateTime.store(0, std::memory_order_relaxed);
+  for (std::atomic<INT64> &numInitializations : m_numInitializations)
+    numInitializations.store(0, std::memory_order_relaxed);
+}
+
+void ObserverMetrics::AddStateTime(Observer::PatientState state,
+                                   Observer::Clock::duration duration) {
+  m_stateTimes[state].fetch_add(ToNanoseconds(duration),
+                                std::memory_order_relaxed);
+}
+
+void ObserverMetrics::SetBedRegistrationTime(
+    Observer::Clock::duration duration) {
+  m_numBedRegistrations.fetch_add(1, std::memory_order_relaxed);
+  m_lastBedRegistrationTime.store(ToNanoseconds(duration),
+                                  std::memory_order_relaxed);
+}
+
+void ObserverMetrics::AddStageTime(Stage stage,
+                                   Observer::Clock::duration duration) {
+  m_stageTimes[stage].Add(duration);
+  m_lastStageTimes[stage].store(ToNanoseconds(duration),
+                                std::memory_order_relaxed);
+}
+
+void ObserverMetrics::Write(FILE *pFile) const {
+  fprintf(pFile, "# HELP observer_frames_total Depth frames by how they "
+                 "were handled.\n");
+  fprintf(pFile, "# TYPE observer_frames_total counter\n");
+  for (int i = 0; i < eNumFrameResults; ++i) {
+    fprintf(pFile, "observer_frames_total{result=\"%s\"} %lld\n",
+            cFrameResultNames[i],
+            m_numFrames[i].load(std::memory_order_relaxed));
+  }
+
+  fprintf(pFile, "# HELP observer_stage_seconds Time spent in each stage "
+                 "of a frame.\n");
+  fprintf(pFile, "# TYPE observer_stage_seconds histogram\n");
+  for (int i = 0; i < eNumStages; ++i) {
+    char labels[32];
+    sprintf_s(labels, "stage=\"%s\"", cStageNames[i]);
+    m_stageTimes[i].Write(pFile, "observer_stage_seconds", labels);
+  }
+  // The last time of "head" is the current cost of the head search.
+  fprintf(pFile, "# HELP observer_stage_last_seconds Time spent in each "
+                 "stage of the last frame through it.\n");
+  fprintf(pFile, "# TYPE observer_stage_last_seconds gauge\n");
+  for (int i = 0; i < eNumStages; ++i) {
+    fprintf(pFile, "observer_stage_last_seconds{stage=\"%s\"} %.6f\n",
+            cStageNames[i],
+            ToSeconds(m_lastStageTimes[i].load(std::memory_order_relaxed)));
+  }
+
+  fprintf(pFile, "# HELP observer_state_seconds_total Time a patient "
+                 "spent in each state.\n");
+  fprintf(pFile, "# TYPE observer_state_seconds_total counter\n");
+  for (int i = 0; i <= Observer::eLyingOnSide; ++i) {
+    fprintf(pFile, "observer_state_seconds_total{state=\"%s\"} %.3f\n",
+            Observer::cStateNames[i],
+            ToSeconds(m_stateTimes[i].load(std::memory_order_relaxed)));
+  }
+
+  fprintf(pFile, "# HELP observer_initializations_total Initializations "
+                 "of the background and the bed.\n");
+  fprintf(pFile, "# TYPE observer_initializations_total counter\n");
+  fprintf(pFile, "observer_initializations_total{kind=\"all\"} %lld\n",
+          m_numInitializations[0].load(std::memory_order_relaxed));
+  fprintf(pFile,
+          "observer_initializations_total{kind=\"background\"} %lld\n",
+          m_numInitializations[1].load(std::memory_order_relaxed));
+
+  fprintf(pFile, "# HELP observer_bed_registrations_total Registrations "
+                 "of bed corners.\n");
+  fprintf(pFile, "# TYPE observer_bed_registrations_total counter\n");
+  fprintf(pFile, "observer_bed_registrations_total %lld\n",
+          m_numBedRegistrations.load(std::memory_order_relaxed));
+  fprintf(pFile, "# HELP observer_bed_registration_seconds Duration of "
+                 "the last registration of bed corners.\n");
+  fprintf(pFile, "# TYPE observer_bed_registration_seconds gauge\n");
+  fprintf(pFile, "observer_bed_registration_seconds %.6f\n",
+          ToSeconds(m_lastBedRegistrationTime.load(
+              std::memory_order_relaxed)));
+
+
+  fprintf(pFile, "# HELP observer_quality_level Current degradation, "
+                 "0 at full quality.\n");
+  fprintf(pFile, "# TYPE observer_quality_level gauge\n");
+  fprintf(pFile, "observer_quality_level %d\n",
+          m_qualityLevel.load(std::memory_order_relaxed));
+}
+
+bool ObserverMetrics::WriteFile(const char *fileName) const {
+  return WriteFileAtomically(fileName,
+                             [this](FILE *pFile) { Write(pFile); });
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_OBSERVER_METRICS_H_
+#define KINECT_PATIENTS_OBSERVER_OBSERVER_METRICS_H_
+
+#include <stdio.h>
+#include <atomic>
+#include "observer.h"
+
+/// <summary>
+/// Counts durations in fixed buckets without locks.
+/// </summary>
+class LatencyHistogram {
+public:
+  static const int cNumBuckets = 12;
+
+  LatencyHistogram();
+
+  void Add(Observer::Clock::duration duration);
+  /// <summary>
+  /// Write the buckets, the sum and the count in the text exposition
+  /// format, in seconds.
+  /// </summary>
+  /// <param name="pFile">file to write</param>
+  /// <param name="name">name of the metric</param>
+  /// <param name="labels">labels without braces, or empty</param>
+  void Write(FILE *pFile, const char *name, const char *labels) const;
+
+private:
+  // Upper bounds of the buckets but the last, which has no bound.
+  static const double cBucketBounds[cNumBuckets - 1];  // [s]
+
+  std::atomic<INT64> m_counts[cNumBuckets];
+  std::atomic<INT64> m_sum;  // [ns]
+};
+
+/// <summary>
+/// Metrics of an observer updated on the frame loop with atomic
+/// operations only, and exposed in the Prometheus text format
+/// for a scraper, e.g. the textfile collector of node_exporter.
+/// </summary>
+class ObserverMetrics {
+public:
+  enum Stage {
+    eStageFastPath,     // Bed exit fast path.
+    eStageFilter,       // Copy, fill holes and differences when fused.
+    eStageDifference,   // Differences of the reference kernel.
+    eStageHead,         // Search for a head.
+    eStagePatientArea,  // Search for a patient area.
+    eStageBackground,   // Mask or update the background.
+    eStageJudgement,    // Judge a patient's state.
+    eStageQuilt,        // Update the quilt height.
+    eNumStages,
+  };
+  enum FrameResult {
+    eFrameObserved,  // Through the full pipeline.
+    eFrameSkipped,   // Only through the fast path to keep up.
+    eFrameDropped,   // Never arrived or came too late.
+    eNumFrameResults,
+  };
+
+  ObserverMetrics();
+
+  // Updates, safe on any thread.
+  void AddFrames(FrameResult result, int numFrames) {
+    m_numFrames[result].fetch_add(numFrames, std::memory_order_relaxed);
+  }
+  void AddStageTime(Stage stage, Observer::Clock::duration duration);
+  void AddStateTime(Observer::PatientState state,
+                    Observer::Clock::duration duration);
+  void AddInitialization(bool isOnlyBackground) {
+    m_numInitializations[isOnlyBackground ? 1 : 0].fetch_add(
+        1, std::memory_order_relaxed);
+  }
+  void SetBedRegistrationTime(Observer::Clock::duration duration);
+  void SetQualityLevel(Observer::QualityLevel level) {
+    m_qualityLevel.store(level, std::memory_order_relaxed);
+  }
+
+  /// <summary>
+  /// Write every metric in the text exposition format.
+  /// </summary>
+  void Write(FILE *pFile) const;
+  /// <summary>
+  /// Replace a file with the metrics at once,
+  /// so that a scraper never reads a partial exposition.
+  /// </summary>
+  /// <param name="fileName">path to the file</param>
+  /// <returns>whether the file was replaced</returns>
+  bool WriteFile(const char *fileName) const;
+
+private:
+  std::atomic<INT64> m_numFrames[eNumFrameResults];
+  LatencyHistogram m_stageTimes[eNumStages];
+  std::atomic<INT64> m_lastStageTimes[eNumStages];  // [ns]
+  std::atomic<INT64> m_stateTimes[Observer::eLyingOnSide + 1];  // [ns]
+  std::atomic<INT64> m_numInitializations[2];  // All, only background.
+  std::atomic<INT64> m_numBedRegistrations;
+  std::atomic<INT64> m_lastBedRegistrationTime;  // [ns]
+  std::atomic<int> m_qualityLevel;
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_OBSERVER_METRICS_H_
\ No newline at end of file
@@ -0,0 +1,165 @@
+﻿#include "parameter_sweep.h"
+#include <stdlib.h>  // strtod()
+#include <string.h>  // strcspn()
+#include <memory>
+#include "depth_sequence.h"
+#include "thread_pool.h"
+
+ParameterSweep::ParameterSweep(ThreadPool *pThreadPool)
+    : m_pThreadPool(pThreadPool),
+      m_numFramesDecoded(0),
+      m_elapsedTime(0.0) {
+}
+
+bool ParameterSweep::AddSetting(const char *name,
+                                const Constants &constants) {
+  if (cMaxSettings <= static_cast<int>(m_results.size()))
+    return false;
+  Result result = {};
+  result.name = name;
+  result.constants = constants;
+  m_results.push_back(result);
+  return true;
+}
+
+bool ParameterSweep::AddGrid(const char *fileName, const Constants &base) {
+  FILE *pFile;
+  if (fopen_s(&pFile, fileName, "r") != 0)
+    return false;
+
+  // Read values of each constant.
+  std::vector<std::string> names;
+  std::vector<std::vector<double>> values;
+  char line[512];
+  while (fgets(line, sizeof(line), pFile)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    char *pContext = NULL;
+    char *pName = strtok_s(line, " \t", &pContext);
+    Constants test;
+    if (!pName || pName[0] == '#' || !test.Set(pName, 0.0))
+      continue;
+
+    std::vector<double> valuesOfName;
+    for (char *pValue = strtok_s(NULL, " \t", &pContext); pValue;
+         pValue = strtok_s(NULL, " \t", &pContext))
+      valuesOfName.push_back(strtod(pValue, NULL));
+    if (valuesOfName.empty())
+      continue;
+    names.push_back(pName);
+    values.push_back(valuesOfName);
+  }
+  fclose(pFile);
+
+  // Refuse a grid too large rather than run a part of it.
+  size_t numCombinations = 1;
+  for (const std::vector<double> &valuesOfName : values)
+    numCombinations *= valuesOfName.size();
+  if (static_cast<size_t>(cMaxSettings) - m_results.size() < numCombinations)
+    return false;
+
+  // Count up indices of values like digits to make every combination.
+  std::vector<size_t> indices(names.size(), 0);
+  while (true) {
+    Constants constants = base;
+    std::string name;
+    for (size_t i = 0; i < names.size(); ++i) {
+      constants.Set(names[i].c_str(), values[i][indices[i]]);
+      char assignment[160];
+      sprintf_s(assignment, "%s%s=%g", name.empty() ? "" : " ",
+                names[i].c_str(), values[i][indices[i]]);
+      name += assignment;
+    }
+    constants.Correct();
+    AddSetting(name.empty() ? "base" : name.c_str(), constants);
+
+    size_t digit = 0;
+    for (; digit < names.size(); ++digit) {
+      if (++indices[digit] < values[digit].size())
+        break;
+      indices[digit] = 0;
+    }
+    if (digit == names.size())
+      break;
+  }
+  return true;
+}
+
+void ParameterSweep::Run(DepthSequence *pSequence) {
+  int numSettings = static_cast<int>(m_results.size());
+  std::vector<std::unique_ptr<Observer>> observers;
+  for (const Result &result : m_results) {
+    observers.emplace_back(Observer::Create(pSequence->GetWidth(),
+                                            pSequence->GetHeight()));
+    if (!observers.back())
+      return;
+    observers.back()->SetConstants(result.constants);
+    observers.back()->SetKernelMode(Observer::eKernelFused);
+  }
+  if (observers.empty() || !pSequence->Rewind())
+    return;
+
+  // Read-only frames shared by the observers.
+  int frameSize = pSequence->GetWidth() * pSequence->GetHeight();
+  std::vector<UINT16> frame(frameSize);
+  std::vector<UINT16> filled(frameSize);
+  std::vector<Observer::PatientState> lastStates(numSettings,
+                                                 Observer::eNone);
+  Observer::Clock::time_point start = Observer::Clock::now();
+  while (pSequence->ReadFrame(frame.data())) {
+    // Holes don't depend on constants.
+    observers[0]->FillHoles(frame.data(), filled.data());
+
+    m_pThreadPool->ParallelFor(numSettings, [&](int i) {
+      Observer *pObserver = observers[i].get();
+      Result &result = m_results[i];
+      pSequence->PrepareObserver(pObserver);
+
+      Observer::Clock::time_point observeStart = Observer::Clock::now();
+      pObserver->Observe(frame.data(), filled.data());
+      result.analysisTime += std::chrono::duration<double, std::milli>(
+          Observer::Clock::now() - observeStart).count();
+
+      Observer::PatientState state = pObserver->GetState();
+      ++result.numFrames;
+      ++result.numFramesInStates[state];
+      bool wasOnBed = Observer::eSitting <= lastStates[i];
+      bool isOffBed = state == Observer::eStanding ||
+                      state == Observer::eSittingOnEdge;
+      if (wasOnBed && isOffBed)
+        ++result.numBedExits;
+      lastStates[i] = state;
+    });
+    ++m_numFramesDecoded;
+  }
+  m_elapsedTime += std::chrono::duration<double, std::milli>(
+      Observer::Clock::now() - start).count();
+
+  // Bed exits of the fast path are counted per observer, i.e. sequence.
+  for (int i = 0; i < numSettings; ++i) {
+    const Observer::BedExitStatistics &statistics =
+        observers[i]->GetBedExitStatistics();
+    m_results[i].numProvisionalBedExits += statistics.numProvisional;
+    m_results[i].numRetractedBedExits += statistics.numRetracted;
+  }
+}
+
+void ParameterSweep::WriteResults(FILE *pFile) const {
+  fprintf(pFile, "setting,frames,ms/frame,None,Standing,SittingOnEdge,"
+                 "Sitting,Lying,LyingOnSide,bed exits,provisional,"
+                 "retracted\n");
+  for (const Result &result : m_results) {
+    fprintf(pFile, "%s,%d,%.2f", result.name.c_str(), result.numFrames,
+            result.analysisTime / max(1, result.numFrames));
+    for (int numFramesInState : result.numFramesInStates)
+      fprintf(pFile, ",%d", numFramesInState);
+    fprintf(pFile, ",%d,%d,%d\n", result.numBedExits,
+            result.numProvisionalBedExits, result.numRetractedBedExits);
+  }
+
+  double framesPerSecond = (0.0 < m_elapsedTime) ?
+      m_numFramesDecoded / (m_elapsedTime / 1000.0) : 0.0;
+  fprintf(pFile, "decoded frames,%d\n", m_numFramesDecoded);
+  fprintf(pFile, "decoded frames/s,%.1f\n", framesPerSecond);
+  fprintf(pFile, "settings x frames/s,%.1f\n",
+          framesPerSecond * m_results.size());
+}
\ No newline at end of file
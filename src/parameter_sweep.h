@@ -0,0 +1,76 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_PARAMETER_SWEEP_H_
+#define KINECT_PATIENTS_OBSERVER_PARAMETER_SWEEP_H_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "constants.h"
+#include "observer.h"
+
+class DepthSequence;
+class ThreadPool;
+
+/// <summary>
+/// Compares settings of constants over recordings in a single pass.
+/// Each frame is decoded and its holes are filled once,
+/// then the observers of all settings share it in parallel.
+/// </summary>
+class ParameterSweep {
+public:
+  /// <summary>
+  /// Results of a setting summed over sequences.
+  /// </summary>
+  struct Result {
+    std::string name;
+    Constants constants;
+    int numFrames;
+    double analysisTime;  // [ms]
+    int numFramesInStates[Observer::eLyingOnSide + 1];
+    int numBedExits;  // Changes from on the bed to off the bed.
+    int numProvisionalBedExits;
+    int numRetractedBedExits;
+  };
+
+  // Every setting holds an observer with frames of its own.
+  static const int cMaxSettings = 64;
+
+  /// <param name="pThreadPool">pool to run the settings on</param>
+  explicit ParameterSweep(ThreadPool *pThreadPool);
+
+  /// <summary>
+  /// Add a setting unless there are "cMaxSettings" already.
+  /// </summary>
+  /// <returns>whether the setting was added</returns>
+  bool AddSetting(const char *name, const Constants &constants);
+  /// <summary>
+  /// Add a setting for every combination of values in a file,
+  /// a constant per line followed by its values, e.g.
+  /// "cHeadWidth 120 140 160".
+  /// </summary>
+  /// <param name="fileName">path to the grid</param>
+  /// <param name="base">constants not in the grid</param>
+  /// <returns>whether the grid was read and all of its combinations
+  /// were added, otherwise none are</returns>
+  bool AddGrid(const char *fileName, const Constants &base);
+
+  /// <summary>
+  /// Run every setting over a sequence.
+  /// </summary>
+  /// <param name="pSequence">frames to replay</param>
+  void Run(DepthSequence *pSequence);
+  /// <summary>
+  /// Write results of every setting in CSV.
+  /// </summary>
+  void WriteResults(FILE *pFile) const;
+
+  const std::vector<Result> &GetResults() const { return m_results; }
+
+private:
+  ThreadPool *m_pThreadPool;
+  std::vector<Result> m_results;
+  // Shared work.
+  int m_numFramesDecoded;
+  double m_elapsedTime;  // [ms]
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_PARAMETER_SWEEP_H_
\ No newline at end of file
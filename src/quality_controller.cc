@@ -0,0 +1,62 @@
+﻿#include "quality_controller.h"
+
+QualityController::QualityController()
+    : m_level(Observer::eQualityFull),
+      m_averageCost(0.0),
+      m_hasAverageCost(false),
+      m_numFramesAtLevel(0),
+      m_numFramesWithHeadroom(0),
+      m_skipsNext(false),
+      m_numDegradations(0),
+      m_numRecoveries(0) {
+}
+
+bool QualityController::ShouldSkipFrame() {
+  if (m_level < Observer::eQualityHalfFrameRate)
+    return false;
+
+  bool skips = m_skipsNext;
+  m_skipsNext = !m_skipsNext;
+  return skips;
+}
+
+void QualityController::Update(double frameCost, bool wasSkipped,
+                               double frameBudget) {
+  // A skipped frame costs little and says nothing about the pipeline.
+  if (wasSkipped)
+    return;
+
+  // Smooth costs not to react to a single slow frame.
+  static const double cSmoothing = 0.1;
+  m_averageCost = m_hasAverageCost ?
+      (1.0 - cSmoothing) * m_averageCost + cSmoothing * frameCost :
+      frameCost;
+  m_hasAverageCost = true;
+
+  // Wait for the average to follow the last change of the level.
+  static const int cMinFramesAtLevel = 15;
+  if (++m_numFramesAtLevel < cMinFramesAtLevel)
+    return;
+
+  // Recover only with enough headroom for a while not to oscillate.
+  static const double cHeadroomRatio = 0.7;
+  static const int cFramesToRecover = 30;
+  if (frameBudget < m_averageCost) {
+    m_numFramesWithHeadroom = 0;
+    if (m_level + 1 < Observer::eNumQualityLevels) {
+      m_level = static_cast<Observer::QualityLevel>(m_level + 1);
+      m_numFramesAtLevel = 0;
+      ++m_numDegradations;
+    }
+  } else if (m_averageCost < cHeadroomRatio * frameBudget) {
+    if (cFramesToRecover <= ++m_numFramesWithHeadroom &&
+        Observer::eQualityFull < m_level) {
+      m_level = static_cast<Observer::QualityLevel>(m_level - 1);
+      m_numFramesAtLevel = 0;
+      m_numFramesWithHeadroom = 0;
+      ++m_numRecoveries;
+    }
+  } else {
+    m_numFramesWithHeadroom = 0;
+  }
+}
\ No newline at end of file
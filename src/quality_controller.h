@@ -0,0 +1,45 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_QUALITY_CONTROLLER_H_
+#define KINECT_PATIENTS_OBSERVER_QUALITY_CONTROLLER_H_
+
+#include "observer.h"
+
+/// <summary>
+/// Keeps the cost of frames within a budget by degrading Observer
+/// step by step, and recovers when there is headroom.
+/// </summary>
+class QualityController {
+public:
+  QualityController();
+
+  /// <summary>
+  /// Whether the next frame should skip the full pipeline.
+  /// Call once per frame.
+  /// </summary>
+  bool ShouldSkipFrame();
+  /// <summary>
+  /// Account for the cost of a frame and choose the next level.
+  /// </summary>
+  /// <param name="frameCost">time spent for the frame</param>
+  /// <param name="wasSkipped">whether the frame skipped the pipeline</param>
+  /// <param name="frameBudget">time allowed for a frame</param>
+  void Update(double frameCost, bool wasSkipped, double frameBudget);
+
+  // Accessors.
+  Observer::QualityLevel GetLevel() const { return m_level; }
+  double GetAverageCost() const { return m_averageCost; }  // [ms]
+  int GetNumDegradations() const { return m_numDegradations; }
+  int GetNumRecoveries() const { return m_numRecoveries; }
+
+private:
+  Observer::QualityLevel m_level;
+  double m_averageCost;  // [ms] Of frames through the full pipeline.
+  bool m_hasAverageCost;
+  int m_numFramesAtLevel;
+  int m_numFramesWithHeadroom;
+  bool m_skipsNext;
+  // Metrics.
+  int m_numDegradations;
+  int m_numRecoveries;
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_QUALITY_CONTROLLER_H_
\ No newline at end of file
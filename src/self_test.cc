@@ -0,0 +1,256 @@
+﻿#include "self_test.h"
+#include <algorithm>  // std::equal()
+#include <memory>
+#include <vector>
+#include "depth_sequence.h"
+#include "frame_bus.h"
+#include "observer.h"
+#include "sensor_profile.h"
+#include "state_history.h"
+
+static bool IsSameRecord(const StateHistoryRecord &record1,
+                         const StateHistoryRecord &record2) {
+  for (int i = 0; i < _countof(record1.stateTimes); ++i) {
+    if (record1.stateTimes[i] != record2.stateTimes[i])
+      return false;
+  }
+  return record1.startTime == record2.startTime &&
+         record1.numFrames == record2.numFrames &&
+         record1.numSittingEpisodes == record2.numSittingEpisodes &&
+         record1.numTurns == record2.numTurns &&
+         record1.numBedExits == record2.numBedExits;
+}
+
+static void AddRecord(const StateHistoryRecord &record,
+                      StateHistoryRecord *pSum) {
+  if (pSum->startTime == 0)
+    pSum->startTime = record.startTime;
+  for (int i = 0; i < _countof(record.stateTimes); ++i)
+    pSum->stateTimes[i] += record.stateTimes[i];
+  pSum->numFrames += record.numFrames;
+  pSum->numSittingEpisodes += record.numSittingEpisodes;
+  pSum->numTurns += record.numTurns;
+  pSum->numBedExits += record.numBedExits;
+}
+
+bool SelfTest::Run(FILE *pReport) {
+  bool isCorrect = CheckFrameBus(pReport);
+  isCorrect = CheckStateHistory(pReport) && isCorrect;
+
+  fprintf(pReport, "self-test: %s\n", isCorrect ? "PASS" : "FAIL");
+  return isCorrect;
+}
+
+bool SelfTest::CheckFrameBus(FILE *pReport) {
+  static const int cNumFrames = 100;
+  static const int cNumSlots = 4;
+  int width = KinectV2Profile::cDepthBufferWidth;
+  int height = KinectV2Profile::cDepthBufferHeight;
+  char busName[64];
+  sprintf_s(busName, "PatientObserverHarnessBus%lu", GetCurrentProcessId());
+  FrameBusWriter writer;
+  FrameBusReader reader;
+  if (!writer.Create(busName, width, height, cNumSlots) ||
+      !reader.Open(busName)) {
+    fprintf(pReport, "frame bus: not created  FAIL\n");
+    return false;
+  }
+
+  // Frames through the bus are judged as the same frames directly.
+  std::unique_ptr<Observer> pExpected(Observer::Create(width, height));
+  std::unique_ptr<Observer> pActual(Observer::Create(width, height));
+  FrameBusObserverAdapter adapter(&reader, pActual.get());
+  SyntheticSequence sequence(width, height, cNumFrames, 1);
+  std::vector<UINT16> frame(width * height);
+  int numObserved = 0;
+  int numDiverged = 0;
+  if (!pExpected || !pActual || !sequence.Rewind())
+    return false;
+  for (INT64 i = 1; sequence.ReadFrame(frame.data()); ++i) {
+    writer.Write(i, frame.data());
+    pExpected->Observe(frame.data());
+    if (adapter.ObserveNext() == FrameBusObserverAdapter::eObserved)
+      ++numObserved;
+    bool isDiverged =
+        pExpected->GetState() != pActual->GetState() ||
+        pExpected->GetHeadPosition() != pActual->GetHeadPosition() ||
+        pExpected->GetProbabilityPatientOnBed() !=
+            pActual->GetProbabilityPatientOnBed();
+    numDiverged += isDiverged ? 1 : 0;
+  }
+
+  // A reader falling behind skips to recent frames.
+  INT64 numSkippedBefore = reader.GetNumFramesSkipped();
+  for (int i = 0; i < 2 * cNumSlots; ++i)
+    writer.Write(0, frame.data());
+  INT64 timestamp;
+  bool isSkipped = reader.AcquireFrame(&timestamp) &&
+                   reader.ReleaseFrame() &&
+                   numSkippedBefore < reader.GetNumFramesSkipped();
+
+  // A frame overwritten while it is read is torn.
+  writer.Write(0, frame.data());
+  bool isTornTold = reader.AcquireFrame(&timestamp) != NULL;
+  for (int i = 0; i < cNumSlots; ++i)
+    writer.Write(0, frame.data());
+  isTornTold = isTornTold && !reader.ReleaseFrame();
+
+  bool isCorrect = numObserved == cNumFrames && numDiverged == 0 &&
+                   isSkipped && isTornTold;
+  fprintf(pReport, "frame bus: %d of %d frames observed, %d diverged, "
+                   "skips %s, tears %s%s\n",
+          numObserved, cNumFrames, numDiverged,
+          isSkipped ? "told" : "missed", isTornTold ? "told" : "missed",
+          isCorrect ? "" : "  FAIL");
+  fflush(pReport);
+  return isCorrect;
+}
+
+bool SelfTest::CheckStateHistory(FILE *pReport) {
+  static const INT64 cSecond = 10000000;  // [100 ns]
+  static const INT64 cMinute = 60 * cSecond;
+  static const INT64 cHour = 60 * cMinute;
+  // Across a segment, off minute boundaries.
+  static const INT64 cStartTime = 132000000000000000LL + 12345678;
+  static const INT64 cDuration = 10 * 24 * cHour;
+  static const int cNumRanges = 200;
+
+  char directory[MAX_PATH];
+  char path[MAX_PATH];
+  GetTempPathA(MAX_PATH, path);
+  sprintf_s(directory, "%sPatientObserverHarnessHistory%lu", path,
+            GetCurrentProcessId());
+  CreateDirectoryA(directory, NULL);
+
+  // Frames at about 30 fps with gaps, recounted into every minute by
+  // the rules of "StateHistory::Add()".
+  INT64 firstMinute = cStartTime - cStartTime % cMinute;
+  std::vector<StateHistoryRecord> minutes(
+      static_cast<size_t>(cDuration / cMinute + 1));
+  bool isRecorded = true;
+  {
+    StateHistory history(directory, "harness");
+    unsigned random = 2654435761u;
+    Observer::PatientState state = Observer::eNone;
+    Observer::PatientState lastState = Observer::eNone;
+    Observer::BedExitStatus status = Observer::eBedExitNone;
+    Observer::BedExitStatus lastStatus = Observer::eBedExitNone;
+    INT64 lastTime = 0;
+    for (INT64 time = cStartTime; time < cStartTime + cDuration; ) {
+      random = random * 1103515245u + 12345u;
+      unsigned value = random >> 8;
+      if (value % 300 == 0)
+        state = static_cast<Observer::PatientState>(value / 300 % 6);
+      if (value % 5000 == 1)
+        status = Observer::eBedExitConfirmed;
+      else if (value % 50 == 2)
+        status = Observer::eBedExitNone;
+      isRecorded = history.Add(time, state, status) && isRecorded;
+
+      StateHistoryRecord &minute = minutes[static_cast<size_t>(
+          (time - firstMinute) / cMinute)];
+      minute.startTime = time - time % cMinute;
+      ++minute.numFrames;
+      if (lastTime != 0) {
+        bool isSitting = state == Observer::eSittingOnEdge ||
+                         state == Observer::eSitting;
+        bool wasSitting = lastState == Observer::eSittingOnEdge ||
+                          lastState == Observer::eSitting;
+        bool isLying = state == Observer::eLying ||
+                       state == Observer::eLyingOnSide;
+        bool wasLying = lastState == Observer::eLying ||
+                        lastState == Observer::eLyingOnSide;
+        if (time - lastTime <= cSecond)
+          minute.stateTimes[lastState] += time - lastTime;
+        minute.numSittingEpisodes += (isSitting && !wasSitting) ? 1 : 0;
+        minute.numTurns += (isLying && wasLying && state != lastState) ?
+            1 : 0;
+      }
+      minute.numBedExits += (status == Observer::eBedExitConfirmed &&
+                             lastStatus != Observer::eBedExitConfirmed) ?
+          1 : 0;
+      lastTime = time;
+      lastState = state;
+      lastStatus = status;
+      time += (value % 1000 == 3) ? 5 * cSecond :
+          cSecond / 30 + (value / 1000 % 3) * 1000;
+    }
+  }
+
+  // Ranges of up to the whole duration, half of them short,
+  // summed from the minute containing their start.
+  StateHistory history(directory, "harness");
+  unsigned random = 12345;
+  int numDiverged = 0;
+  for (int i = 0; i < cNumRanges; ++i) {
+    random = random * 1103515245u + 12345u;
+    INT64 begin = cStartTime - cHour +
+                  (random >> 8) * ((cDuration + cHour) >> 24);
+    random = random * 1103515245u + 12345u;
+    INT64 end = begin + (random >> 8) * (cDuration >> 24) /
+                            ((i % 2) ? 1 : 50);
+    StateHistoryRecord expected = {};
+    for (const StateHistoryRecord &minute : minutes) {
+      if (minute.startTime != 0 &&
+          begin - begin % cMinute <= minute.startTime &&
+          minute.startTime < end)
+        AddRecord(minute, &expected);
+    }
+    // Starting with a whole hour if the first minute is in one.
+    INT64 hour = expected.startTime - expected.startTime % cHour;
+    if (begin - begin % cMinute <= hour && hour + cHour <= end)
+      expected.startTime = hour;
+    StateHistoryRecord summary;
+    history.Summarize(begin, end, &summary);
+    numDiverged += IsSameRecord(summary, expected) ? 0 : 1;
+  }
+
+  // Every minute and the sums of hours.
+  std::vector<StateHistoryRecord> records;
+  std::vector<StateHistoryRecord> expectedRecords;
+  StateHistoryRecord total = {};
+  size_t numHours = 0;
+  for (const StateHistoryRecord &minute : minutes) {
+    if (minute.startTime == 0)
+      continue;
+    if (expectedRecords.empty() ||
+        expectedRecords.back().startTime / cHour != minute.startTime / cHour)
+      ++numHours;
+    expectedRecords.push_back(minute);
+    AddRecord(minute, &total);
+  }
+  history.GetRecords(StateHistory::eResolutionMinute, cStartTime,
+                     cStartTime + cDuration, &records);
+  bool isSame = records.size() == expectedRecords.size() &&
+                std::equal(records.begin(), records.end(),
+                           expectedRecords.begin(), IsSameRecord);
+  history.GetRecords(StateHistory::eResolutionHour, cStartTime,
+                     cStartTime + cDuration, &records);
+  StateHistoryRecord hourTotal = {};
+  for (const StateHistoryRecord &record : records)
+    AddRecord(record, &hourTotal);
+  hourTotal.startTime = total.startTime;
+  isSame = isSame && records.size() == numHours &&
+           IsSameRecord(hourTotal, total);
+
+  // Leave nothing behind.
+  WIN32_FIND_DATAA findData;
+  sprintf_s(path, "%s\\*.sth", directory);
+  HANDLE hFind = FindFirstFileA(path, &findData);
+  if (hFind != INVALID_HANDLE_VALUE) {
+    do {
+      sprintf_s(path, "%s\\%s", directory, findData.cFileName);
+      DeleteFileA(path);
+    } while (FindNextFileA(hFind, &findData));
+    FindClose(hFind);
+  }
+  RemoveDirectoryA(directory);
+
+  bool isCorrect = isRecorded && numDiverged == 0 && isSame;
+  fprintf(pReport, "state history: %d of %d ranges diverged, "
+                   "records %s%s\n",
+          numDiverged, cNumRanges, isSame ? "matched" : "diverged",
+          isCorrect ? "" : "  FAIL");
+  fflush(pReport);
+  return isCorrect;
+}
\ No newline at end of file
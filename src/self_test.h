@@ -0,0 +1,37 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_SELF_TEST_H_
+#define KINECT_PATIENTS_OBSERVER_SELF_TEST_H_
+
+#include <stdio.h>
+
+/// <summary>
+/// Checks of the parts around Observer, which "/equivalence" runs
+/// after comparing Observer configurations.
+/// </summary>
+class SelfTest {
+public:
+  /// <summary>
+  /// Run every check.
+  /// </summary>
+  /// <param name="pReport">file to write the report</param>
+  /// <returns>whether every check passed</returns>
+  static bool Run(FILE *pReport);
+  /// <summary>
+  /// Pass a synthetic sequence through a frame bus in this process,
+  /// and check that observing through the bus matches observing
+  /// directly, and that frames overwritten before or while they are
+  /// read are told.
+  /// </summary>
+  /// <param name="pReport">file to write the report</param>
+  /// <returns>whether the bus behaved</returns>
+  static bool CheckFrameBus(FILE *pReport);
+  /// <summary>
+  /// Record synthetic states of ten days into a state history in a
+  /// temporary directory, and check its summaries of random ranges and
+  /// its records against a recount of the frames.
+  /// </summary>
+  /// <param name="pReport">file to write the report</param>
+  /// <returns>whether every summary and record matched</returns>
+  static bool CheckStateHistory(FILE *pReport);
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_SELF_TEST_H_
\ No newline at end of file
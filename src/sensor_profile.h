@@ -0,0 +1,52 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_SENSOR_PROFILE_H_
+#define KINECT_PATIENTS_OBSERVER_SENSOR_PROFILE_H_
+
+// Compile-time geometry of the supported depth sensors.
+// Focal lengths are "center / tan(field of view / 2)" calculated beforehand
+// because tan() can't be evaluated at compile time.
+// http://stackoverflow.com/questions/17832238/
+
+/// <summary>
+/// Kinect v2.
+/// http://zugara.com/how-does-the-kinect-2-compare-to-the-kinect-1
+/// </summary>
+struct KinectV2Profile {
+  static const int cDepthBufferWidth = 512;    // [px]
+  static const int cDepthBufferHeight = 424;   // [px]
+  static const int cHorizontalFieldView = 70;  // [degree]
+  static const int cVerticalFieldView = 60;    // [degree]
+  static constexpr double cFX = 365.60588972598134;  // [px]
+  static constexpr double cFY = 367.19477120460203;  // [px]
+  static const int cMinDepth = 500;   // [mm]
+  static const int cMaxDepth = 4500;  // [mm]
+};
+
+/// <summary>
+/// Kinect v1 (Kinect for Windows).
+/// </summary>
+struct KinectV1Profile {
+  static const int cDepthBufferWidth = 640;    // [px]
+  static const int cDepthBufferHeight = 480;   // [px]
+  static const int cHorizontalFieldView = 57;  // [degree]
+  static const int cVerticalFieldView = 43;    // [degree]
+  static constexpr double cFX = 589.3666835307066;  // [px]
+  static constexpr double cFY = 609.2754949594339;  // [px]
+  static const int cMinDepth = 800;   // [mm]
+  static const int cMaxDepth = 4000;  // [mm]
+};
+
+/// <summary>
+/// Azure Kinect in the narrow field of view unbinned mode (NFOV).
+/// </summary>
+struct AzureKinectNfovProfile {
+  static const int cDepthBufferWidth = 640;    // [px]
+  static const int cDepthBufferHeight = 576;   // [px]
+  static const int cHorizontalFieldView = 75;  // [degree]
+  static const int cVerticalFieldView = 65;    // [degree]
+  static constexpr double cFX = 417.0321193091858;  // [px]
+  static constexpr double cFY = 452.0694462098372;  // [px]
+  static const int cMinDepth = 500;   // [mm]
+  static const int cMaxDepth = 3860;  // [mm]
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_SENSOR_PROFILE_H_
\ No newline at end of file
@@ -0,0 +1,50 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_SEQLOCK_H_
+#define KINECT_PATIENTS_OBSERVER_SEQLOCK_H_
+
+#include <atomic>
+
+/// <summary>
+/// Publishes a value from one writer to any number of readers
+/// with no locks and no allocations.
+/// The sequence is odd while the writer copies the value,
+/// and readers copy it again if the sequence changed meanwhile.
+/// T must be trivially copyable.
+/// </summary>
+template <class T>
+class SeqLock {
+public:
+  SeqLock() : m_sequence(0), m_value() {}
+
+  /// <summary>
+  /// Publish a new value. Only one thread may store.
+  /// </summary>
+  void Store(const T &value) {
+    UINT32 sequence = m_sequence.load(std::memory_order_relaxed);
+    m_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_value = value;
+    m_sequence.store(sequence + 2, std::memory_order_release);
+  }
+  /// <summary>
+  /// Copy the latest value consistently.
+  /// </summary>
+  /// <param name="pValue">copied value</param>
+  /// <returns>number of values stored until the copied one</returns>
+  UINT32 Load(T *pValue) const {
+    while (true) {
+      UINT32 before = m_sequence.load(std::memory_order_acquire);
+      if (before & 1)
+        continue;  // Being written.
+      *pValue = m_value;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (m_sequence.load(std::memory_order_relaxed) == before)
+        return before / 2;
+    }
+  }
+
+private:
+  std::atomic<UINT32> m_sequence;
+  T m_value;
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_SEQLOCK_H_
\ No newline at end of file
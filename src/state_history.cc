@@ -0,0 +1,265 @@
+﻿#include "state_history.h"
+#include <string.h>  // strncpy_s()
+
+// To recognize a segment, "STH1".
+static const UINT32 cSegmentSignature = 0x31485453;
+static const UINT32 cVersion = 1;
+static const INT64 cMinute = 60LL * 10000000;  // [100 ns]
+static const INT64 cHour = 60 * cMinute;       // [100 ns]
+static const INT64 cSegmentDuration = 7 * 24 * cHour;  // [100 ns]
+static const int cNumMinuteRecords = static_cast<int>(
+    cSegmentDuration / cMinute);
+static const int cNumHourRecords = static_cast<int>(cSegmentDuration / cHour);
+// Time between frames longer than this isn't counted for any state.
+static const INT64 cMaxFrameInterval = 10000000;  // [100 ns]
+
+static INT64 Floor(INT64 time, INT64 unit) {
+  return time - time % unit;
+}
+
+static bool IsSitting(Observer::PatientState state) {
+  return state == Observer::eSittingOnEdge || state == Observer::eSitting;
+}
+
+static bool IsLying(Observer::PatientState state) {
+  return state == Observer::eLying || state == Observer::eLyingOnSide;
+}
+
+static const StateHistoryRecord &GetRecord(
+    const StateHistoryRecord *pRecords, INT64 segmentStartTime, INT64 unit,
+    INT64 time) {
+  return pRecords[(time - segmentStartTime) / unit];
+}
+
+StateHistory::StateHistory(const char *directory, const char *bedName)
+    : m_writtenSegment(),
+      m_readSegment(),
+      m_failedStartTime(0),
+      m_nextMappingTime(0),
+      m_lastTimestamp(0),
+      m_lastState(Observer::eNone),
+      m_lastBedExitStatus(Observer::eBedExitNone) {
+  strcpy_s(m_directory, directory);
+  strncpy_s(m_bedName, bedName, _TRUNCATE);
+  m_writtenSegment.hFile = INVALID_HANDLE_VALUE;
+  m_readSegment.hFile = INVALID_HANDLE_VALUE;
+}
+
+StateHistory::~StateHistory() {
+  UnmapSegment(&m_writtenSegment);
+  UnmapSegment(&m_readSegment);
+}
+
+bool StateHistory::Add(INT64 timestamp, Observer::PatientState state,
+                       Observer::BedExitStatus bedExitStatus) {
+  // Start a new segment every week.
+  // If it fails to map, drop frames for the rest of the minute rather
+  // than opening the file for every frame.
+  INT64 segmentStartTime = Floor(timestamp, cSegmentDuration);
+  if (!m_writtenSegment.pHeader ||
+      m_writtenSegment.startTime != segmentStartTime) {
+    if (m_failedStartTime == segmentStartTime &&
+        Floor(timestamp, cMinute) + cMinute == m_nextMappingTime)
+      return false;
+    UnmapSegment(&m_writtenSegment);
+    if (!MapSegment(segmentStartTime, true, &m_writtenSegment)) {
+      m_failedStartTime = segmentStartTime;
+      m_nextMappingTime = Floor(timestamp, cMinute) + cMinute;
+      return false;
+    }
+    m_failedStartTime = 0;
+  }
+
+  // Changes from the previous frame.
+  bool hasPrevious = m_lastTimestamp != 0;
+  INT64 elapsedTime = timestamp - m_lastTimestamp;
+  bool isContinued = hasPrevious && 0 <= elapsedTime &&
+                     elapsedTime <= cMaxFrameInterval;
+  bool isSittingEpisode = hasPrevious && IsSitting(state) &&
+                          !IsSitting(m_lastState);
+  bool isTurn = hasPrevious && IsLying(state) && IsLying(m_lastState) &&
+                state != m_lastState;
+  bool isBedExit = bedExitStatus == Observer::eBedExitConfirmed &&
+                   m_lastBedExitStatus != Observer::eBedExitConfirmed;
+
+  // Add up the minute and the hour of the frame at once.
+  const Segment &segment = m_writtenSegment;
+  StateHistoryRecord *pRecords[] = {
+      &segment.pMinutes[(timestamp - segmentStartTime) / cMinute],
+      &segment.pHours[(timestamp - segmentStartTime) / cHour],
+  };
+  const INT64 cUnits[] = {cMinute, cHour};
+  for (int i = 0; i < _countof(pRecords); ++i) {
+    StateHistoryRecord &record = *pRecords[i];
+    if (record.startTime == 0)
+      record.startTime = Floor(timestamp, cUnits[i]);
+    if (isContinued)
+      record.stateTimes[m_lastState] += elapsedTime;
+    ++record.numFrames;
+    record.numSittingEpisodes += isSittingEpisode ? 1 : 0;
+    record.numTurns += isTurn ? 1 : 0;
+    record.numBedExits += isBedExit ? 1 : 0;
+  }
+
+  m_lastTimestamp = timestamp;
+  m_lastState = state;
+  m_lastBedExitStatus = bedExitStatus;
+  return true;
+}
+
+bool StateHistory::Summarize(INT64 begin, INT64 end,
+                             StateHistoryRecord *pSummary) {
+  *pSummary = StateHistoryRecord();
+  bool isFound = false;
+  INT64 time = Floor(begin, cMinute);
+  while (time < end) {
+    INT64 segmentEndTime = Floor(time, cSegmentDuration) + cSegmentDuration;
+    const Segment *pSegment = FindSegment(time);
+    if (!pSegment) {
+      time = segmentEndTime;
+      continue;
+    }
+
+    // Take whole hours, and minutes at both ends.
+    for (; time < end && time < segmentEndTime; ) {
+      bool isWholeHour = time % cHour == 0 && time + cHour <= end;
+      const StateHistoryRecord &record = isWholeHour ?
+          GetRecord(pSegment->pHours, pSegment->startTime, cHour, time) :
+          GetRecord(pSegment->pMinutes, pSegment->startTime, cMinute, time);
+      time += isWholeHour ? cHour : cMinute;
+      if (record.startTime == 0)
+        continue;
+
+      if (!isFound)
+        pSummary->startTime = record.startTime;
+      isFound = true;
+      for (int i = 0; i < _countof(record.stateTimes); ++i)
+        pSummary->stateTimes[i] += record.stateTimes[i];
+      pSummary->numFrames += record.numFrames;
+      pSummary->numSittingEpisodes += record.numSittingEpisodes;
+      pSummary->numTurns += record.numTurns;
+      pSummary->numBedExits += record.numBedExits;
+    }
+  }
+  return isFound;
+}
+
+void StateHistory::GetRecords(Resolution resolution, INT64 begin, INT64 end,
+                              std::vector<StateHistoryRecord> *pRecords) {
+  pRecords->clear();
+  INT64 unit = (resolution == eResolutionHour) ? cHour : cMinute;
+  INT64 time = Floor(begin, unit);
+  while (time < end) {
+    INT64 segmentEndTime = Floor(time, cSegmentDuration) + cSegmentDuration;
+    const Segment *pSegment = FindSegment(time);
+    if (!pSegment) {
+      time = segmentEndTime;
+      continue;
+    }
+
+    const StateHistoryRecord *pSegmentRecords =
+        (resolution == eResolutionHour) ? pSegment->pHours :
+        pSegment->pMinutes;
+    for (; time < end && time < segmentEndTime; time += unit) {
+      const StateHistoryRecord &record =
+          GetRecord(pSegmentRecords, pSegment->startTime, unit, time);
+      if (record.startTime != 0)
+        pRecords->push_back(record);
+    }
+  }
+}
+
+bool StateHistory::MapSegment(INT64 startTime, bool isWritable,
+                              Segment *pSegment) {
+  char fileName[MAX_PATH];
+  sprintf_s(fileName, "%s\\%s_%lld.sth", m_directory, m_bedName, startTime);
+  UINT64 size = sizeof(StateHistorySegmentHeader) +
+                sizeof(StateHistoryRecord) *
+                    (cNumMinuteRecords + cNumHourRecords);
+
+  // Share with the writer to read the segment being recorded.
+  if (isWritable) {
+    pSegment->hFile = CreateFileA(fileName, GENERIC_READ | GENERIC_WRITE,
+                                  FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+                                  FILE_ATTRIBUTE_NORMAL, NULL);
+  } else {
+    pSegment->hFile = CreateFileA(fileName, GENERIC_READ,
+                                  FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  }
+  LARGE_INTEGER fileSize = {};
+  bool isMapped = pSegment->hFile != INVALID_HANDLE_VALUE &&
+                  GetFileSizeEx(pSegment->hFile, &fileSize) &&
+                  (isWritable ||
+                   size <= static_cast<UINT64>(fileSize.QuadPart));
+  if (isMapped) {
+    // A new segment grows to the size filled with zeros.
+    pSegment->hMapping = CreateFileMappingA(
+        pSegment->hFile, NULL, isWritable ? PAGE_READWRITE : PAGE_READONLY,
+        static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), NULL);
+    isMapped = pSegment->hMapping != NULL;
+  }
+  BYTE *pData = NULL;
+  if (isMapped) {
+    pData = static_cast<BYTE *>(MapViewOfFile(
+        pSegment->hMapping, isWritable ? FILE_MAP_WRITE : FILE_MAP_READ,
+        0, 0, static_cast<SIZE_T>(size)));
+    isMapped = pData != NULL;
+  }
+  if (isMapped) {
+    StateHistorySegmentHeader *pHeader =
+        reinterpret_cast<StateHistorySegmentHeader *>(pData);
+    pSegment->pHeader = pHeader;
+    if (isWritable && pHeader->signature == 0) {
+      pHeader->version = cVersion;
+      pHeader->startTime = startTime;
+      strcpy_s(pHeader->bedName, m_bedName);
+      pHeader->numMinuteRecords = cNumMinuteRecords;
+      pHeader->numHourRecords = cNumHourRecords;
+      pHeader->signature = cSegmentSignature;
+    }
+    isMapped = pHeader->signature == cSegmentSignature &&
+               pHeader->version == cVersion &&
+               pHeader->startTime == startTime &&
+               pHeader->numMinuteRecords == cNumMinuteRecords &&
+               pHeader->numHourRecords == cNumHourRecords;
+  }
+  if (!isMapped) {
+    UnmapSegment(pSegment);
+    return false;
+  }
+
+  pSegment->pMinutes = reinterpret_cast<StateHistoryRecord *>(
+      pData + sizeof(StateHistorySegmentHeader));
+  pSegment->pHours = pSegment->pMinutes + cNumMinuteRecords;
+  pSegment->startTime = startTime;
+  return true;
+}
+
+void StateHistory::UnmapSegment(Segment *pSegment) {
+  if (pSegment->pHeader)
+    UnmapViewOfFile(pSegment->pHeader);
+  if (pSegment->hMapping)
+    CloseHandle(pSegment->hMapping);
+  if (pSegment->hFile != INVALID_HANDLE_VALUE)
+    CloseHandle(pSegment->hFile);
+  pSegment->hFile = INVALID_HANDLE_VALUE;
+  pSegment->hMapping = NULL;
+  pSegment->pHeader = NULL;
+  pSegment->pMinutes = NULL;
+  pSegment->pHours = NULL;
+  pSegment->startTime = 0;
+}
+
+const StateHistory::Segment *StateHistory::FindSegment(INT64 time) {
+  // The segment being written is mapped already.
+  INT64 startTime = Floor(time, cSegmentDuration);
+  if (m_writtenSegment.pHeader && m_writtenSegment.startTime == startTime)
+    return &m_writtenSegment;
+  if (m_readSegment.pHeader && m_readSegment.startTime == startTime)
+    return &m_readSegment;
+
+  UnmapSegment(&m_readSegment);
+  return MapSegment(startTime, false, &m_readSegment) ? &m_readSegment :
+      NULL;
+}
\ No newline at end of file
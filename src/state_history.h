@@ -0,0 +1,116 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_STATE_HISTORY_H_
+#define KINECT_PATIENTS_OBSERVER_STATE_HISTORY_H_
+
+#include <vector>
+#include "observer.h"
+
+// The history of a patient's state is split into segment files of a week,
+// "<bed name>_<start time>.sth", mapped into memory.
+// A segment is a header, a record for every minute of the week and
+// a record for every hour of it at fixed offsets. Both are added up
+// as frames arrive, so that the record of a time is found without
+// searching and a range is summed from hours and a few minutes.
+// Timestamps are in 100 ns since 1601 like FILETIME.
+
+struct StateHistorySegmentHeader {
+  UINT32 signature;
+  UINT32 version;
+  INT64 startTime;
+  char bedName[32];
+  UINT32 numMinuteRecords;
+  UINT32 numHourRecords;
+};
+
+struct StateHistoryRecord {
+  INT64 startTime;  // 0 until a frame is added.
+  INT64 stateTimes[Observer::eLyingOnSide + 1];  // [100 ns]
+  UINT32 numFrames;
+  UINT32 numSittingEpisodes;  // Into sitting from another state.
+  UINT32 numTurns;            // Between lying and lying on side.
+  UINT32 numBedExits;         // Confirmed.
+};
+
+/// <summary>
+/// Keeps weeks of a patient's state of a bed in bounded memory,
+/// mapping at most the segment being written and one to read.
+/// Use it on one thread, e.g. the frame loop.
+/// </summary>
+class StateHistory {
+public:
+  enum Resolution {
+    eResolutionMinute,
+    eResolutionHour,
+  };
+
+  /// <summary>
+  /// Prepare to record.
+  /// </summary>
+  /// <param name="directory">directory to put segments</param>
+  /// <param name="bedName">name of the bed</param>
+  StateHistory(const char *directory, const char *bedName);
+  ~StateHistory();
+
+  /// <summary>
+  /// Add a frame to its minute and hour.
+  /// The time since the previous frame goes to the previous state.
+  /// </summary>
+  /// <param name="timestamp">time when the frame was taken</param>
+  /// <param name="state">state judged at the frame</param>
+  /// <param name="bedExitStatus">bed exit at the frame</param>
+  /// <returns>whether the frame was added</returns>
+  bool Add(INT64 timestamp, Observer::PatientState state,
+           Observer::BedExitStatus bedExitStatus);
+  /// <summary>
+  /// Sum up records of minutes in a range from the minute containing
+  /// its start, using hours inside of it.
+  /// </summary>
+  /// <param name="begin">start of the range</param>
+  /// <param name="end">end of the range, exclusive</param>
+  /// <param name="pSummary">sums, with the start time of
+  /// the first record</param>
+  /// <returns>whether any record was found</returns>
+  bool Summarize(INT64 begin, INT64 end, StateHistoryRecord *pSummary);
+  /// <summary>
+  /// Get records in a range from the one containing its start,
+  /// e.g. to draw a graph. Minutes and hours without frames are left out.
+  /// </summary>
+  /// <param name="resolution">minutes or hours</param>
+  /// <param name="begin">start of the range</param>
+  /// <param name="end">end of the range, exclusive</param>
+  /// <param name="pRecords">found records in time order</param>
+  void GetRecords(Resolution resolution, INT64 begin, INT64 end,
+                  std::vector<StateHistoryRecord> *pRecords);
+
+private:
+  struct Segment {
+    HANDLE hFile;
+    HANDLE hMapping;
+    StateHistorySegmentHeader *pHeader;
+    StateHistoryRecord *pMinutes;
+    StateHistoryRecord *pHours;
+    INT64 startTime;
+  };
+
+  bool MapSegment(INT64 startTime, bool isWritable, Segment *pSegment);
+  static void UnmapSegment(Segment *pSegment);
+  /// <summary>
+  /// Get the segment containing a time mapped to read,
+  /// or NULL if it wasn't recorded.
+  /// </summary>
+  const Segment *FindSegment(INT64 time);
+
+  char m_directory[MAX_PATH];
+  char m_bedName[32];
+  Segment m_writtenSegment;
+  Segment m_readSegment;
+  // The written segment failed to map, and isn't tried again
+  // in the minute ending at the time.
+  INT64 m_failedStartTime;  // Or 0.
+  INT64 m_nextMappingTime;
+  // Previous frame.
+  INT64 m_lastTimestamp;
+  Observer::PatientState m_lastState;
+  Observer::BedExitStatus m_lastBedExitStatus;
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_STATE_HISTORY_H_
\ No newline at end of file
@@ -0,0 +1,262 @@
+﻿#include "stream_scheduler.h"
+#include "depth_sequence.h"
+
+const double StreamScheduler::cDefaultDeadline = 1000.0 / 30;
+
+static double ToMilliseconds(Observer::Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+StreamScheduler::StreamScheduler(int numWorkers)
+    : m_isWorkerBusy(max(1, numWorkers), false),
+      m_isStopping(false) {
+  // Keep each worker on a core, and so the streams at home on it.
+  // A mask holds only the cores of the first processor group.
+  static const int cMaxCores = 8 * sizeof(DWORD_PTR);
+  int numCores = min(cMaxCores, max(1, static_cast<int>(
+      std::thread::hardware_concurrency())));
+  for (int i = 0; i < max(1, numWorkers); ++i) {
+    m_threads.push_back(std::thread(&StreamScheduler::Work, this, i));
+    DWORD_PTR affinityMask = static_cast<DWORD_PTR>(1) << (i % numCores);
+    SetThreadAffinityMask(m_threads[i].native_handle(), affinityMask);
+  }
+}
+
+StreamScheduler::~StreamScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isStopping = true;
+  }
+  m_frameSubmitted.notify_all();
+  for (int i = 0; i < static_cast<int>(m_threads.size()); ++i)
+    m_threads[i].join();
+}
+
+int StreamScheduler::AddStream(const char *name, Observer *pObserver,
+                               double deadline) {
+  std::unique_ptr<Stream> pStream(new Stream());
+  pStream->name = name;
+  pStream->pObserver = pObserver;
+  pStream->deadline = std::chrono::duration_cast<Observer::Clock::duration>(
+      std::chrono::duration<double, std::milli>(deadline));
+  size_t frameSize = static_cast<size_t>(pObserver->GetDepthBufferWidth()) *
+                     pObserver->GetDepthBufferHeight();
+  for (int i = 0; i < cNumBuffersPerStream; ++i)
+    pStream->buffers[i].resize(frameSize);
+  pStream->freeBuffer = 0;
+  pStream->waitingBuffer = -1;
+  pStream->observedBuffer = -1;
+  pStream->frameTime = 0;
+  pStream->wasTooLate = false;
+  pStream->statistics = StreamStatistics();
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  int stream = static_cast<int>(m_streams.size());
+  pStream->homeWorker = stream % static_cast<int>(m_threads.size());
+  m_streams.push_back(std::move(pStream));
+  return stream;
+}
+
+UINT16 *StreamScheduler::GetFreeBuffer(int stream) {
+  // Workers only take the waiting buffer and return the observed one,
+  // so the free buffer stays free until the frame is submitted.
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Stream &s = *m_streams[stream];
+  s.freeBuffer = 0;
+  while (s.freeBuffer == s.waitingBuffer || s.freeBuffer == s.observedBuffer)
+    ++s.freeBuffer;
+  return s.buffers[s.freeBuffer].data();
+}
+
+void StreamScheduler::SubmitFrame(int stream,
+                                  Observer::Clock::time_point arrivalTime,
+                                  INT64 frameTime) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stream &s = *m_streams[stream];
+
+    // Shed the frame nobody has started, the newer one matters more.
+    // It doesn't postpone the stream though, or streams with earlier
+    // frames would starve it under overload.
+    if (0 <= s.waitingBuffer)
+      ++s.statistics.numReplaced;
+    else
+      s.schedulingDeadline = arrivalTime + s.deadline;
+    s.waitingBuffer = s.freeBuffer;
+    s.arrivalTime = arrivalTime;
+    s.absoluteDeadline = arrivalTime + s.deadline;
+    s.frameTime = frameTime;
+    ++s.statistics.numFrames;
+  }
+  m_frameSubmitted.notify_all();
+}
+
+bool StreamScheduler::Replay(const std::vector<DepthSequence *> &sequences,
+                             double frameRate) {
+  // Frames of a sequence, and whether it still has frames.
+  int numSequences = static_cast<int>(sequences.size());
+  std::vector<std::vector<UINT16>> frames(numSequences);
+  std::vector<bool> hasFrames(numSequences);
+  for (int i = 0; i < numSequences; ++i) {
+    DepthSequence *pSequence = sequences[i];
+    frames[i].resize(pSequence->GetWidth() * pSequence->GetHeight());
+    hasFrames[i] = pSequence->Rewind() &&
+                   pSequence->ReadFrame(frames[i].data());
+    if (!hasFrames[i])
+      return false;
+    pSequence->PrepareObserver(m_streams[i]->pObserver);
+  }
+
+  // Submit every sequence at once as cameras would.
+  Observer::Clock::duration interval =
+      std::chrono::duration_cast<Observer::Clock::duration>(
+          std::chrono::duration<double>(1.0 / frameRate));
+  Observer::Clock::time_point arrivalTime = Observer::Clock::now();
+  for (bool isReplaying = true; isReplaying; arrivalTime += interval) {
+    std::this_thread::sleep_until(arrivalTime);
+    isReplaying = false;
+    for (int i = 0; i < numSequences; ++i) {
+      if (!hasFrames[i])
+        continue;
+      memcpy(GetFreeBuffer(i), frames[i].data(),
+             frames[i].size() * sizeof(UINT16));
+      SubmitFrame(i, arrivalTime, 0);
+      hasFrames[i] = sequences[i]->ReadFrame(frames[i].data());
+      isReplaying = isReplaying || hasFrames[i];
+    }
+  }
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_frameObserved.wait(lock, [this]() { return IsIdle(); });
+  return true;
+}
+
+void StreamScheduler::GetStatistics(int stream,
+                                    StreamStatistics *pStatistics) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  *pStatistics = m_streams[stream]->statistics;
+}
+
+void StreamScheduler::WriteReport(FILE *pFile) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  fprintf(pFile, "stream,frames,observed,skipped,replaced,deadline_misses,"
+                 "max_lateness_ms,average_cost_ms,quality_level\n");
+  for (const std::unique_ptr<Stream> &pStream : m_streams) {
+    const StreamStatistics &statistics = pStream->statistics;
+    fprintf(pFile, "%s,%lld,%lld,%lld,%lld,%lld,%.3f,%.3f,%d\n",
+            pStream->name.c_str(), statistics.numFrames,
+            statistics.numObserved, statistics.numSkipped,
+            statistics.numReplaced, statistics.numDeadlineMisses,
+            statistics.maxLateness, statistics.averageCost,
+            statistics.qualityLevel);
+  }
+}
+
+void StreamScheduler::Work(int worker) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    Stream *pStream = NULL;
+    m_frameSubmitted.wait(lock, [this, worker, &pStream]() {
+      pStream = FindEarliestStream(worker);
+      return m_isStopping || pStream;
+    });
+    if (m_isStopping)
+      return;
+
+    // Take the frame, and let others take the streams left at home.
+    Stream &s = *pStream;
+    s.observedBuffer = s.waitingBuffer;
+    s.waitingBuffer = -1;
+    Observer::Clock::time_point arrivalTime = s.arrivalTime;
+    Observer::Clock::time_point absoluteDeadline = s.absoluteDeadline;
+    INT64 frameTime = s.frameTime;
+    m_isWorkerBusy[worker] = true;
+    if (HasWaitingStream())
+      m_frameSubmitted.notify_all();
+
+    // A stream may use as much of the workers as the others.
+    int numWorkers = static_cast<int>(m_threads.size());
+    int numStreams = static_cast<int>(m_streams.size());
+    double deadline = ToMilliseconds(s.deadline);
+    double share = min(deadline, deadline * numWorkers / numStreams);
+    lock.unlock();
+
+    // Judge only a bed exit for a frame too late for the full pipeline,
+    // but not twice in a row to keep the average cost up to date.
+    Observer::Clock::time_point start = Observer::Clock::now();
+    QualityController &controller = s.qualityController;
+    bool skipsFrame = controller.ShouldSkipFrame();
+    Observer::Clock::duration averageCost =
+        std::chrono::duration_cast<Observer::Clock::duration>(
+            std::chrono::duration<double, std::milli>(
+                controller.GetAverageCost()));
+    bool isTooLate = !skipsFrame && !s.wasTooLate &&
+                     absoluteDeadline < start + averageCost;
+    s.wasTooLate = isTooLate;
+    skipsFrame = skipsFrame || isTooLate;
+    const UINT16 *pBuffer = s.buffers[s.observedBuffer].data();
+    s.pObserver->SetArrivalTime(arrivalTime);
+    s.pObserver->SetFrameTime(frameTime);
+    if (skipsFrame)
+      s.pObserver->SkipFrame(pBuffer);
+    else
+      s.pObserver->Observe(pBuffer);
+    Observer::Clock::time_point end = Observer::Clock::now();
+    controller.Update(ToMilliseconds(end - start), skipsFrame, share);
+    s.pObserver->SetQualityLevel(controller.GetLevel());
+
+    lock.lock();
+    StreamStatistics &statistics = s.statistics;
+    if (skipsFrame)
+      ++statistics.numSkipped;
+    else
+      ++statistics.numObserved;
+    if (absoluteDeadline < end) {
+      ++statistics.numDeadlineMisses;
+      statistics.maxLateness = max(statistics.maxLateness,
+                                   ToMilliseconds(end - absoluteDeadline));
+    }
+    statistics.averageCost = controller.GetAverageCost();
+    statistics.qualityLevel = controller.GetLevel();
+    s.observedBuffer = -1;
+    m_isWorkerBusy[worker] = false;
+    if (0 <= s.waitingBuffer)
+      m_frameSubmitted.notify_all();
+    m_frameObserved.notify_all();
+  }
+}
+
+StreamScheduler::Stream *StreamScheduler::FindEarliestStream(
+    int worker) const {
+  Stream *pEarliest = NULL;
+  for (const std::unique_ptr<Stream> &pStream : m_streams) {
+    const Stream &s = *pStream;
+    bool isReady = 0 <= s.waitingBuffer && s.observedBuffer < 0;
+    bool isAllowed = s.homeWorker == worker || m_isWorkerBusy[s.homeWorker];
+    if (isReady && isAllowed &&
+        (!pEarliest ||
+         s.schedulingDeadline < pEarliest->schedulingDeadline))
+      pEarliest = pStream.get();
+  }
+  return pEarliest;
+}
+
+bool StreamScheduler::IsIdle() const {
+  for (bool isBusy : m_isWorkerBusy) {
+    if (isBusy)
+      return false;
+  }
+  for (const std::unique_ptr<Stream> &pStream : m_streams) {
+    if (0 <= pStream->waitingBuffer)
+      return false;
+  }
+  return true;
+}
+
+bool StreamScheduler::HasWaitingStream() const {
+  for (const std::unique_ptr<Stream> &pStream : m_streams) {
+    if (0 <= pStream->waitingBuffer && pStream->observedBuffer < 0)
+      return true;
+  }
+  return false;
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_STREAM_SCHEDULER_H_
+#define KINECT_PATIENTS_OBSERVER_STREAM_SCHEDULER_H_
+
+#include <stdio.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "observer.h"
+#include "quality_controller.h"
+
+class DepthSequence;
+
+/// <summary>
+/// Observes depth streams of many beds on a fixed set of workers,
+/// so that a slow frame of one bed doesn't make the others late.
+/// Frames are taken earliest deadline first. Each stream keeps only its
+/// latest frame and prefers the worker of its home core, and a stream
+/// costing more than its share of the workers is degraded by itself.
+/// </summary>
+class StreamScheduler {
+public:
+  // Time from the arrival of a frame to its result, at 30 fps.
+  static const double cDefaultDeadline;  // [ms]
+
+  struct StreamStatistics {
+    INT64 numFrames;          // Submitted.
+    INT64 numObserved;        // Through the full pipeline.
+    INT64 numSkipped;         // Only through the fast path.
+    INT64 numReplaced;        // By a newer frame before they started.
+    INT64 numDeadlineMisses;  // Of frames observed or skipped.
+    double maxLateness;       // [ms] Past the deadline.
+    double averageCost;       // [ms] Of frames observed.
+    Observer::QualityLevel qualityLevel;
+  };
+
+  /// <summary>
+  /// Start workers, each pinned to a core.
+  /// </summary>
+  /// <param name="numWorkers">number of workers, at least 1</param>
+  explicit StreamScheduler(int numWorkers);
+  ~StreamScheduler();
+
+  /// <summary>
+  /// Add a stream of a bed.
+  /// </summary>
+  /// <param name="name">name of the stream for the report</param>
+  /// <param name="pObserver">observer outliving the scheduler,
+  /// used by one worker at a time</param>
+  /// <param name="deadline">time allowed from arrival to the result
+  /// in milliseconds</param>
+  /// <returns>index of the stream</returns>
+  int AddStream(const char *name, Observer *pObserver, double deadline);
+
+  /// <summary>
+  /// Get the buffer to copy the next frame of a stream into.
+  /// Only one thread may submit frames of a stream.
+  /// </summary>
+  /// <param name="stream">index of the stream</param>
+  /// <returns>buffer of the size of the frames, kept until the frame
+  /// is submitted</returns>
+  UINT16 *GetFreeBuffer(int stream);
+  /// <summary>
+  /// Submit the frame copied into the free buffer,
+  /// replacing the frame waiting for a worker if any.
+  /// </summary>
+  /// <param name="stream">index of the stream</param>
+  /// <param name="arrivalTime">when the frame arrived</param>
+  /// <param name="frameTime">time of the sensor in 100 ns,
+  /// or 0 if unknown</param>
+  void SubmitFrame(int stream, Observer::Clock::time_point arrivalTime,
+                   INT64 frameTime);
+
+  /// <summary>
+  /// Replay sequences as streams, submitting a frame of each at the
+  /// frame rate until every sequence ends, and wait for the results.
+  /// Observers are prepared only for the first frames, before the
+  /// workers use them.
+  /// </summary>
+  /// <param name="sequences">sequence of every stream, in the order
+  /// the streams were added</param>
+  /// <param name="frameRate">frames per second</param>
+  /// <returns>whether every sequence had frames</returns>
+  bool Replay(const std::vector<DepthSequence *> &sequences,
+              double frameRate);
+
+  void GetStatistics(int stream, StreamStatistics *pStatistics) const;
+  /// <summary>
+  /// Write the statistics of every stream as CSV.
+  /// </summary>
+  /// <param name="pFile">file to write</param>
+  void WriteReport(FILE *pFile) const;
+
+  int GetNumWorkers() const { return static_cast<int>(m_threads.size()); }
+
+private:
+  // Buffers of a stream, being written, waiting and being observed.
+  static const int cNumBuffersPerStream = 3;
+
+  struct Stream {
+    std::string name;
+    Observer *pObserver;
+    Observer::Clock::duration deadline;
+    int homeWorker;
+    std::vector<UINT16> buffers[cNumBuffersPerStream];
+    // Indices of buffers, or -1.
+    int freeBuffer;  // Given to the submitter.
+    int waitingBuffer;
+    int observedBuffer;
+    // Of the waiting frame.
+    Observer::Clock::time_point arrivalTime;
+    Observer::Clock::time_point absoluteDeadline;
+    // Of the oldest frame not taken yet, to order streams.
+    Observer::Clock::time_point schedulingDeadline;
+    INT64 frameTime;
+    // Of the worker observing the stream.
+    bool wasTooLate;
+    QualityController qualityController;
+    StreamStatistics statistics;
+  };
+
+  void Work(int worker);
+  /// <summary>
+  /// Find the waiting stream with the earliest deadline among the ones
+  /// of the worker and the ones whose home worker is busy.
+  /// </summary>
+  Stream *FindEarliestStream(int worker) const;
+  bool HasWaitingStream() const;
+  bool IsIdle() const;
+
+  std::vector<std::thread> m_threads;
+  std::vector<std::unique_ptr<Stream>> m_streams;
+  std::vector<bool> m_isWorkerBusy;
+  bool m_isStopping;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_frameSubmitted;
+  std::condition_variable m_frameObserved;
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_STREAM_SCHEDULER_H_
\ No newline at end of file
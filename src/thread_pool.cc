@@ -0,0 +1,135 @@
+﻿#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int numThreads)
+    : m_numQueuedTasks(0),
+      m_nextQueue(0),
+      m_isStopping(false) {
+  for (int i = 0; i < numThreads; ++i)
+    m_queues.push_back(std::unique_ptr<Queue>(new Queue()));
+  for (int i = 0; i < numThreads; ++i)
+    m_threads.push_back(std::thread(&ThreadPool::Work, this, i));
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isStopping = true;
+  }
+  m_taskQueued.notify_all();
+  for (int i = 0; i < static_cast<int>(m_threads.size()); ++i)
+    m_threads[i].join();
+}
+
+void ThreadPool::ParallelFor(int numTasks,
+                             const std::function<void(int)> &function) {
+  // Not worth handing over.
+  if (m_queues.empty() || numTasks <= 1) {
+    for (int i = 0; i < numTasks; ++i)
+      function(i);
+    return;
+  }
+
+  Job job;
+  job.pFunction = &function;
+  job.numRemaining = numTasks;
+
+  // Deal contiguous ranges of tasks to the queues.
+  // Start from a rotating queue so that concurrent callers spread out.
+  int numQueues = static_cast<int>(m_queues.size());
+  int firstQueue = m_nextQueue++ % numQueues;
+  m_numQueuedTasks += numTasks;
+  for (int i = 0; i < numQueues; ++i) {
+    int begin = numTasks * i / numQueues;
+    int end = numTasks * (i + 1) / numQueues;
+    Queue &queue = *m_queues[(firstQueue + i) % numQueues];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    for (int index = begin; index < end; ++index)
+      queue.tasks.push_back({&job, index});
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+  }
+  m_taskQueued.notify_all();
+
+  // Help the workers instead of just waiting.
+  Task task;
+  while (0 < job.numRemaining && PopTask(-1, &task))
+    RunTask(task);
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_jobFinished.wait(lock, [&job]() { return job.numRemaining == 0; });
+}
+
+void ThreadPool::Work(int worker) {
+  while (true) {
+    Task task;
+    if (PopTask(worker, &task)) {
+      RunTask(task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_taskQueued.wait(lock, [this]() {
+      return m_isStopping || 0 < m_numQueuedTasks;
+    });
+    if (m_isStopping && m_numQueuedTasks <= 0)
+      return;
+  }
+}
+
+bool ThreadPool::PopTask(int worker, Task *pTask) {
+  int numQueues = static_cast<int>(m_queues.size());
+
+  // Take the latest task from the own queue, which is still in the cache.
+  if (0 <= worker) {
+    Queue &queue = *m_queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.IsEmpty()) {
+      queue.PopBack(pTask);
+      --m_numQueuedTasks;
+      return true;
+    }
+  }
+
+  // Steal the oldest task from the others.
+  for (int i = 1; i <= numQueues; ++i) {
+    Queue &queue = *m_queues[(max(worker, 0) + i) % numQueues];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.IsEmpty()) {
+      queue.PopFront(pTask);
+      --m_numQueuedTasks;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ThreadPool::Queue::PopBack(Task *pTask) {
+  *pTask = tasks.back();
+  tasks.pop_back();
+  if (IsEmpty()) {
+    tasks.clear();
+    first = 0;
+  }
+}
+
+void ThreadPool::Queue::PopFront(Task *pTask) {
+  *pTask = tasks[first++];
+  if (IsEmpty()) {
+    tasks.clear();
+    first = 0;
+  }
+}
+
+void ThreadPool::RunTask(const Task &task) {
+  Job *pJob = task.pJob;
+  (*pJob->pFunction)(task.index);
+
+  // "pJob" can't be touched after the last decrement
+  // because its owner returns as soon as it sees zero.
+  if (--pJob->numRemaining == 0) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobFinished.notify_all();
+  }
+}
\ No newline at end of file
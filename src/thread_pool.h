@@ -0,0 +1,78 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_THREAD_POOL_H_
+#define KINECT_PATIENTS_OBSERVER_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Work-stealing thread pool shared by Observer instances.
+/// Each worker owns a queue, takes its own tasks from the back
+/// and steals from the front of the others when it runs out.
+/// </summary>
+class ThreadPool {
+public:
+  /// <summary>
+  /// Start workers.
+  /// </summary>
+  /// <param name="numThreads">number of workers,
+  /// 0 runs every task on the calling thread</param>
+  explicit ThreadPool(int numThreads);
+  ~ThreadPool();
+
+  /// <summary>
+  /// Call function(i) for each i in [0, numTasks) and wait for all.
+  /// The calling thread runs tasks too, so it can be called from
+  /// several threads at once.
+  /// </summary>
+  /// <param name="numTasks">number of tasks</param>
+  /// <param name="function">task taking its index</param>
+  void ParallelFor(int numTasks, const std::function<void(int)> &function);
+
+  int GetNumThreads() const { return static_cast<int>(m_threads.size()); }
+
+private:
+  struct Job {
+    const std::function<void(int)> *pFunction;
+    std::atomic<int> numRemaining;
+  };
+  struct Task {
+    Job *pJob;
+    int index;
+  };
+  /// <summary>
+  /// Tasks in [first, tasks.size()).
+  /// The vector is cleared once drained to reuse its capacity,
+  /// so that queuing doesn't allocate in a steady state.
+  /// </summary>
+  struct Queue {
+    Queue() : first(0) {}
+
+    bool IsEmpty() const { return tasks.size() <= first; }
+    void PopBack(Task *pTask);
+    void PopFront(Task *pTask);
+
+    std::mutex mutex;
+    std::vector<Task> tasks;
+    size_t first;
+  };
+
+  void Work(int worker);
+  bool PopTask(int worker, Task *pTask);
+  void RunTask(const Task &task);
+
+  std::vector<std::thread> m_threads;
+  std::vector<std::unique_ptr<Queue>> m_queues;
+  std::atomic<int> m_numQueuedTasks;
+  std::atomic<int> m_nextQueue;
+  bool m_isStopping;
+  std::mutex m_mutex;
+  std::condition_variable m_taskQueued;
+  std::condition_variable m_jobFinished;
+};
+
+#endif  // KINECT_PATIENTS_OBSERVER_THREAD_POOL_H_
\ No newline at end of file
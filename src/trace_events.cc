@@ -0,0 +1,138 @@
+﻿#include "trace_events.h"
+#include <stdio.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "atomic_file.h"
+#include "seqlock.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct TraceEvent {
+  UINT64 number;  // From 1 in the ring, to tell overwritten events.
+  const char *name;
+  UINT64 beginTicks;
+  UINT64 endTicks;
+};
+
+/// <summary>
+/// Events of a thread, added by the thread over the oldest ones and
+/// drained by "TraceEvents::WriteFile()" without locks.
+/// </summary>
+struct TraceEventRing {
+  TraceEventRing() : threadId(GetCurrentThreadId()), numAdded(0),
+                     numDrained(0) {}
+
+  DWORD threadId;
+  std::atomic<UINT64> numAdded;
+  UINT64 numDrained;  // Only by "TraceEvents::WriteFile()".
+  SeqLock<TraceEvent> events[TraceEvents::cNumEventsPerThread];
+};
+
+std::atomic<bool> TraceEvents::s_isStarted(false);
+
+// Rings are kept after their threads exit to write their events.
+static std::mutex g_ringsMutex;
+static std::vector<std::unique_ptr<TraceEventRing>> g_rings;
+static thread_local TraceEventRing *t_pRing = NULL;
+// Overwritten before they were written, guarded by "g_ringsMutex".
+static INT64 g_numDroppedEvents = 0;
+// To convert the time stamp counter, guarded by "g_ringsMutex".
+static UINT64 g_startTicks = 0;
+static Clock::time_point g_startTime;
+
+#ifdef TRACE_EVENTS
+
+bool TraceEvents::IsEnabled() {
+  return true;
+}
+
+#else  // TRACE_EVENTS
+
+bool TraceEvents::IsEnabled() {
+  return false;
+}
+
+#endif  // TRACE_EVENTS
+
+void TraceEvents::Start() {
+  {
+    std::lock_guard<std::mutex> lock(g_ringsMutex);
+    if (!g_startTicks) {
+      g_startTime = Clock::now();
+      g_startTicks = __rdtsc();
+    }
+  }
+  s_isStarted.store(true, std::memory_order_relaxed);
+}
+
+void TraceEvents::Stop() {
+  s_isStarted.store(false, std::memory_order_relaxed);
+}
+
+void TraceEvents::Add(const char *name, UINT64 beginTicks,
+                      UINT64 endTicks) {
+  // Register the ring of this thread at the first event.
+  TraceEventRing *pRing = t_pRing;
+  if (!pRing) {
+    pRing = new TraceEventRing();
+    std::lock_guard<std::mutex> lock(g_ringsMutex);
+    g_rings.emplace_back(pRing);
+    t_pRing = pRing;
+  }
+
+  UINT64 number = pRing->numAdded.load(std::memory_order_relaxed) + 1;
+  TraceEvent event = {number, name, beginTicks, endTicks};
+  pRing->events[(number - 1) % cNumEventsPerThread].Store(event);
+  pRing->numAdded.store(number, std::memory_order_release);
+}
+
+void TraceEvents::WriteEvents(FILE *pFile) {
+  // Measure the counter against the clock since the start.
+  double elapsedTime = std::chrono::duration<double, std::micro>(
+      Clock::now() - g_startTime).count();
+  double ticksPerMicrosecond = 1.0;
+  if (g_startTicks && 0.0 < elapsedTime)
+    ticksPerMicrosecond = (__rdtsc() - g_startTicks) / elapsedTime;
+
+  // Complete events, which have both the beginning and the duration.
+  fprintf(pFile, "{\"traceEvents\":[");
+  const char *separator = "\n";
+  DWORD processId = GetCurrentProcessId();
+  for (const std::unique_ptr<TraceEventRing> &pRing : g_rings) {
+    // Events overwritten before or while they are read are dropped.
+    UINT64 numAdded = pRing->numAdded.load(std::memory_order_acquire);
+    UINT64 first = pRing->numDrained + 1;
+    if (cNumEventsPerThread < numAdded - pRing->numDrained) {
+      UINT64 oldest = numAdded - cNumEventsPerThread + 1;
+      g_numDroppedEvents += oldest - first;
+      first = oldest;
+    }
+    for (UINT64 number = first; number <= numAdded; ++number) {
+      TraceEvent event;
+      pRing->events[(number - 1) % cNumEventsPerThread].Load(&event);
+      if (event.number != number) {
+        ++g_numDroppedEvents;
+        continue;
+      }
+      double beginTime = static_cast<INT64>(event.beginTicks - g_startTicks) /
+                         ticksPerMicrosecond;
+      double duration = (event.endTicks - event.beginTicks) /
+                        ticksPerMicrosecond;
+      fprintf(pFile, "%s{\"name\":\"%s\",\"cat\":\"observer\",\"ph\":\"X\","
+                     "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%lu,\"tid\":%lu}",
+              separator, event.name, beginTime, duration, processId,
+              pRing->threadId);
+      separator = ",\n";
+    }
+    pRing->numDrained = numAdded;
+  }
+  fprintf(pFile, "\n],\"otherData\":{\"droppedEvents\":\"%lld\"}}\n",
+          g_numDroppedEvents);
+}
+
+bool TraceEvents::WriteFile(const char *fileName) {
+  std::lock_guard<std::mutex> lock(g_ringsMutex);
+  return WriteFileAtomically(fileName, WriteEvents);
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+﻿#ifndef KINECT_PATIENTS_OBSERVER_TRACE_EVENTS_H_
+#define KINECT_PATIENTS_OBSERVER_TRACE_EVENTS_H_
+
+#include <intrin.h>  // __rdtsc()
+#include <stdio.h>
+#include <atomic>
+
+/// <summary>
+/// Records scoped events of every thread for the trace event format
+/// of Chrome and Perfetto, e.g. stages of Observer.
+/// Scopes are traced only when TRACE_EVENTS is defined, e.g. in Debug
+/// builds, and otherwise "TRACE_SCOPE()" compiles to nothing.
+/// Each thread adds events to its own ring without locks, stamped with
+/// the invariant time stamp counter, and writing a file drains them.
+/// </summary>
+class TraceEvents {
+public:
+  // Per thread, and the oldest events are overwritten by later ones.
+  static const int cNumEventsPerThread = 1 << 14;
+
+  static bool IsEnabled();
+  /// <summary>
+  /// Start or stop adding events, on any thread.
+  /// </summary>
+  static void Start();
+  static void Stop();
+  static bool IsStarted() {
+    return s_isStarted.load(std::memory_order_relaxed);
+  }
+
+  /// <summary>
+  /// Add an event of the calling thread.
+  /// </summary>
+  /// <param name="name">name with the static storage duration</param>
+  /// <param name="beginTicks">time stamp counter at the beginning</param>
+  /// <param name="endTicks">time stamp counter at the end</param>
+  static void Add(const char *name, UINT64 beginTicks, UINT64 endTicks);
+  /// <summary>
+  /// Write the events added since the last call as a JSON trace,
+  /// replacing the file at once.
+  /// </summary>
+  /// <param name="fileName">path to the file</param>
+  /// <returns>whether the file was replaced</returns>
+  static bool WriteFile(const char *fileName);
+
+private:
+  // Called with the rings locked.
+  static void WriteEvents(FILE *pFile);
+
+  static std::atomic<bool> s_isStarted;
+};
+
+/// <summary>
+/// Adds an event from its construction to its destruction
+/// if tracing was started.
+/// </summary>
+class TraceScope {
+public:
+  explicit TraceScope(const char *name)
+      : m_name(TraceEvents::IsStarted() ? name : NULL),
+        m_beginTicks(m_name ? __rdtsc() : 0) {}
+  ~TraceScope() {
+    if (m_name)
+      TraceEvents::Add(m_name, m_beginTicks, __rdtsc());
+  }
+
+private:
+  const char *m_name;
+  UINT64 m_beginTicks;
+};
+
+#ifdef TRACE_EVENTS
+#define TRACE_SCOPE_JOIN(a, b) a##b
+#define TRACE_SCOPE_VARIABLE(line) TRACE_SCOPE_JOIN(traceScope, line)
+#define TRACE_SCOPE(name) TraceScope TRACE_SCOPE_VARIABLE(__LINE__)(name)
+#else  // TRACE_EVENTS
+#define TRACE_SCOPE(name)
+#endif  // TRACE_EVENTS
+
+#endif  // KINECT_PATIENTS_OBSERVER_TRACE_EVENTS_H_
\ No newline at end of file